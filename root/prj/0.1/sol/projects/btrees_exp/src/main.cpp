@@ -18,6 +18,10 @@
 #include <stdexcept>
 #include <malloc.h>
 
+#ifndef _MSC_VER
+#define _msize malloc_usable_size
+#endif
+
 #include "btree.h"
 #include "indexer.h"
 #include "experiment.h"
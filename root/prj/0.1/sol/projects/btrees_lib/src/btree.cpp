@@ -10,34 +10,107 @@
 
 #include "btree.h"
 
+#include <algorithm>        // std::find
+#include <atomic>
 #include <stdexcept>        // std::invalid_argument
 #include <cstring>          // memset
 
 namespace btree {
 
+namespace {
+
+/** \brief The count of the constructed trees, which gives the trees their unique numbers. */
+std::atomic<UInt> treesCount(0);
+
+/** \brief Appends the copies of the visited keys to the list. */
+class KeysListAppender : public BaseBTree::IKeyVisitor {
+public:
+
+    KeysListAppender(std::list<Byte*>& keys, UShort recSize) : _keys(keys), _recSize(recSize) { }
+
+    virtual void visit(const Byte* k) override
+    {
+        Byte* copy = new Byte[_recSize];
+        memcpy(copy, k, _recSize);
+        _keys.push_back(copy);
+    }
+
+protected:
+
+    std::list<Byte*>& _keys;
+
+    UShort _recSize;
+
+}; // class KeysListAppender
+
+/** \brief Appends the visited keys to the contiguous memory one after another. */
+class KeysBytesAppender : public BaseBTree::IKeyVisitor {
+public:
+
+    KeysBytesAppender(std::vector<Byte>& keys, UShort recSize) : _keys(keys), _recSize(recSize) { }
+
+    virtual void visit(const Byte* k) override { _keys.insert(_keys.end(), k, k + _recSize); }
+
+protected:
+
+    std::vector<Byte>& _keys;
+
+    UShort _recSize;
+
+}; // class KeysBytesAppender
+
+} // namespace
+
 //==============================================================================
 // class BaseBTree
 //==============================================================================
 
 bool BaseBTree::Header::checkIntegrity()
 {
-    return (sign == VALID_SIGN) && (order >= 1) && (recSize > 0);
+    return (sign == VALID_SIGN || sign == BLINK_SIGN || sign == CHAINED_SIGN) && (order >= 1) && (recSize > 0);
 }
 
-BaseBTree::BaseBTree(UShort order, UShort recSize, IComparator* comparator, std::iostream* stream)
+BaseBTree::BaseBTree(UShort order, UShort recSize, IComparator* comparator, IPageStore* store)
     : _order(order), 
+    _nodePageSize(0),
     _recSize(recSize), 
     _comparator(comparator),
-    _stream(stream), 
-    _lastPageNum(0),
+    _store(store), 
     _rootPageNum(0),
-    _maxSearchDepth(0),
-    _diskOperationsCount(0),
-    _rootPage(this)
-#ifdef BTREE_WITH_REUSING_FREE_PAGES
-  , _freePagesCounter(0)
-#endif
+    _rootPage(this),
+    _keyPrinter(nullptr),
+    _bufferPool(nullptr),
+    _bufferPoolCapacity(0),
+    _bufferPoolBudget(0),
+    _freePageBuffersSize(0),
+    _pageBuffersAllocsCount(0),
+    _pageBuffersReusesCount(0),
+    _treeId(++treesCount),
+    _latchCoupling(false),
+    _optimisticSearch(false),
+    _copyOnWrite(false),
+    _bLink(false),
+    _leavesChained(true),
+    _linksOfs(0),
+    _isCopying(false),
+    _publishedRootPageNum(0),
+    _version(0)
+{
+}
+
+BaseBTree::BaseBTree(IComparator* comparator, IPageStore* store):
+    BaseBTree(
+        0,
+        0,
+        comparator, store)
+{
+
+}
+
+BaseBTree::BaseBTree(UShort order, UShort recSize, IComparator* comparator, std::iostream* stream)
+    : BaseBTree(order, recSize, comparator, (IPageStore*)nullptr)
 {
+    setStream(stream);
 }
 
 BaseBTree::BaseBTree(IComparator* comparator, std::iostream* stream):
@@ -51,73 +124,215 @@ BaseBTree::BaseBTree(IComparator* comparator, std::iostream* stream):
 
 BaseBTree::~BaseBTree()
 {
+    deletePathPages();
+    _rootPage.reallocData(0);
+    resetPageBuffers(0);
+
+    for (std::map<std::thread::id, ThreadContext*>::iterator iter = _threadContexts.begin();
+            iter != _threadContexts.end(); ++iter)
+        delete iter->second;
+
+    delete _bufferPool;
+}
+
+void BaseBTree::setStream(std::iostream* s)
+{
+    _streamStore.setStream(s);
+    _store = &_streamStore;
 }
 
 void BaseBTree::resetBTree()
 {
     _order = 0;
     _recSize = 0;
-    _stream = nullptr;
+    _store = nullptr;
     _comparator = nullptr;
+
+    delete _bufferPool;
+    _bufferPool = nullptr;
+
+    _retiredPages.clear();
+    _version = 0;
 }
 
 void BaseBTree::readPage(UInt pnum, Byte* dst)
 {    
     checkForOpenStream();
-    if (pnum == 0 || pnum > getLastPageNum())
-        throw std::invalid_argument("Can't read a non-existing page");
 
-    readPageInternal(pnum, dst);
-    ++_diskOperationsCount;
+    // The page latch is waited for outside the store latch.
+    latchPage(pnum);
+
+    {
+        SharedLock lock(_storeLatch, _latchCoupling);
+        if (pnum == 0 || pnum > getLastPageNum())
+        {
+            // The optimistic search could take the number from a page modified meanwhile.
+            validateLatchedPages();
+            throw std::invalid_argument("Can't read a non-existing page");
+        }
+
+        if (_isCopying)
+            pnum = getShadowPageNum(pnum);
+
+        if (_bufferPool != nullptr)
+            _bufferPool->read(pnum, dst);
+        else
+            _store->read(pnum, dst);
+    }
+
+    ++getThreadContext().diskOperationsCount;
+
+    // The optimistic search checks the page and its parent after the page is read,
+    // so the read page is the one the parent links to.
+    validateLatchedPages();
 }
 
 void BaseBTree::writePage(UInt pnum, const Byte* dst)
 {
     checkForOpenStream();
+    lockLatchedVersions();
+
+    ExclusiveLock lock(_storeLatch, _latchCoupling);
 
     if (pnum == 0 || pnum > getLastPageNum())
         throw std::invalid_argument("Can't write a non-existing page");
 
-    writePageInternal(pnum, dst);
-    ++_diskOperationsCount;
+    // The page published before the operation is written once to a new page, then the copy is rewritten.
+    if (_isCopying && _freshPages.count(pnum) == 0)
+    {
+        std::map<UInt, UInt>::const_iterator shadow = _shadowPages.find(pnum);
+        if (shadow == _shadowPages.end())
+        {
+            _shadowPages[pnum] = _store->alloc(dst);
+            ++getThreadContext().diskOperationsCount;
+            return;
+        }
+
+        pnum = shadow->second;
+    }
+
+    if (_bufferPool != nullptr)
+        _bufferPool->write(pnum, dst);
+    else
+        _store->write(pnum, dst);
+
+    ++getThreadContext().diskOperationsCount;
 }
 
-UInt BaseBTree::allocPage(PageWrapper& pw, UShort keysNum, bool isLeaf)
+void BaseBTree::setBufferPoolCapacity(UInt pages)
 {
-    checkForOpenStream();
+    _bufferPoolCapacity = pages;
+    _bufferPoolBudget = 0;
+
+    resetBufferPool();
+}
 
-    ++_diskOperationsCount;
+void BaseBTree::setBufferPoolBudget(ULong bytes)
+{
+    _bufferPoolCapacity = 0;
+    _bufferPoolBudget = bytes;
 
-#ifdef BTREE_WITH_REUSING_FREE_PAGES
+    resetBufferPool();
+}
 
-    return allocPageUsingFreePages(pw, keysNum, pw.isRoot(), isLeaf);
+void BaseBTree::flushBufferPool()
+{
+    if (_bufferPool != nullptr && isOpened())
+        _bufferPool->flush();
+}
 
-#else
+void BaseBTree::sync()
+{
+    checkForOpenStream();
 
-    return allocPageInternal(pw, keysNum, pw.isRoot(),  isLeaf);
+    flushBufferPool();
+    _store->sync();
+}
 
-#endif
+void BaseBTree::endOperation()
+{
+    ExclusiveLock lock(_storeLatch, _latchCoupling);
+
+    // The pool's dirty pages are of the running operation only, so they are dropped if it fails.
+    if (_store->canAbortOperation())
+        flushBufferPool();
+
+    if (!_store->endOperation())
+        return;
 
+    flushBufferPool();
+    _store->commit();
 }
 
-btree::UInt BaseBTree::allocNewRootPage(PageWrapper& pw)
+void BaseBTree::commit()
 {
     checkForOpenStream();
 
-#ifdef BTREE_WITH_REUSING_FREE_PAGES
+    ExclusiveLock lock(_storeLatch, _latchCoupling);
 
-    return allocPageUsingFreePages(pw, 0, true, false);
+    flushBufferPool();
+    _store->commit();
+}
 
-#else
+void BaseBTree::abortOperation()
+{
+    ExclusiveLock lock(_storeLatch, _latchCoupling);
 
-    return allocPageInternal(pw, 0, true, false);
+    if (!_store->canAbortOperation())
+        return;
 
-#endif
+    if (_bufferPool != nullptr)
+        _bufferPool->clear();
+
+    _store->abortOperation();
+
+    readRootPageNum();
+    loadRootPage();
+}
+
+void BaseBTree::resetBufferPool()
+{
+    flushBufferPool();
+
+    delete _bufferPool;
+    _bufferPool = nullptr;
 
+    if (_nodePageSize == 0 || _order == 0 || _store == nullptr)
+        return;
+
+    UInt capacity = _bufferPoolCapacity;
+    if (_bufferPoolBudget != 0)
+    {
+        ULong pages = _bufferPoolBudget / _nodePageSize;
+        capacity = pages == 0 ? 1 : (UInt)pages;
+    }
+
+    if (capacity != 0)
+        _bufferPool = new BufferPool(_store, _nodePageSize, capacity);
+}
+
+UInt BaseBTree::allocPage(PageWrapper& pw, UShort keysNum, bool isLeaf)
+{
+    checkForOpenStream();
+
+    ++getThreadContext().diskOperationsCount;
+
+    return allocPageInternal(pw, keysNum, pw.isRoot(),  isLeaf);
+}
+
+btree::UInt BaseBTree::allocNewRootPage(PageWrapper& pw)
+{
+    checkForOpenStream();
+
+    return allocPageInternal(pw, 0, true, false);
 }
 
 void BaseBTree::insert(const Byte* k)
 {
+    OperationLatches latches(this, INSERT_OPERATION);
+    OperationScope operation(this);
+    CopyOnWriteScope scope(this);
+
     if(_rootPage.isFull())
     {
         UInt prevRootPageNum = _rootPageNum;
@@ -127,51 +342,58 @@ void BaseBTree::insert(const Byte* k)
         _rootPage.splitChild(0);
     }
     insertNonFull(k, _rootPage);
+
+    scope.commit();
+    operation.end();
 }
 
-void BaseBTree::insertNonFull(const Byte* k, PageWrapper& currentNode)
+void BaseBTree::insertNonFull(const Byte* k, PageWrapper& node)
 {
-    if (currentNode.isFull())
+    if (node.isFull())
         throw std::domain_error("Node is full. Can't insert");
 
     IComparator* c = getComparator();
     if (!c)
         throw std::runtime_error("Comparator not set. Can't insert");
 
-    UShort keysNum = currentNode.getKeysNum();
+    // The full children are split on the way down, so the descent never returns to the upper pages.
+    PathPages path(this);
+    PageWrapper* current = &node;
+    for( ; ; )
+    {
+        PageWrapper& currentNode = *current;
+        releaseAncestorLatches(currentNode);
 
-    int i = keysNum - 1;
+        UShort keysNum = currentNode.getKeysNum();
 
-    if(currentNode.isLeaf())
-    {
-        currentNode.setKeyNum(keysNum + 1);
+        if(currentNode.isLeaf())
+        {
+            UShort pos = upperBound(currentNode, k);
 
-        for( ; i >= 0 && c->compare(k, currentNode.getKey(i), getRecSize()); --i)
-            currentNode.copyKey(currentNode.getKey(i + 1), currentNode.getKey(i));
+            currentNode.setKeyNum(keysNum + 1);
+            for(int i = keysNum - 1; i >= pos; --i)
+                currentNode.copyKey(currentNode.getKey(i + 1), currentNode.getKey(i));
 
-        currentNode.copyKey(currentNode.getKey(i + 1), k);
+            currentNode.copyKey(currentNode.getKey(pos), k);
 
-        currentNode.writePage();
-    }
-    else
-    {
-        for( ; i >= 0 && c->compare(k, currentNode.getKey(i), getRecSize()); --i) ;
-        ++i;
+            currentNode.writePage();
 
-        PageWrapper child(this);
+            return;
+        }
+
+        int i = upperBound(currentNode, k);
+
+        PageWrapper& child = path.take();
         child.readPageFromChild(currentNode, i);
+        current = &child;
 
         if(child.isFull())
         {
-            PageWrapper newChild(this);
+            PageWrapper& newChild = path.take();
             splitChild(currentNode, i, child, newChild);
             if(c->compare(currentNode.getKey(i), k, getRecSize()))
-                insertNonFull(k, newChild);
-            else
-                insertNonFull(k, child);
+                current = &newChild;
         }
-        else
-            insertNonFull(k, child);
     }
 }
 
@@ -180,85 +402,266 @@ Byte* BaseBTree::search(const Byte* k)
     if (_comparator == nullptr)
         throw std::runtime_error("Comparator not set. Can't search");
 
-    _maxSearchDepth = 0;
+    Byte* result = new Byte[_recSize];
+    if (search(k, result))
+        return result;
 
-    return search(k, _rootPage, 1);
+    delete[] result;
+    return nullptr;
 }
 
-Byte* BaseBTree::search(const Byte* k, PageWrapper& currentPage, UInt currentDepth)
+bool BaseBTree::search(const Byte* k, Byte* result)
 {
-    if(currentDepth > _maxSearchDepth)
-        _maxSearchDepth = currentDepth;
-
-    int i;
-    UShort keysNum = currentPage.getKeysNum();
-    for(i = 0; i < keysNum && _comparator->compare(currentPage.getKey(i), k, _recSize); ++i) ;
+    if (_comparator == nullptr)
+        throw std::runtime_error("Comparator not set. Can't search");
 
-    if(i < keysNum && _comparator->isEqual(k, currentPage.getKey(i), _recSize))
+    for (UInt restarts = 0; ; ++restarts)
     {
-        Byte* result = new Byte[_recSize];
-        currentPage.copyKey(result, currentPage.getKey(i));
-        return result;
+        try
+        {
+            OperationLatches latches(this, getSearchOperation(restarts));
+            getThreadContext().maxSearchDepth = 0;
+
+            PathPages path(this);
+            return search(k, result, getSearchRootPage(path), 1);
+        }
+        catch (const OptimisticRestart&)
+        {
+            ++getThreadContext().optimisticRestartsCount;
+        }
     }
-    else if(currentPage.isLeaf())
-        return nullptr;
-    else
+}
+
+bool BaseBTree::search(const Byte* k, Byte* result, PageWrapper& page, UInt currentDepth)
+{
+    PathPages path(this);
+    UInt& maxSearchDepth = getThreadContext().maxSearchDepth;
+    PageWrapper* current = &page;
+    for( ; ; ++currentDepth)
     {
-        PageWrapper nextPage(this);
-        nextPage.readPageFromChild(currentPage, i);
-        return search(k, nextPage, currentDepth + 1);
+        PageWrapper& currentPage = *current;
+        releaseAncestorLatches(currentPage);
+
+        if(currentDepth > maxSearchDepth)
+            maxSearchDepth = currentDepth;
+
+        UShort keysNum = currentPage.getKeysNum();
+        int i = lowerBound(currentPage, k);
+
+        if(i < keysNum && _comparator->isEqual(k, currentPage.getKey(i), _recSize))
+        {
+            currentPage.copyKey(result, currentPage.getKey(i));
+            return true;
+        }
+        else if(currentPage.isLeaf())
+            return false;
+
+        PageWrapper& nextPage = path.take();
+        nextPage.viewPageFromChild(currentPage, i);
+        current = &nextPage;
     }
 }
 
 int BaseBTree::searchAll(const Byte* k, std::list<Byte*>& keys)
+{
+    KeysListAppender appender(keys, _recSize);
+    return searchAll(k, appender);
+}
+
+int BaseBTree::searchAll(const Byte* k, std::vector<Byte>& keys)
+{
+    KeysBytesAppender appender(keys, _recSize);
+    return searchAll(k, appender);
+}
+
+int BaseBTree::searchAll(const Byte* k, IKeyVisitor& visitor)
 {
     if (_comparator == nullptr)
         throw std::runtime_error("Comparator not set. Can't search");
 
-    _maxSearchDepth = 0;
+    for (UInt restarts = 0; ; ++restarts)
+    {
+        try
+        {
+            OperationLatches latches(this, getSearchOperation(restarts));
+            ThreadContext& context = getThreadContext();
+            context.maxSearchDepth = 0;
+
+            PathPages path(this);
+            if (context.latchMode != OPTIMISTIC_LATCHES)
+                return searchAll(k, visitor, getSearchRootPage(path), 1);
+
+            // The keys of the restarted search are not visited.
+            context.foundKeys.clear();
+            KeysBytesAppender appender(context.foundKeys, _recSize);
+            int amount = searchAll(k, appender, getSearchRootPage(path), 1);
+            for (size_t ofs = 0; ofs < context.foundKeys.size(); ofs += _recSize)
+                visitor.visit(&context.foundKeys[ofs]);
+
+            return amount;
+        }
+        catch (const OptimisticRestart&)
+        {
+            ++getThreadContext().optimisticRestartsCount;
+        }
+    }
+}
+
+int BaseBTree::searchAll(const Byte* k, IKeyVisitor& visitor, PageWrapper& currentPage, UInt currentDepth)
+{
+    return searchRange(k, k, visitor, currentPage, currentDepth);
+}
 
-    return searchAll(k, keys, _rootPage, 1);
+int BaseBTree::searchRange(const Byte* lo, const Byte* hi, std::list<Byte*>& keys)
+{
+    KeysListAppender appender(keys, _recSize);
+    return searchRange(lo, hi, appender);
 }
 
-int BaseBTree::searchAll(const Byte* k, std::list<Byte*>& keys, PageWrapper& currentPage, UInt currentDepth)
+int BaseBTree::searchRange(const Byte* lo, const Byte* hi, std::vector<Byte>& keys)
 {
-    if(currentDepth > _maxSearchDepth)
-        _maxSearchDepth = currentDepth;
+    KeysBytesAppender appender(keys, _recSize);
+    return searchRange(lo, hi, appender);
+}
 
-    int amount = 0;
-    int i;
-    UShort keysNum = currentPage.getKeysNum();
-    bool isLeaf = currentPage.isLeaf();
+int BaseBTree::searchRange(const Byte* lo, const Byte* hi, IKeyVisitor& visitor)
+{
+    if (_comparator == nullptr)
+        throw std::runtime_error("Comparator not set. Can't search");
+
+    for (UInt restarts = 0; ; ++restarts)
+    {
+        try
+        {
+            OperationLatches latches(this, getSearchOperation(restarts));
+            ThreadContext& context = getThreadContext();
+            context.maxSearchDepth = 0;
+
+            PathPages path(this);
+            if (context.latchMode != OPTIMISTIC_LATCHES)
+                return searchRange(lo, hi, visitor, getSearchRootPage(path), 1);
+
+            // The keys of the restarted search are not visited.
+            context.foundKeys.clear();
+            KeysBytesAppender appender(context.foundKeys, _recSize);
+            int amount = searchRange(lo, hi, appender, getSearchRootPage(path), 1);
+            for (size_t ofs = 0; ofs < context.foundKeys.size(); ofs += _recSize)
+                visitor.visit(&context.foundKeys[ofs]);
+
+            return amount;
+        }
+        catch (const OptimisticRestart&)
+        {
+            ++getThreadContext().optimisticRestartsCount;
+        }
+    }
+}
 
-    for(i = 0; i < keysNum && _comparator->compare(currentPage.getKey(i), k, _recSize); ++i) ;
+int BaseBTree::searchRange(const Byte* lo, const Byte* hi, IKeyVisitor& visitor,
+        PageWrapper& currentPage, UInt currentDepth)
+{
+    PathPages path(this);
+    UInt& maxSearchDepth = getThreadContext().maxSearchDepth;
+    if(currentDepth > maxSearchDepth)
+        maxSearchDepth = currentDepth;
 
-    int first = i;
+    // The routers of the leaf-oriented tree are not visited, the keys equal to a router can be on its both sides.
+    bool isInnerKeysVisited = !isLeafOriented();
 
-    PageWrapper nextPage(this);
-    for( ; i < keysNum && (i == first || _comparator->isEqual(k, currentPage.getKey(i), _recSize)); ++i)
+    // The child i is between the keys (i - 1) and i, so it is visited before the key i.
+    std::vector<PathLevel> levels(1, PathLevel(&currentPage, lowerBound(currentPage, lo)));
+    int amount = 0;
+    while(!levels.empty())
     {
-        if(_comparator->isEqual(k, currentPage.getKey(i), _recSize))
+        PathLevel& level = levels.back();
+        PageWrapper& page = *level.page;
+
+        if(!page.isLeaf() && !level.isChildVisited)
         {
-            Byte* result = new Byte[_recSize];
-            currentPage.copyKey(result, currentPage.getKey(i));
-            keys.push_back(result);
-            ++amount;
+            level.isChildVisited = true;
+
+            PageWrapper& nextPage = path.at((UInt)levels.size() - 1);
+            nextPage.viewPageFromChild(page, level.keyNum);
+            levels.push_back(PathLevel(&nextPage, lowerBound(nextPage, lo)));
+
+            if(currentDepth + levels.size() - 1 > maxSearchDepth)
+                maxSearchDepth = currentDepth + (UInt)levels.size() - 1;
+
+            continue;
+        }
+
+        if(level.keyNum == page.getKeysNum() || _comparator->compare(hi, page.getKey(level.keyNum), _recSize))
+        {
+            levels.pop_back();
+            if(!levels.empty())
+                unlatchPage(page.getPageNum());
+
+            continue;
         }
 
-        if(!isLeaf)
+        if(page.isLeaf() || isInnerKeysVisited)
         {
-            nextPage.readPageFromChild(currentPage, i);
-            amount += searchAll(k, keys, nextPage, currentDepth + 1);
+            visitor.visit(page.getKey(level.keyNum));
+            ++amount;
         }
+
+        ++level.keyNum;
+        level.isChildVisited = false;
     }
 
-    if(!isLeaf)
+    return amount;
+}
+
+int BaseBTree::searchRangeInLeaves(const Byte* lo, const Byte* hi, IKeyVisitor& visitor,
+        PageWrapper& currentPage, UInt currentDepth)
+{
+    if(!_leavesChained)
+        return BaseBTree::searchRange(lo, hi, visitor, currentPage, currentDepth);
+
+    PathPages path(this);
+    UInt& maxSearchDepth = getThreadContext().maxSearchDepth;
+    PageWrapper* leaf = &currentPage;
+    for( ; ; ++currentDepth)
     {
-        nextPage.readPageFromChild(currentPage, i);
-        amount += searchAll(k, keys, nextPage, currentDepth + 1);
+        if(currentDepth > maxSearchDepth)
+            maxSearchDepth = currentDepth;
+
+        leaf = &moveRight(*leaf, lo, path);
+        if(leaf->isLeaf())
+            break;
+
+        PageWrapper& nextPage = path.take();
+        nextPage.viewPageFromChild(*leaf, lowerBound(*leaf, lo));
+        releaseAncestorLatches(nextPage);
+        leaf = &nextPage;
     }
 
-    return amount;
+    int amount = 0;
+
+    PageWrapper& nextLeaf = path.take();
+    for( ; ; )
+    {
+        // After the removals a router can be greater than its left leaf's max key,
+        // so the keys less than lo can be found in the next leaves too.
+        UShort keysNum = leaf->getKeysNum();
+        for(int i = lowerBound(*leaf, lo); i < keysNum; ++i)
+        {
+            if(_comparator->compare(hi, leaf->getKey(i), _recSize))
+                return amount;
+
+            visitor.visit(leaf->getKey(i));
+            ++amount;
+        }
+
+        UInt next = leaf->getNextLeaf();
+        if(next == 0)
+            return amount;
+
+        // The next leaf is latched before the previous one is released, as the parent before the child.
+        nextLeaf.viewPage(next);
+        releaseAncestorLatches(nextLeaf);
+        leaf = &nextLeaf;
+    }
 }
 
 void BaseBTree::splitChild(PageWrapper& node, UShort iChild, PageWrapper& leftChild, PageWrapper& rightChild)
@@ -292,8 +695,11 @@ void BaseBTree::splitChild(PageWrapper& node, UShort iChild, PageWrapper& leftCh
     node.copyKey(node.getKey(iChild), leftChild.getKey(getMinKeys()));
     leftChild.setKeyNum(getMinKeys());
 
-    leftChild.writePage();
+    linkSplitPages(node, iChild, leftChild, rightChild);
+
+    // The new page is written before the pages linking it.
     rightChild.writePage();
+    leftChild.writePage();
     node.writePage();
 }
 
@@ -304,34 +710,49 @@ bool BaseBTree::remove(const Byte* k)
     if (_comparator == nullptr)
         throw std::runtime_error("Comparator not set. Can't remove");
 
-    return remove(k, _rootPage);
+    OperationLatches latches(this, REMOVE_OPERATION);
+    OperationScope operation(this);
+    CopyOnWriteScope scope(this);
+    bool removed = remove(k, _rootPage);
+    scope.commit();
+    operation.end();
+
+    return removed;
 }
 
-bool BaseBTree::remove(const Byte* k, PageWrapper& currentPage)
+bool BaseBTree::remove(const Byte* k, PageWrapper& page)
 {
-    int i;
-    UShort keysNum = currentPage.getKeysNum();
+    PathPages path(this);
+    PageWrapper* current = &page;
+    for( ; ; )
+    {
+        PageWrapper& currentPage = *current;
+        releaseAncestorLatches(currentPage);
 
-    for(i = 0; i < keysNum && _comparator->compare(currentPage.getKey(i), k, _recSize); ++i) ;
+        UShort keysNum = currentPage.getKeysNum();
 
-    if(i < keysNum && _comparator->isEqual(k, currentPage.getKey(i), _recSize))
-    {
-        if(currentPage.isRoot())
-            return removeByKeyNum(i, _rootPage);
-        else
-            return removeByKeyNum(i, currentPage);
-    }
+        int i = lowerBound(currentPage, k);
 
-    else if(currentPage.isLeaf())
-        return false;
+        if(i < keysNum && _comparator->isEqual(k, currentPage.getKey(i), _recSize))
+        {
+            if(currentPage.isRoot())
+                return removeByKeyNum(i, _rootPage);
+            else
+                return removeByKeyNum(i, currentPage);
+        }
 
-    PageWrapper child(this);
-    PageWrapper leftNeighbour(this);
-    PageWrapper rightNeighbour(this);
-    if(prepareSubtree(i, currentPage, child, leftNeighbour, rightNeighbour))
-        return remove(k, leftNeighbour);
-    else
-        return remove(k, child);
+        else if(currentPage.isLeaf())
+            return false;
+
+        PageWrapper& child = path.take();
+        PageWrapper& leftNeighbour = path.take();
+        PageWrapper& rightNeighbour = path.take();
+        current = prepareSubtree(i, currentPage, child, leftNeighbour, rightNeighbour) ? &leftNeighbour : &child;
+
+        // The merged child becomes the root when the root's last key is moved to it.
+        if(current->isRoot())
+            current = &_rootPage;
+    }
 }
 
 int BaseBTree::removeAll(const Byte* k)
@@ -339,68 +760,81 @@ int BaseBTree::removeAll(const Byte* k)
     if (_comparator == nullptr)
         throw std::runtime_error("Comparator not set. Can't remove");
 
-    return removeAll(k, _rootPage);
+    OperationLatches latches(this, REMOVE_OPERATION);
+    OperationScope operation(this);
+    CopyOnWriteScope scope(this);
+    int amount = removeAll(k, _rootPage);
+    scope.commit();
+    operation.end();
+
+    return amount;
 }
 
 int BaseBTree::removeAll(const Byte* k, PageWrapper& currentPage)
 {
     int amount = 0;
 
-    while (remove(k))
+    while (remove(k, _rootPage))
+    {
         ++amount;
+        restartLatching(REMOVE_OPERATION);
+    }
 
     return amount;
 }
 
-bool BaseBTree::removeByKeyNum(UShort keyNum, PageWrapper& currentPage)
+bool BaseBTree::removeByKeyNum(UShort keyNum, PageWrapper& page)
 {
-    UShort keysNum = currentPage.getKeysNum();
-    Byte* k = currentPage.getKey(keyNum);
-
-    if(currentPage.isLeaf())
+    PathPages path(this);
+    PageWrapper* current = &page;
+    for( ; ; )
     {
-        for(int j = keyNum; j < keysNum - 1; ++j)
-            currentPage.copyKey(currentPage.getKey(j), currentPage.getKey(j + 1));
+        PageWrapper& currentPage = *current;
+        UShort keysNum = currentPage.getKeysNum();
 
-        currentPage.setKeyNum(keysNum - 1);
+        if(currentPage.isLeaf())
+        {
+            for(int j = keyNum; j < keysNum - 1; ++j)
+                currentPage.copyKey(currentPage.getKey(j), currentPage.getKey(j + 1));
 
-        currentPage.writePage();
+            currentPage.setKeyNum(keysNum - 1);
 
-        return true;
-    }
+            currentPage.writePage();
 
-    const Byte* replace = nullptr;
+            return true;
+        }
 
-    PageWrapper leftChild(this), rightChild(this);
-    leftChild.readPageFromChild(currentPage, keyNum);
-    if(leftChild.getKeysNum() >= getMinKeys() + 1)
-        replace = getAndRemoveMaxKey(leftChild);
+        const Byte* replace = nullptr;
 
-    if(replace == nullptr)
-    {
-        rightChild.readPageFromChild(currentPage, keyNum + 1);
-        if(rightChild.getKeysNum() >= getMinKeys() + 1)
-            replace = getAndRemoveMinKey(rightChild);
-    }
+        PageWrapper& leftChild = path.take();
+        PageWrapper& rightChild = path.take();
+        leftChild.readPageFromChild(currentPage, keyNum);
+        if(leftChild.getKeysNum() >= getMinKeys() + 1)
+            replace = getAndRemoveMaxKey(leftChild);
 
-    if(replace != nullptr)
-    {
-        currentPage.copyKey(currentPage.getKey(keyNum), replace);
-        delete[] replace;
+        if(replace == nullptr)
+        {
+            rightChild.readPageFromChild(currentPage, keyNum + 1);
+            if(rightChild.getKeysNum() >= getMinKeys() + 1)
+                replace = getAndRemoveMinKey(rightChild);
+        }
 
-        currentPage.writePage();
+        if(replace != nullptr)
+        {
+            currentPage.copyKey(currentPage.getKey(keyNum), replace);
+            delete[] replace;
 
-        return true;
-    }
+            currentPage.writePage();
 
-    mergeChildren(leftChild, rightChild, currentPage, keyNum);
+            return true;
+        }
 
-    if(leftChild.isRoot())
-        removeByKeyNum(getMaxKeys() / 2, _rootPage);
-    else
-        removeByKeyNum(getMaxKeys() / 2, leftChild);
+        // The key is moved to the middle of the merged child and removed from it.
+        mergeChildren(leftChild, rightChild, currentPage, keyNum);
 
-    return true;
+        current = leftChild.isRoot() ? &_rootPage : &leftChild;
+        keyNum = getMaxKeys() / 2;
+    }
 }
 
 bool BaseBTree::prepareSubtree(UShort cursorNum, PageWrapper& currentPage, PageWrapper& child, PageWrapper& leftNeighbour, PageWrapper& rightNeighbour)
@@ -450,54 +884,66 @@ bool BaseBTree::prepareSubtree(UShort cursorNum, PageWrapper& currentPage, PageW
     return false;
 }
 
-const Byte* BaseBTree::getAndRemoveMaxKey(PageWrapper& pw)
+const Byte* BaseBTree::getAndRemoveMaxKey(PageWrapper& page)
 {
-    if(pw.isLeaf())
+    PathPages path(this);
+    PageWrapper* current = &page;
+    for( ; ; )
     {
-        Byte* maxKey = new Byte[_recSize];
-        pw.copyKey(maxKey, pw.getKey(pw.getKeysNum() - 1));
+        PageWrapper& pw = *current;
+        if(pw.isLeaf())
+        {
+            Byte* maxKey = new Byte[_recSize];
+            pw.copyKey(maxKey, pw.getKey(pw.getKeysNum() - 1));
 
-        pw.setKeyNum(pw.getKeysNum() - 1);
+            pw.setKeyNum(pw.getKeysNum() - 1);
 
-        pw.writePage();
+            pw.writePage();
 
-        return maxKey;
-    }
+            return maxKey;
+        }
 
-    PageWrapper child(this);
-    PageWrapper leftNeighbour(this);
-    PageWrapper rightNeighbour(this);
-    if(prepareSubtree(pw.getKeysNum(), pw, child, leftNeighbour, rightNeighbour))
-        return getAndRemoveMaxKey(leftNeighbour);
-    else
-        return getAndRemoveMaxKey(child);
+        PageWrapper& child = path.take();
+        PageWrapper& leftNeighbour = path.take();
+        PageWrapper& rightNeighbour = path.take();
+        if(prepareSubtree(pw.getKeysNum(), pw, child, leftNeighbour, rightNeighbour))
+            current = &leftNeighbour;
+        else
+            current = &child;
+    }
 }
 
-const Byte* BaseBTree::getAndRemoveMinKey(PageWrapper& pw)
+const Byte* BaseBTree::getAndRemoveMinKey(PageWrapper& page)
 {
-    if(pw.isLeaf())
+    PathPages path(this);
+    PageWrapper* current = &page;
+    for( ; ; )
     {
-        Byte* minKey = new Byte[_recSize];
-        pw.copyKey(minKey, pw.getKey(0));
+        PageWrapper& pw = *current;
+        if(pw.isLeaf())
+        {
+            Byte* minKey = new Byte[_recSize];
+            pw.copyKey(minKey, pw.getKey(0));
 
-        UShort pwKeysNum = pw.getKeysNum();
-        for(int j = 0; j < pwKeysNum - 1; ++j)
-            pw.copyKey(pw.getKey(j), pw.getKey(j + 1));
+            UShort pwKeysNum = pw.getKeysNum();
+            for(int j = 0; j < pwKeysNum - 1; ++j)
+                pw.copyKey(pw.getKey(j), pw.getKey(j + 1));
 
-        pw.setKeyNum(pw.getKeysNum() - 1);
+            pw.setKeyNum(pw.getKeysNum() - 1);
 
-        pw.writePage();
+            pw.writePage();
 
-        return minKey;
-    }
+            return minKey;
+        }
 
-    PageWrapper child(this);
-    PageWrapper leftNeighbour(this);
-    PageWrapper rightNeighbour(this);
-    if(prepareSubtree(pw.getKeysNum(), pw, child, leftNeighbour, rightNeighbour))
-        return getAndRemoveMinKey(leftNeighbour);
-    else
-        return getAndRemoveMinKey(child);
+        PageWrapper& child = path.take();
+        PageWrapper& leftNeighbour = path.take();
+        PageWrapper& rightNeighbour = path.take();
+        if(prepareSubtree(0, pw, child, leftNeighbour, rightNeighbour))
+            current = &leftNeighbour;
+        else
+            current = &child;
+    }
 }
 
 void BaseBTree::mergeChildren(PageWrapper& leftChild, PageWrapper& rightChild, PageWrapper& currentPage, UShort medianNum)
@@ -511,6 +957,7 @@ void BaseBTree::mergeChildren(PageWrapper& leftChild, PageWrapper& rightChild, P
 
     leftChild.copyKeys(leftChild.getKey(getMinKeys() + 1), rightChild.getKey(0), getMinKeys());
     leftChild.copyCursors(leftChild.getCursorPtr(getMinKeys() + 1), rightChild.getCursorPtr(0), getMinKeys() + 1);
+    linkMergedPages(leftChild, rightChild);
 
     for(int j = medianNum; j < keysNum - 1; ++j)
     {
@@ -569,6 +1016,10 @@ void BaseBTree::moveOneKeyFromLeft(PageWrapper& leftNeighbour, PageWrapper& chil
 
     leftNeighbour.setKeyNum(--neighbourKeysNum);
 
+    // The B-link tree's neighbour is bounded by its router, which has changed.
+    if(_bLink)
+        leftNeighbour.copyKey(leftNeighbour.getHighKey(), currentPage.getKey(childCursorNum - 1));
+
     child.writePage();
     leftNeighbour.writePage();
     currentPage.writePage();
@@ -597,91 +1048,93 @@ void BaseBTree::moveOneKeyFromRight(PageWrapper& rightNeighbour, PageWrapper& ch
                                rightNeighbour.getCursorPtr(neighbourKeysNum), 1);
     rightNeighbour.setKeyNum(--neighbourKeysNum);
 
+    // The B-link tree's child is bounded by its router, which has changed.
+    if(_bLink)
+        child.copyKey(child.getHighKey(), currentPage.getKey(childCursorNum));
+
     child.writePage();
     rightNeighbour.writePage();
     currentPage.writePage();
 }
 
-#endif // BTREE_WITH_DELETION
+void BaseBTree::moveOneLeafKeyFromLeft(PageWrapper& leftNeighbour, PageWrapper& child,
+        PageWrapper& currentPage, UShort childCursorNum)
+{
+    UShort childKeysNum = child.getKeysNum();
+    UShort neighbourKeysNum = leftNeighbour.getKeysNum();
 
-#ifdef BTREE_WITH_REUSING_FREE_PAGES
+    child.setKeyNum(childKeysNum + 1);
+    for(int j = childKeysNum; j > 0; --j)
+        child.copyKey(child.getKey(j), child.getKey(j - 1));
 
-UInt BaseBTree::allocPageUsingFreePages(PageWrapper& pw, UShort keysNum, bool isRoot, bool isLeaf)
-{
-    if(_freePagesCounter == 0)
-    {
-        allocPageInternal(pw, keysNum, isRoot, isLeaf);
-        writeFreePagesCounter();
-        return _lastPageNum;
-    }
-    else
-    {
-        UInt lastFree = getLastFreePageNum();
-        allocPageUsingFreePagesInternal(pw, keysNum, isRoot, isLeaf, lastFree);
-        --_freePagesCounter;
-        writeFreePagesCounter();
-        return lastFree;
-    }
-}
+    child.copyKey(child.getKey(0), leftNeighbour.getKey(neighbourKeysNum - 1));
 
-void BaseBTree::loadFreePagesCounter()
-{
-    _stream->seekg(getFreePagesInfoAreaOfs(), std::ios_base::beg);
-    _stream->read((char*)&_freePagesCounter, FREE_PAGES_COUNTER_SZ);
-    ++_diskOperationsCount;
-}
+    leftNeighbour.setKeyNum(--neighbourKeysNum);
 
-void BaseBTree::writeFreePagesCounter()
-{
-    _stream->seekg(getFreePagesInfoAreaOfs(), std::ios_base::beg);
-    _stream->write((const char*)&_freePagesCounter, FREE_PAGES_COUNTER_SZ);
-    ++_diskOperationsCount;
-}
+    currentPage.copyKey(currentPage.getKey(childCursorNum - 1), leftNeighbour.getKey(neighbourKeysNum - 1));
 
-UInt BaseBTree::getLastFreePageNum()
-{
-    UInt result;
-    _stream->seekg(getLastFreePageNumOfs(), std::ios_base::beg);
-    _stream->read((char*)&result, FREE_PAGE_NUM_SZ);
-    ++_diskOperationsCount;
-    return result;
+    if(_bLink)
+        leftNeighbour.copyKey(leftNeighbour.getHighKey(), currentPage.getKey(childCursorNum - 1));
+
+    child.writePage();
+    leftNeighbour.writePage();
+    currentPage.writePage();
 }
 
-void BaseBTree::allocPageUsingFreePagesInternal(PageWrapper& pw, UShort keysNum, bool isRoot, bool isLeaf, UInt freePageNum)
+void BaseBTree::moveOneLeafKeyFromRight(PageWrapper& rightNeighbour, PageWrapper& child,
+        PageWrapper& currentPage, UShort childCursorNum)
 {
-    pw.clear();
-    pw.setKeyNumLeaf(keysNum, isRoot, isLeaf);
+    UShort childKeysNum = child.getKeysNum();
+    UShort neighbourKeysNum = rightNeighbour.getKeysNum();
 
-    _stream->seekg(getPageOfs(freePageNum), std::ios_base::beg);
-    _stream->write((const char*)pw.getData(), getNodePageSize());
-}
+    child.setKeyNum(childKeysNum + 1);
 
-ULong BaseBTree::getPageOfs(UInt pageNum)
-{
-    return (ULong)FIRST_PAGE_OFS + (pageNum - 1) * _nodePageSize;
-}
+    child.copyKey(child.getKey(childKeysNum), rightNeighbour.getKey(0));
 
-ULong BaseBTree::getFreePagesInfoAreaOfs()
-{
-    return getPageOfs(_lastPageNum + 1);
-}
+    currentPage.copyKey(currentPage.getKey(childCursorNum), rightNeighbour.getKey(0));
 
-ULong BaseBTree::getLastFreePageNumOfs()
-{
-    return getFreePagesInfoAreaOfs() + FREE_PAGES_COUNTER_SZ + (_freePagesCounter - 1) * FREE_PAGE_NUM_SZ;
+    for(int j = 0; j < neighbourKeysNum - 1; ++j)
+        rightNeighbour.copyKey(rightNeighbour.getKey(j), rightNeighbour.getKey(j + 1));
+
+    rightNeighbour.setKeyNum(--neighbourKeysNum);
+
+    if(_bLink)
+        child.copyKey(child.getHighKey(), currentPage.getKey(childCursorNum));
+
+    // The moved key is written to the child before it is removed from the neighbour.
+    child.writePage();
+    currentPage.writePage();
+    rightNeighbour.writePage();
 }
 
+#endif // BTREE_WITH_DELETION
+
+#ifdef BTREE_WITH_REUSING_FREE_PAGES
+
 void BaseBTree::markPageFree(UInt pageNum)
 {
-    if(pageNum > _lastPageNum)
+    checkForOpenStream();
+
+    if(pageNum > getLastPageNum())
         throw std::invalid_argument("No page with a such number");
 
-    _stream->seekg(getLastFreePageNumOfs() + FREE_PAGE_NUM_SZ, std::ios_base::beg);
-    _stream->write((const char*)&pageNum, FREE_PAGE_NUM_SZ);
-    ++_diskOperationsCount;
+    if (_isCopying && retirePage(pageNum))
+        return;
+
+    lockLatchedVersions();
+    {
+        ExclusiveLock lock(_storeLatch, _latchCoupling);
+
+        if (_bufferPool != nullptr)
+            _bufferPool->discard(pageNum);
+
+        _store->free(pageNum);
+    }
+
+    ++getThreadContext().diskOperationsCount;
 
-    ++_freePagesCounter;
-    writeFreePagesCounter();
+    // Only the freeing operation could reach the page through its parent or its left neighbour.
+    unlatchPage(pageNum);
 }
 
 #endif // BTREE_WITH_REUSING_FREE_PAGES
@@ -702,40 +1155,40 @@ UInt BaseBTree::allocPageInternal(PageWrapper& pw, UShort keysNum, bool isRoot,
     pw.clear();
     pw.setKeyNumLeaf(keysNum, isRoot, isLeaf);
 
-#ifdef BTREE_WITH_REUSING_FREE_PAGES
-
-    _stream->seekg(getFreePagesInfoAreaOfs(), std::ios_base::beg);
-
-#else
-
-    _stream->seekg(0, std::ios_base::end);
-
-#endif
+    // The allocated page can't be in the buffer pool: it is either new or discarded when freed.
+    UInt pnum;
+    {
+        ExclusiveLock lock(_storeLatch, _latchCoupling);
+        pnum = _store->alloc(pw.getData());
+    }
 
-    _stream->write((const char*)pw.getData(), getNodePageSize());
+    if (_isCopying)
+        _freshPages.insert(pnum);
 
-    ++_lastPageNum;
-    writePageCounter();
+    // The new page is latched before it is linked to its parent.
+    latchPage(pnum);
 
-    return _lastPageNum;
+    return pnum;
 }
 
-void BaseBTree::readPageInternal(UInt pnum, Byte* dst)
+Byte* BaseBTree::getPageView(UInt pnum)
 {
-    gotoPage(pnum);
-    _stream->read((char*)dst, getNodePageSize());
-}
+    // The views would be moved by the allocations of the concurrent modifications.
+    if (_bufferPool != nullptr || _latchCoupling)
+        return nullptr;
 
-void BaseBTree::writePageInternal(UInt pnum, const Byte* dst)
-{
-    gotoPage(pnum);
-    _stream->write((const char*)dst, getNodePageSize());
-}
+    checkForOpenStream();
+    if (pnum == 0 || pnum > getLastPageNum())
+        throw std::invalid_argument("Can't read a non-existing page");
 
-void BaseBTree::gotoPage(UInt pnum)
-{
-    UInt pageOfs = FIRST_PAGE_OFS + getNodePageSize() * (pnum - 1);
-    _stream->seekg(pageOfs, std::ios_base::beg);
+    if (_isCopying)
+        pnum = getShadowPageNum(pnum);
+
+    Byte* view = _store->view(pnum);
+    if (view != nullptr)
+        ++getThreadContext().diskOperationsCount;
+
+    return view;
 }
 
 void BaseBTree::loadTree()
@@ -743,7 +1196,7 @@ void BaseBTree::loadTree()
     Header hdr;
     readHeader(hdr);
 
-    if (_stream->fail())
+    if (!isOpened())
     {
         throw std::runtime_error("Can't read header");
     }
@@ -753,29 +1206,67 @@ void BaseBTree::loadTree()
         throw std::runtime_error("Stream is not a valid btree B-tree file");
     }
 
+    _bLink = hdr.sign == Header::BLINK_SIGN;
+    _leavesChained = hdr.sign != Header::VALID_SIGN;
+    if (_bLink && !isBLinkSupported())
+        throw std::runtime_error("Stream is a B-link tree file, which is supported by the B+-tree only");
+
     setOrder(hdr.order, hdr.recSize);
 
-    readPageCounter();
+    _store->load(PAGE_COUNTER_OFS, FIRST_PAGE_OFS, _nodePageSize);
     readRootPageNum();
 
-    if (_stream->fail())
+    if (!isOpened())
     {
         throw std::runtime_error("Can't read necessary fields. File corrupted");
     }
 
     loadRootPage();
+}
 
-#ifdef BTREE_WITH_REUSING_FREE_PAGES
+bool BaseBTree::isFull(const PageWrapper& page) const
+{
+    return page.getKeysNum() >= getMaxKeys();
+}
 
-    loadFreePagesCounter();
+UShort BaseBTree::lowerBound(const PageWrapper& page, const Byte* k) const
+{
+    UShort first = 0;
+    UShort last = page.getKeysNum();
 
-#endif
+    // The keys before first are less than k, the keys from last are not.
+    while (last - first > LINEAR_SEARCH_THRESHOLD)
+    {
+        UShort middle = first + (last - first) / 2;
+        if (_comparator->compare(page.getKey(middle), k, _recSize))
+            first = middle + 1;
+        else
+            last = middle;
+    }
+
+    for ( ; first < last && _comparator->compare(page.getKey(first), k, _recSize); ++first) ;
 
+    return first;
 }
 
-bool BaseBTree::isFull(const PageWrapper& page) const
+UShort BaseBTree::upperBound(const PageWrapper& page, const Byte* k) const
 {
-    return page.getKeysNum() == getMaxKeys();
+    UShort first = 0;
+    UShort last = page.getKeysNum();
+
+    // The keys before first are not greater than k, the keys from last are.
+    while (last - first > LINEAR_SEARCH_THRESHOLD)
+    {
+        UShort middle = first + (last - first) / 2;
+        if (!_comparator->compare(k, page.getKey(middle), _recSize))
+            first = middle + 1;
+        else
+            last = middle;
+    }
+
+    for ( ; first < last && !_comparator->compare(k, page.getKey(first), _recSize); ++first) ;
+
+    return first;
 }
 
 void BaseBTree::loadRootPage()
@@ -791,106 +1282,826 @@ void BaseBTree::loadRootPage()
 void BaseBTree::createTree(UShort order, UShort recSize)
 {
     setOrder(order, recSize);
+    _leavesChained = true;
 
     writeHeader();
-    writePageCounter();
     writeRootPageNum();
+    _store->create(PAGE_COUNTER_OFS, FIRST_PAGE_OFS, _nodePageSize);
+
+    createRootPage();
+
+    // The empty tree is committed, so it is not left half-written.
+    flushBufferPool();
+    _store->commit();
+}
+
+void BaseBTree::createRootPage()
+{
+    _rootPage.allocPage(0, true);
+    _rootPage.setAsRoot();
+}
+
+void BaseBTree::checkForOpenStream()
+{
+    if (!isOpened())
+        throw std::runtime_error("Stream is not ready");
+}
+
+void BaseBTree::writeHeader()
+{    
+    Header hdr(_order, _recSize);    
+    if (_bLink)
+        hdr.sign = Header::BLINK_SIGN;
+    else if (isLeafOriented())
+        hdr.sign = Header::CHAINED_SIGN;
+
+    _store->writeHeader(HEADER_OFS, (const Byte*)(void*)&hdr, HEADER_SIZE);
+    ++getThreadContext().diskOperationsCount;
+}
+
+void BaseBTree::readHeader(Header& hdr)
+{
+    _store->readHeader(HEADER_OFS, (Byte*)&hdr, HEADER_SIZE);
+    ++getThreadContext().diskOperationsCount;
+}
+
+void BaseBTree::writeRootPageNum()
+{
+    _store->writeHeader(ROOT_PAGE_NUM_OFS, (const Byte*)&_rootPageNum, ROOT_PAGE_NUM_SZ);
+    ++getThreadContext().diskOperationsCount;
+}
+
+void BaseBTree::readRootPageNum()
+{
+    _store->readHeader(ROOT_PAGE_NUM_OFS, (Byte*)&_rootPageNum, ROOT_PAGE_NUM_SZ);
+    ++getThreadContext().diskOperationsCount;
+}
+
+void BaseBTree::setRootPageNum(UInt pnum, bool writeFlag /*= true*/)
+{
+    _rootPageNum = pnum;
+
+    // The copy-on-write operation publishes its root at the end.
+    if (writeFlag && !_isCopying)
+        writeRootPageNum();
+}
+
+void BaseBTree::setOrder(UShort order, UShort recSize)
+{
+    if (order < 2)
+        throw std::invalid_argument("Order should not be the less than 2");
+
+    _order = order;
+    _recSize = recSize;
+
+    _minKeys = _order - 1;
+    _maxKeys = 2 * _order - 1;
+
+    if (_maxKeys > MAX_KEYS_NUM)
+        throw std::invalid_argument("For a given B-tree order, there is an excess of the maximum number of keys");
+
+    _keysSize = _recSize * _maxKeys;
+    _cursorsOfs = _keysSize + KEYS_OFS;
+    _nodePageSize = _cursorsOfs + CURSOR_SZ * (_maxKeys + 1);
+
+    reallocWorkPages();
+}
+
+void BaseBTree::reallocWorkPages()
+{
+    deletePathPages();
+    resetPageBuffers(_nodePageSize);
+    _rootPage.reallocData(_nodePageSize);
+
+    resetBufferPool();
+}
+
+Byte* BaseBTree::acquirePageBuffer(UInt sz)
+{
+    std::lock_guard<std::mutex> lock(_pageBuffersMutex);
+
+    if (sz == _freePageBuffersSize && !_freePageBuffers.empty())
+    {
+        Byte* buffer = _freePageBuffers.back();
+        _freePageBuffers.pop_back();
+        ++_pageBuffersReusesCount;
+
+        return buffer;
+    }
+
+    ++_pageBuffersAllocsCount;
+
+    return new Byte[sz];
+}
+
+void BaseBTree::releasePageBuffer(Byte* buffer, UInt sz)
+{
+    std::lock_guard<std::mutex> lock(_pageBuffersMutex);
+
+    if (sz == _freePageBuffersSize && _freePageBuffers.size() < MAX_FREE_PAGE_BUFFERS)
+        _freePageBuffers.push_back(buffer);
+    else
+        delete[] buffer;
+}
+
+void BaseBTree::resetPageBuffers(UInt sz)
+{
+    std::lock_guard<std::mutex> lock(_pageBuffersMutex);
+
+    for (std::vector<Byte*>::iterator iter = _freePageBuffers.begin(); iter != _freePageBuffers.end(); ++iter)
+        delete[] *iter;
+
+    _freePageBuffers.clear();
+    _freePageBuffersSize = sz;
+}
+
+BaseBTree::ThreadContext& BaseBTree::getThreadContext() const
+{
+    // The thread's last used context is cached, so the map is searched when the thread switches the trees only.
+    // The trees' numbers are not reused, so the cached context of a destructed tree is never matched.
+    thread_local UInt cachedTreeId = 0;
+    thread_local ThreadContext* cachedContext = nullptr;
+
+    if (cachedTreeId == _treeId)
+        return *cachedContext;
+
+    std::lock_guard<std::mutex> lock(_threadContextsMutex);
+
+    ThreadContext*& context = _threadContexts[std::this_thread::get_id()];
+    if (context == nullptr)
+        context = new ThreadContext();
+
+    cachedTreeId = _treeId;
+    cachedContext = context;
+
+    return *context;
+}
+
+void BaseBTree::deletePathPages()
+{
+    std::lock_guard<std::mutex> lock(_threadContextsMutex);
+
+    for (std::map<std::thread::id, ThreadContext*>::iterator context = _threadContexts.begin();
+            context != _threadContexts.end(); ++context)
+    {
+        std::vector<PageWrapper*>& pathPages = context->second->pathPages;
+        for (std::vector<PageWrapper*>::iterator iter = pathPages.begin(); iter != pathPages.end(); ++iter)
+            delete *iter;
+
+        pathPages.clear();
+    }
+}
+
+void BaseBTree::setCopyOnWrite(bool copyOnWrite)
+{
+    if (copyOnWrite && isLeafOriented())
+        throw std::logic_error("Copy-on-write is not supported by the trees with the chained leaves");
+
+    if (copyOnWrite && _latchCoupling)
+        throw std::logic_error("Copy-on-write is not supported with the latch coupling");
+
+    if (!copyOnWrite && !_snapshotVersions.empty())
+        throw std::logic_error("Can't turn copy-on-write off while there are snapshots");
+
+    _copyOnWrite = copyOnWrite;
+}
+
+void BaseBTree::setLatchCoupling(bool latchCoupling)
+{
+    if (latchCoupling && _copyOnWrite)
+        throw std::logic_error("Latch coupling is not supported in the copy-on-write mode");
+
+    _latchCoupling = latchCoupling;
+}
+
+void BaseBTree::setBLink(bool bLink)
+{
+    if (bLink && !isBLinkSupported())
+        throw std::logic_error("B-link mode is supported by the B+-tree only");
+
+    if (_rootPageNum != 0)
+        throw std::logic_error("B-link mode can't be changed after the tree is created");
+
+    _bLink = bLink;
+}
+
+void BaseBTree::linkSiblings()
+{
+    if (!_bLink)
+        return;
+
+    // Each level's pages and their high keys are listed by their parents from left to right.
+    std::vector<UInt> pages(1, _rootPageNum);
+    std::vector<Byte> highKeys(_recSize);
+    PageWrapper page(this);
+    while (!pages.empty())
+    {
+        std::vector<UInt> children;
+        std::vector<Byte> childrenHighKeys;
+        for (size_t j = 0; j < pages.size(); ++j)
+        {
+            page.readPage(pages[j]);
+            page.setRightLink(j + 1 < pages.size() ? pages[j + 1] : 0);
+            page.copyKey(page.getHighKey(), &highKeys[j * _recSize]);
+            page.writePage();
+
+            if (page.isLeaf())
+                continue;
+
+            UShort keysNum = page.getKeysNum();
+            for (UShort i = 0; i <= keysNum; ++i)
+            {
+                children.push_back(page.getCursor(i));
+                const Byte* highKey = i < keysNum ? page.getKey(i) : page.getHighKey();
+                childrenHighKeys.insert(childrenHighKeys.end(), highKey, highKey + _recSize);
+            }
+        }
+
+        pages.swap(children);
+        highKeys.swap(childrenHighKeys);
+    }
+
+    loadRootPage();
+}
+
+void BaseBTree::linkSplitPages(PageWrapper& node, UShort iChild, PageWrapper& leftChild, PageWrapper& rightChild)
+{
+    if (!_bLink)
+        return;
+
+    if (!leftChild.isLeaf())
+    {
+        rightChild.setRightLink(leftChild.getRightLink());
+        leftChild.setRightLink(rightChild.getPageNum());
+    }
+
+    rightChild.copyKey(rightChild.getHighKey(), leftChild.getHighKey());
+    leftChild.copyKey(leftChild.getHighKey(), node.getKey(iChild));
+}
+
+void BaseBTree::linkMergedPages(PageWrapper& leftChild, PageWrapper& rightChild)
+{
+    if (!_bLink)
+        return;
+
+    if (!leftChild.isLeaf())
+        leftChild.setRightLink(rightChild.getRightLink());
+
+    leftChild.copyKey(leftChild.getHighKey(), rightChild.getHighKey());
+}
+
+BaseBTree::PageWrapper& BaseBTree::getSearchRootPage(PathPages& path)
+{
+    if (!_latchCoupling || getThreadContext().latchMode == SHARED_LATCHES)
+        return _rootPage;
+
+    PageWrapper& root = path.take();
+    root.readPage(_rootPageNum);
+    return root;
+}
+
+bool BaseBTree::isPastHighKey(const PageWrapper& page, const Byte* k) const
+{
+    return _bLink && page.getRightLink() != 0 && _comparator->compare(page.getHighKey(), k, _recSize);
+}
+
+BaseBTree::PageWrapper& BaseBTree::moveRight(PageWrapper& page, const Byte* k, PathPages& path)
+{
+    PageWrapper* current = &page;
+    while (isPastHighKey(*current, k))
+    {
+        PageWrapper& rightPage = path.take();
+        rightPage.viewPage(current->getRightLink());
+        current = &rightPage;
+    }
+
+    return *current;
+}
+
+void BaseBTree::beginLatching(LatchedOperation operation)
+{
+    ThreadContext& context = getThreadContext();
+    bool isModifying = operation != SEARCH_OPERATION && operation != OPTIMISTIC_SEARCH_OPERATION;
+
+    // The B-link tree's removals merge and free the pages which its searches pass without latches.
+    if (!_latchCoupling || (_bLink && operation == REMOVE_OPERATION))
+    {
+        if (isModifying)
+            _latch.lock();
+        else
+            _latch.lockShared();
+
+        context.isTreeLatchExclusive = isModifying;
+        return;
+    }
+
+    _latch.lockShared();
+    context.isTreeLatchExclusive = false;
+
+    // The B-link tree's searches follow the right links past the concurrent splits instead.
+    if (_bLink && !isModifying)
+        return;
+
+    if (isModifying)
+        context.latchMode = EXCLUSIVE_LATCHES;
+    else
+        context.latchMode = operation == OPTIMISTIC_SEARCH_OPERATION ? OPTIMISTIC_LATCHES : SHARED_LATCHES;
+
+    latchPage(_rootPageNum);
+
+    if (!isModifying || isRootSafe(operation))
+        return;
+
+    // The root page's number is changed under the exclusive tree's latch only.
+    endLatching();
+    _latch.lock();
+    context.isTreeLatchExclusive = true;
+}
+
+void BaseBTree::endLatching()
+{
+    ThreadContext& context = getThreadContext();
+
+    for (std::vector<UInt>::const_iterator iter = context.latchedPages.begin();
+            iter != context.latchedPages.end(); ++iter)
+        releasePageLatch(*iter);
+
+    context.latchedPages.clear();
+    context.latchedVersions.clear();
+    context.latchMode = NO_LATCHES;
+
+    if (context.isTreeLatchExclusive)
+        _latch.unlock();
+    else
+        _latch.unlockShared();
+
+    context.isTreeLatchExclusive = false;
+}
+
+void BaseBTree::restartLatching(LatchedOperation operation)
+{
+    // The operation holding the tree's latch exclusively has nothing to restart.
+    if (getThreadContext().latchMode == NO_LATCHES)
+        return;
+
+    endLatching();
+    beginLatching(operation);
+}
+
+bool BaseBTree::isRootSafe(LatchedOperation operation)
+{
+    if (_rootPageNum == 0)
+        return false;
+
+    if (operation == INSERT_OPERATION)
+        return !_rootPage.isFull();
+
+    // The root is replaced when its last keys are moved to the merged children,
+    // which takes up to two keys in the B*-trees.
+    return _rootPage.isLeaf() || _rootPage.getKeysNum() > 2;
+}
+
+void BaseBTree::latchPage(UInt pnum)
+{
+    if (!_latchCoupling || pnum == 0)
+        return;
+
+    ThreadContext& context = getThreadContext();
+    if (context.latchMode == NO_LATCHES)
+        return;
+
+    std::vector<UInt>& latchedPages = context.latchedPages;
+    if (std::find(latchedPages.begin(), latchedPages.end(), pnum) != latchedPages.end())
+        return;
+
+    if (context.latchMode == OPTIMISTIC_LATCHES)
+        context.latchedVersions.push_back(_pageVersions.readVersion(pnum));
+    else if (context.latchMode == SHARED_LATCHES)
+        _pageLatches.lockShared(pnum);
+    else
+        _pageLatches.lock(pnum);
+
+    latchedPages.push_back(pnum);
+}
+
+void BaseBTree::unlatchPage(UInt pnum)
+{
+    if (!_latchCoupling)
+        return;
+
+    ThreadContext& context = getThreadContext();
+    std::vector<UInt>& latchedPages = context.latchedPages;
+    std::vector<UInt>::iterator found = std::find(latchedPages.begin(), latchedPages.end(), pnum);
+    if (found == latchedPages.end())
+        return;
+
+    if (context.latchMode == OPTIMISTIC_LATCHES)
+        context.latchedVersions.erase(context.latchedVersions.begin() + (found - latchedPages.begin()));
+
+    releasePageLatch(pnum);
+    latchedPages.erase(found);
+}
+
+void BaseBTree::releasePageLatch(UInt pnum)
+{
+    LatchMode latchMode = getThreadContext().latchMode;
+    if (latchMode == SHARED_LATCHES)
+        _pageLatches.unlockShared(pnum);
+    else if (latchMode == EXCLUSIVE_LATCHES)
+    {
+        // The version is changed before the page can be latched by another modification.
+        unlockLatchedVersion(pnum);
+        _pageLatches.unlock(pnum);
+    }
+}
+
+BaseBTree::LatchedOperation BaseBTree::getSearchOperation(UInt restarts) const
+{
+    return _optimisticSearch && restarts < MAX_OPTIMISTIC_RESTARTS ? OPTIMISTIC_SEARCH_OPERATION : SEARCH_OPERATION;
+}
+
+void BaseBTree::validateLatchedPages()
+{
+    ThreadContext& context = getThreadContext();
+    if (context.latchMode != OPTIMISTIC_LATCHES)
+        return;
+
+    for (size_t i = 0; i < context.latchedPages.size(); ++i)
+    {
+        if (!_pageVersions.isValid(context.latchedPages[i], context.latchedVersions[i]))
+            throw OptimisticRestart();
+    }
+}
+
+void BaseBTree::lockLatchedVersions()
+{
+    if (!_optimisticSearch)
+        return;
+
+    ThreadContext& context = getThreadContext();
+    if (context.latchMode != EXCLUSIVE_LATCHES)
+        return;
+
+    // The ancestors still latched can be modified by the rest of the operation as well.
+    std::vector<UInt>& lockedPages = context.lockedVersionPages;
+    for (std::vector<UInt>::const_iterator iter = context.latchedPages.begin();
+            iter != context.latchedPages.end(); ++iter)
+    {
+        if (std::find(lockedPages.begin(), lockedPages.end(), *iter) == lockedPages.end())
+        {
+            _pageVersions.lock(*iter);
+            lockedPages.push_back(*iter);
+        }
+    }
+}
+
+void BaseBTree::unlockLatchedVersion(UInt pnum)
+{
+    std::vector<UInt>& lockedPages = getThreadContext().lockedVersionPages;
+    std::vector<UInt>::iterator found = std::find(lockedPages.begin(), lockedPages.end(), pnum);
+    if (found == lockedPages.end())
+        return;
+
+    _pageVersions.unlock(pnum);
+    lockedPages.erase(found);
+}
+
+void BaseBTree::latchChildPage(PageWrapper& pw, UShort chNum)
+{
+    if (!_latchCoupling || !isLeafOriented())
+        return;
+
+    ThreadContext& context = getThreadContext();
+    if (context.latchMode != EXCLUSIVE_LATCHES)
+        return;
+
+    // The parent is latched exclusively, so the released siblings can only be read by the leaves' scans.
+    std::vector<UInt> rightSiblings;
+    UShort keysNum = pw.getKeysNum();
+    for (UShort i = chNum + 1; i <= keysNum; ++i)
+    {
+        UInt sibling = pw.getCursor(i);
+        std::vector<UInt>& latchedPages = context.latchedPages;
+        if (std::find(latchedPages.begin(), latchedPages.end(), sibling) != latchedPages.end())
+        {
+            unlatchPage(sibling);
+            rightSiblings.push_back(sibling);
+        }
+    }
+
+    latchPage(pw.getCursor(chNum));
+
+    for (std::vector<UInt>::const_iterator iter = rightSiblings.begin(); iter != rightSiblings.end(); ++iter)
+        latchPage(*iter);
+}
+
+void BaseBTree::releaseAncestorLatches(const PageWrapper& page)
+{
+    if (!_latchCoupling)
+        return;
+
+    ThreadContext& context = getThreadContext();
+    if (context.latchMode == NO_LATCHES || context.keptLatchesDepth != 0)
+        return;
+
+    UInt pnum = page.getPageNum();
+    bool isLatched = false;
+    ULong version = 0;
+    for (size_t i = 0; i < context.latchedPages.size(); ++i)
+    {
+        if (context.latchedPages[i] != pnum)
+            releasePageLatch(context.latchedPages[i]);
+        else
+        {
+            isLatched = true;
+            if (context.latchMode == OPTIMISTIC_LATCHES)
+                version = context.latchedVersions[i];
+        }
+    }
+
+    context.latchedPages.clear();
+    context.latchedVersions.clear();
+    if (!isLatched)
+        return;
+
+    context.latchedPages.push_back(pnum);
+    if (context.latchMode == OPTIMISTIC_LATCHES)
+        context.latchedVersions.push_back(version);
+}
+
+UInt BaseBTree::getShadowPageNum(UInt pnum) const
+{
+    std::map<UInt, UInt>::const_iterator shadow = _shadowPages.find(pnum);
+    return shadow != _shadowPages.end() ? shadow->second : pnum;
+}
+
+void BaseBTree::commitCopyOnWrite()
+{
+    bool isModified = !_shadowPages.empty() || !_freshPages.empty() || !_replacedPages.empty();
+
+    // The parent of each copied page is copied as well to point at the copy, up to the root.
+    std::vector<UInt> copiedPages;
+    for (std::map<UInt, UInt>::const_iterator iter = _shadowPages.begin(); iter != _shadowPages.end(); ++iter)
+        copiedPages.push_back(iter->first);
+
+    PageWrapper parent(this);
+    while (!copiedPages.empty())
+    {
+        UInt pnum = copiedPages.back();
+        copiedPages.pop_back();
+
+        if (pnum == _rootPageNum)
+            continue;
+
+        std::map<UInt, UInt>::const_iterator parentIter = _parentPages.find(pnum);
+        if (parentIter == _parentPages.end())
+            throw std::logic_error("Parent of the copied page is unknown");
+
+        UInt parentNum = parentIter->second;
+        bool isParentCopied = _shadowPages.count(parentNum) != 0 || _freshPages.count(parentNum) != 0;
+
+        parent.readPage(parentNum);
+
+        UShort keysNum = parent.getKeysNum();
+        UShort i = 0;
+        while (i <= keysNum && parent.getCursor(i) != pnum)
+            ++i;
+
+        if (i > keysNum)
+            throw std::logic_error("Copied page is not found in its parent");
+
+        parent.setCursor(i, _shadowPages[pnum]);
+        parent.writePage();
+
+        if (!isParentCopied)
+            copiedPages.push_back(parentNum);
+    }
+
+    UInt rootPageNum = getShadowPageNum(_rootPageNum);
+    for (std::map<UInt, UInt>::const_iterator iter = _shadowPages.begin(); iter != _shadowPages.end(); ++iter)
+        _replacedPages.push_back(iter->first);
+
+    _isCopying = false;
+    _shadowPages.clear();
+    _freshPages.clear();
+    _parentPages.clear();
+
+    if (!isModified)
+        return;
+
+    // The copies are written before the root page number which publishes them.
+    flushBufferPool();
+    setRootPageNum(rootPageNum);
+    loadRootPage();
+
+    ++_version;
+    for (std::vector<UInt>::const_iterator iter = _replacedPages.begin(); iter != _replacedPages.end(); ++iter)
+        _retiredPages.push_back(std::make_pair(_version, *iter));
+
+    _replacedPages.clear();
+
+    freeRetiredPages();
+}
+
+void BaseBTree::abortCopyOnWrite()
+{
+    _isCopying = false;
+
+#ifdef BTREE_WITH_REUSING_FREE_PAGES
+
+    for (std::map<UInt, UInt>::const_iterator iter = _shadowPages.begin(); iter != _shadowPages.end(); ++iter)
+        markPageFree(iter->second);
+
+    for (std::set<UInt>::const_iterator iter = _freshPages.begin(); iter != _freshPages.end(); ++iter)
+        markPageFree(*iter);
+
+#endif
+
+    _shadowPages.clear();
+    _freshPages.clear();
+    _parentPages.clear();
+    _replacedPages.clear();
+
+    _rootPageNum = _publishedRootPageNum;
+    loadRootPage();
+}
+
+void BaseBTree::freeRetiredPages()
+{
+
+#ifdef BTREE_WITH_REUSING_FREE_PAGES
+
+    // The page replaced by the version v is read by the snapshots of the versions before v only.
+    UInt oldestVersion = _snapshotVersions.empty() ? _version : *_snapshotVersions.begin();
+    while (!_retiredPages.empty() && _retiredPages.front().first <= oldestVersion)
+    {
+        markPageFree(_retiredPages.front().second);
+        _retiredPages.pop_front();
+    }
+
+#endif
+
+}
+
+#ifdef BTREE_WITH_REUSING_FREE_PAGES
+
+bool BaseBTree::retirePage(UInt pageNum)
+{
+    // The page allocated by the operation is not published, so it is freed at once.
+    if (_freshPages.erase(pageNum) != 0)
+        return false;
+
+    std::map<UInt, UInt>::iterator shadow = _shadowPages.find(pageNum);
+    if (shadow != _shadowPages.end())
+    {
+        if (_bufferPool != nullptr)
+            _bufferPool->discard(shadow->second);
 
-    createRootPage();
+        _store->free(shadow->second);
+        _shadowPages.erase(shadow);
+    }
 
-#ifdef BTREE_WITH_REUSING_FREE_PAGES
+    _replacedPages.push_back(pageNum);
 
-    writeFreePagesCounter();
+    return true;
+}
 
 #endif
 
-}
+//==============================================================================
+// class BaseBTree::Snapshot
+//==============================================================================
 
-void BaseBTree::createRootPage()
+BaseBTree::Snapshot::Snapshot(BaseBTree* tree)
+    : _tree(tree)
+    , _rootPageNum(0)
+    , _version(0)
 {
-    _rootPage.allocPage(0, true);
-    _rootPage.setAsRoot();
+    if (!_tree->_copyOnWrite)
+        throw std::logic_error("Snapshots are available in the copy-on-write mode only");
+
+    ExclusiveLock lock(_tree->_latch);
+    _rootPageNum = _tree->getRootPageNum();
+    _version = _tree->_version;
+    _tree->_snapshotVersions.insert(_version);
 }
 
-void BaseBTree::checkForOpenStream()
+BaseBTree::Snapshot::~Snapshot()
 {
-    if (!isOpened())
-        throw std::runtime_error("Stream is not ready");
-}
+    ExclusiveLock lock(_tree->_latch);
+    _tree->_snapshotVersions.erase(_tree->_snapshotVersions.find(_version));
 
-void BaseBTree::writeHeader()
-{    
-    Header hdr(_order, _recSize);    
-    _stream->write((const char*)(void*)&hdr, HEADER_SIZE);
-    ++_diskOperationsCount;
+    if (!_tree->isOpened())
+        return;
+
+    try {
+        _tree->freeRetiredPages();
+    }
+    catch (...)
+    {
+    }
 }
 
-void BaseBTree::readHeader(Header& hdr)
+bool BaseBTree::Snapshot::search(const Byte* k, Byte* result)
 {
-    _stream->seekg(HEADER_OFS, std::ios_base::beg);
-    _stream->read((char*)&hdr, HEADER_SIZE);
-    ++_diskOperationsCount;
+    if (_tree->_comparator == nullptr)
+        throw std::runtime_error("Comparator not set. Can't search");
+
+    SharedLock lock(_tree->_latch);
+    PageWrapper root(_tree);
+    root.viewPage(_rootPageNum);
+
+    return _tree->search(k, result, root, 1);
 }
 
-void BaseBTree::writePageCounter()
+//==============================================================================
+// class BaseBTree::CopyOnWriteScope
+//==============================================================================
+
+BaseBTree::CopyOnWriteScope::CopyOnWriteScope(BaseBTree* tree)
+    : _tree(tree)
+    , _isActive(tree->_copyOnWrite)
 {
-    _stream->seekg(PAGE_COUNTER_OFS, std::ios_base::beg);
-    _stream->write((const char*)&_lastPageNum, PAGE_COUNTER_SZ);
-    ++_diskOperationsCount;
+    if (!_isActive)
+        return;
+
+    _tree->_isCopying = true;
+    _tree->_publishedRootPageNum = _tree->_rootPageNum;
 }
 
-void BaseBTree::readPageCounter()
+BaseBTree::OperationScope::~OperationScope()
 {
-    _stream->seekg(PAGE_COUNTER_OFS, std::ios_base::beg);
-    _stream->read((char*)&_lastPageNum, PAGE_COUNTER_SZ);
-    ++_diskOperationsCount;
+    if (!_isActive)
+        return;
+
+    try {
+        _tree->abortOperation();
+    }
+    catch (...)
+    {
+    }
 }
 
-void BaseBTree::writeRootPageNum()
+void BaseBTree::OperationScope::end()
 {
-    _stream->seekg(ROOT_PAGE_NUM_OFS, std::ios_base::beg);
-    _stream->write((const char*)&_rootPageNum, ROOT_PAGE_NUM_SZ);
-    ++_diskOperationsCount;
+    _isActive = false;
+    _tree->endOperation();
 }
 
-void BaseBTree::readRootPageNum()
+BaseBTree::CopyOnWriteScope::~CopyOnWriteScope()
 {
-    _stream->seekg(ROOT_PAGE_NUM_OFS, std::ios_base::beg);
-    _stream->read((char*)&_rootPageNum, ROOT_PAGE_NUM_SZ);
-    ++_diskOperationsCount;
+    if (!_isActive)
+        return;
+
+    try {
+        _tree->abortCopyOnWrite();
+    }
+    catch (...)
+    {
+    }
 }
 
-void BaseBTree::setRootPageNum(UInt pnum, bool writeFlag /*= true*/)
+void BaseBTree::CopyOnWriteScope::commit()
 {
-    _rootPageNum = pnum;
-    if (writeFlag)
-        writeRootPageNum();
+    if (!_isActive)
+        return;
+
+    _tree->commitCopyOnWrite();
+    _isActive = false;
 }
 
-void BaseBTree::setOrder(UShort order, UShort recSize)
-{
-    if (order < 2)
-        throw std::invalid_argument("Order should not be the less than 2");
+//==============================================================================
+// class BaseBTree::PathPages
+//==============================================================================
 
-    _order = order;
-    _recSize = recSize;
+BaseBTree::PathPages::~PathPages()
+{
+    for (UInt i = _firstPage; i < _context.pathPagesUsed; ++i)
+        _context.pathPages[i]->reallocData(0);
 
-    _minKeys = _order - 1;
-    _maxKeys = 2 * _order - 1;
+    _context.pathPagesUsed = _firstPage;
+}
 
-    if (_maxKeys > MAX_KEYS_NUM)
-        throw std::invalid_argument("For a given B-tree order, there is an excess of the maximum number of keys");
+BaseBTree::PageWrapper& BaseBTree::PathPages::take()
+{
+    // The new page acquires its buffer by the constructor, the free path pages have no buffers.
+    if (_context.pathPagesUsed == _context.pathPages.size())
+        _context.pathPages.push_back(new PageWrapper(_tree));
+    else
+        _context.pathPages[_context.pathPagesUsed]->reallocData(_tree->getNodePageSize());
 
-    _keysSize = _recSize * _maxKeys;
-    _cursorsOfs = _keysSize + KEYS_OFS;
-    _nodePageSize = _cursorsOfs + CURSOR_SZ * (_maxKeys + 1);
+    PageWrapper& page = *_context.pathPages[_context.pathPagesUsed++];
+    page.reset();
 
-    reallocWorkPages();
+    return page;
 }
 
-void BaseBTree::reallocWorkPages()
+BaseBTree::PageWrapper& BaseBTree::PathPages::at(UInt level)
 {
-    _rootPage.reallocData(_nodePageSize);
+    while (_context.pathPagesUsed - _firstPage <= level)
+        take();
+
+    return *_context.pathPages[_firstPage + level];
 }
 
 //==============================================================================
@@ -899,6 +2110,8 @@ void BaseBTree::reallocWorkPages()
 
 BaseBTree::PageWrapper::PageWrapper(BaseBTree* tr) :
     _data(nullptr)
+    , _buffer(nullptr)
+    , _bufferSize(0)
     , _tree(tr)
     , _pageNum(0)
 {
@@ -913,19 +2126,26 @@ BaseBTree::PageWrapper::~PageWrapper()
 
 void BaseBTree::PageWrapper::reallocData(UInt sz)
 {
-    if (_data)
+    if (_buffer)
     {
-        delete[] _data;
-        _data = nullptr;
+        _tree->releasePageBuffer(_buffer, _bufferSize);
+        _buffer = nullptr;
+        _bufferSize = 0;
     }
 
     if (sz)
-        _data = new Byte[sz];
-        
+    {
+        _buffer = _tree->acquirePageBuffer(sz);
+        _bufferSize = sz;
+    }
+
+    _data = _buffer;
 }
 
 void BaseBTree::PageWrapper::clear()
 {
+    _data = _buffer;
+
     if (!_data)
         return;
 
@@ -942,6 +2162,10 @@ void BaseBTree::PageWrapper::setKeyNumLeaf(UShort keysNum, bool isRoot, bool isL
 
 void BaseBTree::PageWrapper::setKeyNum(UShort keysNum, bool isRoot) //NodeType nt)
 {
+    // The keys beyond the page's keys area would overwrite the cursors and the following memory.
+    if ((UInt)keysNum * _tree->_recSize > _tree->_keysSize)
+        throw std::domain_error("Keys number exceeds the page's capacity");
+
     UShort kldata = *((UShort*)&_data[0]);
     kldata &= LEAF_NODE_MASK;
     kldata |= keysNum;
@@ -1029,6 +2253,42 @@ UInt BaseBTree::PageWrapper::getCursor(UShort cnum)
     return *((const UInt*)(_data + curOfs));
 }
 
+UInt BaseBTree::PageWrapper::getNextLeaf() const
+{
+    return *((const UInt*)(_data + _tree->getCursorsOfs()));
+}
+
+void BaseBTree::PageWrapper::setNextLeaf(UInt pnum)
+{
+    *((UInt*)(_data + _tree->getCursorsOfs())) = pnum;
+}
+
+UInt BaseBTree::PageWrapper::getRightLink() const
+{
+    if (isLeaf())
+        return getNextLeaf();
+
+    return *((const UInt*)(_data + _tree->_linksOfs));
+}
+
+void BaseBTree::PageWrapper::setRightLink(UInt pnum)
+{
+    if (isLeaf())
+        setNextLeaf(pnum);
+    else
+        *((UInt*)(_data + _tree->_linksOfs)) = pnum;
+}
+
+Byte* BaseBTree::PageWrapper::getHighKey()
+{
+    return _data + _tree->_linksOfs + CURSOR_SZ;
+}
+
+const Byte* BaseBTree::PageWrapper::getHighKey() const
+{
+    return _data + _tree->_linksOfs + CURSOR_SZ;
+}
+
 Byte* BaseBTree::PageWrapper::getCursorPtr(UShort cnum)
 {
     int curOfs = getCursorOfs(cnum);
@@ -1084,10 +2344,38 @@ void BaseBTree::PageWrapper::readPageFromChild(PageWrapper& pw, UShort chNum)
     {
         throw std::invalid_argument("Cursor does not point to a existing node/page");
     }
-    
+
+    if (_tree->_isCopying)
+        _tree->_parentPages[cur] = pw.getPageNum();
+
+    _tree->latchChildPage(pw, chNum);
     readPage(cur);
 }
 
+void BaseBTree::PageWrapper::viewPage(UInt pnum)
+{
+    Byte* view = _tree->getPageView(pnum);
+    if (view != nullptr)
+    {
+        _data = view;
+        _pageNum = pnum;
+        return;
+    }
+
+    readPage(pnum);
+}
+
+void BaseBTree::PageWrapper::viewPageFromChild(PageWrapper& pw, UShort chNum)
+{
+    UInt cur = pw.getCursor(chNum);
+    if (cur == 0)
+    {
+        throw std::invalid_argument("Cursor does not point to a existing node/page");
+    }
+
+    viewPage(cur);
+}
+
 void BaseBTree::PageWrapper::writePage()
 {
     if (getPageNum() == 0)
@@ -1172,185 +2460,178 @@ void BaseBPlusTree::splitChild(PageWrapper& node, UShort iChild, PageWrapper& le
     node.copyKey(node.getKey(iChild), leftChild.getKey(getMinLeafKeys() - 1));
     leftChild.setKeyNum(getMinLeafKeys());
 
-    leftChild.writePage();
+    rightChild.setNextLeaf(leftChild.getNextLeaf());
+    leftChild.setNextLeaf(rightChild.getPageNum());
+    linkSplitPages(node, iChild, leftChild, rightChild);
+
+    // The new leaf is written before the pages linking it.
     rightChild.writePage();
+    leftChild.writePage();
     node.writePage();
 }
 
-Byte* BaseBPlusTree::search(const Byte* k, BaseBTree::PageWrapper& currentPage, UInt currentDepth)
+bool BaseBPlusTree::search(const Byte* k, Byte* result, BaseBTree::PageWrapper& page, UInt currentDepth)
 {
-    if(currentDepth > _maxSearchDepth)
-        _maxSearchDepth = currentDepth;
+    PathPages path(this);
+    UInt& maxSearchDepth = getThreadContext().maxSearchDepth;
+    PageWrapper* current = &page;
+    for( ; ; ++currentDepth)
+    {
+        PageWrapper& currentPage = moveRight(*current, k, path);
+        releaseAncestorLatches(currentPage);
 
-    int i;
-    UShort keysNum = currentPage.getKeysNum();
-    for(i = 0; i < keysNum && _comparator->compare(currentPage.getKey(i), k, _recSize); ++i) ;
+        if(currentDepth > maxSearchDepth)
+            maxSearchDepth = currentDepth;
 
-    if(currentPage.isLeaf())
-    {
-        if(i < keysNum && _comparator->isEqual(k, currentPage.getKey(i), _recSize))
+        UShort keysNum = currentPage.getKeysNum();
+        int i = lowerBound(currentPage, k);
+
+        if(currentPage.isLeaf())
         {
-            Byte* result = new Byte[_recSize];
-            currentPage.copyKey(result, currentPage.getKey(i));
-            return result;
+            if(i < keysNum && _comparator->isEqual(k, currentPage.getKey(i), _recSize))
+            {
+                currentPage.copyKey(result, currentPage.getKey(i));
+                return true;
+            }
+            else
+                return false;
         }
-        else
-            return nullptr;
-    }
-    else
-    {
-        PageWrapper nextPage(this);
-        nextPage.readPageFromChild(currentPage, i);
-        return search(k, nextPage, currentDepth + 1);
+
+        PageWrapper& nextPage = path.take();
+        nextPage.viewPageFromChild(currentPage, i);
+        current = &nextPage;
     }
 }
 
-int BaseBPlusTree::searchAll(const Byte* k, std::list<Byte*>& keys, BaseBTree::PageWrapper& currentPage,
+int BaseBPlusTree::searchAll(const Byte* k, IKeyVisitor& visitor, BaseBTree::PageWrapper& currentPage,
                 UInt currentDepth)
 {
-    if(currentDepth > _maxSearchDepth)
-        _maxSearchDepth = currentDepth;
-
-    int amount = 0;
-    int i;
-    UShort keysNum = currentPage.getKeysNum();
-    bool isLeaf = currentPage.isLeaf();
+    return searchRangeInLeaves(k, k, visitor, currentPage, currentDepth);
+}
 
-    for(i = 0; i < keysNum && _comparator->compare(currentPage.getKey(i), k, _recSize); ++i) ;
+int BaseBPlusTree::searchRange(const Byte* lo, const Byte* hi, IKeyVisitor& visitor,
+        BaseBTree::PageWrapper& currentPage, UInt currentDepth)
+{
+    return searchRangeInLeaves(lo, hi, visitor, currentPage, currentDepth);
+}
 
-    int first = i;
+#ifdef BTREE_WITH_DELETION
 
-    PageWrapper nextPage(this);
-    for( ; i < keysNum && (i == first || _comparator->isEqual(k, currentPage.getKey(i), _recSize)); ++i)
-    {
-        if(isLeaf && _comparator->isEqual(k, currentPage.getKey(i), _recSize))
-        {
-            Byte* result = new Byte[_recSize];
-            currentPage.copyKey(result, currentPage.getKey(i));
-            keys.push_back(result);
-            ++amount;
-        }
+bool BaseBPlusTree::remove(const Byte* k, BaseBTree::PageWrapper& page)
+{
+    PathPages path(this);
+    PageWrapper* current = &page;
 
-        if(!isLeaf)
-        {
-            nextPage.readPageFromChild(currentPage, i);
-            amount += searchAll(k, keys, nextPage, currentDepth + 1);
-        }
-    }
+    // The router of the lowest ancestor whose subtree's last leaf is descended into. It is the subtree's
+    // max key, so it is replaced by the leaf's new max key when the leaf's max key is removed.
+    PageWrapper* routerPage = nullptr;
+    UShort routerNum = 0;
 
-    if(!isLeaf)
+    // The B-link tree's pages below the router, which is their high key.
+    std::vector<PageWrapper*> routedPages;
+    for( ; ; )
     {
-        nextPage.readPageFromChild(currentPage, i);
-        amount += searchAll(k, keys, nextPage, currentDepth + 1);
-    }
-
-    return amount;
-}
+        PageWrapper& currentPage = *current;
 
-#ifdef BTREE_WITH_DELETION
+        // The ancestor whose router is the removed key keeps its latch.
+        if(routerPage == nullptr || !_comparator->isEqual(k, routerPage->getKey(routerNum), _recSize))
+            releaseAncestorLatches(currentPage);
 
-bool BaseBPlusTree::remove(const Byte* k, BaseBTree::PageWrapper& currentPage)
-{
-    int i;
-    UShort keysNum = currentPage.getKeysNum();
-    for(i = 0; i < keysNum && _comparator->compare(currentPage.getKey(i), k, _recSize); ++i) ;
+        UShort keysNum = currentPage.getKeysNum();
+        int i = lowerBound(currentPage, k);
 
-    if(currentPage.isLeaf())
-    {
-        if(i < keysNum && _comparator->isEqual(k, currentPage.getKey(i), _recSize))
-            return removeByKeyNum(i, currentPage);
-        else
-            return false;
-    }
-    else
-    {
-        PageWrapper nextPage(this);
-        nextPage.readPageFromChild(currentPage, i);
-        if (!nextPage.isRoot() && nextPage.getKeysNum() == (nextPage.isLeaf() ? getMinLeafKeys() : getMinKeys()))
+        if(currentPage.isLeaf())
         {
-            bool isLeaf = nextPage.isLeaf();
-            UShort minKeys = isLeaf ? getMinLeafKeys() : getMinKeys();
+            if(i >= keysNum || !_comparator->isEqual(k, currentPage.getKey(i), _recSize))
+                return false;
 
-            PageWrapper leftSibling(this);
-            PageWrapper rightSibling(this);
+            removeByKeyNum(i, currentPage);
 
-            if (i > 0)
+            if(routerPage != nullptr && i == keysNum - 1 && i > 0
+                    && _comparator->isEqual(k, routerPage->getKey(routerNum), _recSize))
             {
-                leftSibling.readPageFromChild(currentPage, i - 1);
-                if (leftSibling.getKeysNum() > minKeys)
-                {
-                    nextPage.setKeyNum(minKeys + 1);
-                    for (int j = minKeys; j > 0; --j)
-                        currentPage.copyKey(nextPage.getKey(j), nextPage.getKey(j - 1));
+                routerPage->copyKey(routerPage->getKey(routerNum), currentPage.getKey(i - 1));
 
-                    if (!isLeaf)
-                    {
-                        for (int j = minKeys + 1; j > 0; --j)
-                            currentPage.copyCursors(nextPage.getCursorPtr(j), nextPage.getCursorPtr(j - 1), 1);
-                    }
+                for(std::vector<PageWrapper*>::const_iterator iter = routedPages.begin(); iter != routedPages.end(); ++iter)
+                {
+                    (*iter)->copyKey((*iter)->getHighKey(), currentPage.getKey(i - 1));
+                    (*iter)->writePage();
+                }
 
-                    currentPage.copyKey(nextPage.getKey(0), leftSibling.getKey(leftSibling.getKeysNum() - 1));
-                    if (!isLeaf)
-                        currentPage.copyCursors(nextPage.getCursorPtr(0),
-                                leftSibling.getCursorPtr(leftSibling.getKeysNum()), 1);
+                routerPage->writePage();
+            }
 
-                    leftSibling.setKeyNum(leftSibling.getKeysNum() - 1);
+            return true;
+        }
 
-                    leftSibling.writePage();
-                    nextPage.writePage();
+        PageWrapper& child = path.take();
+        child.readPageFromChild(currentPage, i);
 
-                    return remove(k, nextPage);
-                }
+        bool isLeaf = child.isLeaf();
+        UShort minKeys = getMinNodeKeys(isLeaf);
+        if(child.getKeysNum() > minKeys)
+        {
+            if(i < keysNum)
+            {
+                routerPage = &currentPage;
+                routerNum = i;
+                routedPages.clear();
             }
 
-            if (i < keysNum)
+            if(_bLink)
+                routedPages.push_back(&child);
+
+            current = &child;
+            continue;
+        }
+
+        // The child is refilled from its sibling or merged with it, then the page is searched again,
+        // since its routers are changed.
+        PageWrapper& leftSibling = path.take();
+        PageWrapper& rightSibling = path.take();
+
+        if(i > 0)
+        {
+            leftSibling.readPageFromChild(currentPage, i - 1);
+            if(leftSibling.getKeysNum() > minKeys)
             {
-                rightSibling.readPageFromChild(currentPage, i + 1);
-                if (rightSibling.getKeysNum() > minKeys)
-                {
-                    nextPage.setKeyNum(minKeys + 1);
-
-                    currentPage.copyKey(nextPage.getKey(minKeys), rightSibling.getKey(0));
-                    currentPage.copyKey(currentPage.getKey(i), rightSibling.getKey(0));
-                    if (!isLeaf)
-                        currentPage.copyCursors(nextPage.getCursorPtr(minKeys + 1), rightSibling.getCursorPtr(0), 1);
-                    int rightSiblingKeysNum = rightSibling.getKeysNum();
-                    for (int j = 0; j < rightSiblingKeysNum - 1; ++j)
-                        currentPage.copyKey(rightSibling.getKey(j), rightSibling.getKey(j + 1));
-                    if (!isLeaf)
-                    {
-                        for (int j = 0; j < rightSiblingKeysNum; ++j)
-                            currentPage.copyCursors(rightSibling.getCursorPtr(j), rightSibling.getCursorPtr(j + 1), 1);
-                    }
-                    rightSibling.setKeyNum(rightSiblingKeysNum - 1);
-
-                    nextPage.writePage();
-                    rightSibling.writePage();
-
-                    return remove(k, nextPage);
-                }
+                if(isLeaf)
+                    moveOneLeafKeyFromLeft(leftSibling, child, currentPage, i);
+                else
+                    moveOneKeyFromLeft(leftSibling, child, currentPage, i);
+
+                continue;
             }
+        }
 
-            if (i > 0)
+        if(i < keysNum)
+        {
+            rightSibling.readPageFromChild(currentPage, i + 1);
+            if(rightSibling.getKeysNum() > minKeys)
             {
-                if (leftSibling.getKeysNum() == minKeys)
-                {
-                    if (isLeaf)
-                        mergeChildren(leftSibling, nextPage, currentPage, i - 1);
-                    else
-                        BaseBTree::mergeChildren(leftSibling, nextPage, currentPage, i - 1);
+                if(isLeaf)
+                    moveOneLeafKeyFromRight(rightSibling, child, currentPage, i);
+                else
+                    moveOneKeyFromRight(rightSibling, child, currentPage, i);
 
-                    return remove(k, leftSibling);
-                }
+                continue;
             }
+        }
 
-            if (isLeaf)
-                mergeChildren(nextPage, rightSibling, currentPage, i);
+        if(i > 0)
+        {
+            if(isLeaf)
+                mergeChildren(leftSibling, child, currentPage, i - 1);
             else
-                BaseBTree::mergeChildren(nextPage, rightSibling, currentPage, i);
+                BaseBTree::mergeChildren(leftSibling, child, currentPage, i - 1);
+        }
+        else
+        {
+            if(isLeaf)
+                mergeChildren(child, rightSibling, currentPage, i);
+            else
+                BaseBTree::mergeChildren(child, rightSibling, currentPage, i);
         }
-
-        return nextPage.isRoot() ? remove(k, _rootPage) : remove(k, nextPage);
     }
 }
 
@@ -1365,6 +2646,8 @@ void BaseBPlusTree::mergeChildren(BaseBTree::PageWrapper& leftChild, BaseBTree::
     leftChild.setKeyNum(getMaxLeafKeys());
 
     leftChild.copyKeys(leftChild.getKey(getMinLeafKeys()), rightChild.getKey(0), getMinLeafKeys());
+    leftChild.setNextLeaf(rightChild.getNextLeaf());
+    linkMergedPages(leftChild, rightChild);
 
     for(int i = medianNum; i < keysNum - 1; ++i)
     {
@@ -1423,12 +2706,17 @@ void BaseBPlusTree::setOrder(UShort order, UShort recSize)
     _cursorsOfs = _keysSize + KEYS_OFS;
     _nodePageSize = _cursorsOfs + CURSOR_SZ * (_maxLeafKeys + 1);
 
+    // The B-link tree's pages end with the right link and the high key.
+    _linksOfs = _nodePageSize;
+    if (_bLink)
+        _nodePageSize += CURSOR_SZ + _recSize;
+
     reallocWorkPages();
 }
 
 bool BaseBPlusTree::isFull(const PageWrapper& page) const
 {
-    return (!page.isLeaf() && BaseBTree::isFull(page)) || (page.isLeaf() && page.getKeysNum() == getMaxLeafKeys());
+    return (!page.isLeaf() && BaseBTree::isFull(page)) || (page.isLeaf() && page.getKeysNum() >= getMaxLeafKeys());
 }
 
 //==============================================================================
@@ -1444,25 +2732,28 @@ void BaseBStarTree::insertNonFull(const Byte* k, PageWrapper& currentNode)
     if (!c)
         throw std::runtime_error("Comparator not set. Can't insert");
 
+    // The full children are split or share their keys on the way down, so the ancestors are not touched again.
+    releaseAncestorLatches(currentNode);
+
     UShort keysNum = currentNode.getKeysNum();
 
     int i = keysNum - 1;
 
     if(currentNode.isLeaf())
     {
-        currentNode.setKeyNum(keysNum + 1);
+        UShort pos = upperBound(currentNode, k);
 
-        for( ; i >= 0 && c->compare(k, currentNode.getKey(i), getRecSize()); --i)
+        currentNode.setKeyNum(keysNum + 1);
+        for( ; i >= pos; --i)
             currentNode.copyKey(currentNode.getKey(i + 1), currentNode.getKey(i));
 
-        currentNode.copyKey(currentNode.getKey(i + 1), k);
+        currentNode.copyKey(currentNode.getKey(pos), k);
 
         currentNode.writePage();
     }
     else
     {
-        for( ; i >= 0 && c->compare(k, currentNode.getKey(i), getRecSize()); --i) ;
-        ++i;
+        i = upperBound(currentNode, k);
 
         PageWrapper child(this);
         child.readPageFromChild(currentNode, i);
@@ -1575,9 +2866,22 @@ void BaseBStarTree::splitChildren(PageWrapper& node, UShort iLeft,
 
     UShort iRight = iLeft + 1;
 
-    middle.allocPage(getMiddleSplitProductKeys(), isLeaf);
-
     UShort keysNum = left.getKeysNum() + right.getKeysNum() + 1;
+
+    // The removals can leave the siblings with other keys numbers than the split expects,
+    // then their keys are spread evenly, so that no page is overfilled.
+    UShort leftKeysNum = getLeftSplitProductKeys();
+    UShort middleKeysNum = getMiddleSplitProductKeys();
+    UShort rightKeysNum = getRightSplitProductKeys(isShort);
+    if (leftKeysNum + middleKeysNum + rightKeysNum + 2 != keysNum)
+    {
+        leftKeysNum = (keysNum - 2) / 3;
+        middleKeysNum = (keysNum - 1) / 3;
+        rightKeysNum = keysNum - 2 - leftKeysNum - middleKeysNum;
+    }
+
+    middle.allocPage(middleKeysNum, isLeaf);
+
     Byte* keys = new Byte[keysNum * _recSize];
     Byte* cursors = isLeaf ? nullptr : new Byte[(keysNum + 1) * CURSOR_SZ];
 
@@ -1591,115 +2895,53 @@ void BaseBStarTree::splitChildren(PageWrapper& node, UShort iLeft,
     if (!isLeaf)
         node.copyCursors(&cursors[(left.getKeysNum() + 1) * CURSOR_SZ], right.getCursorPtr(0), right.getKeysNum() + 1);
 
-    left.setKeyNum(getLeftSplitProductKeys());
+    left.setKeyNum(leftKeysNum);
 
-    node.copyKeys(left.getKey(0), &keys[0], getLeftSplitProductKeys());
+    node.copyKeys(left.getKey(0), &keys[0], leftKeysNum);
     if (!isLeaf)
-        node.copyCursors(left.getCursorPtr(0), &cursors[0], getLeftSplitProductKeys() + 1);
+        node.copyCursors(left.getCursorPtr(0), &cursors[0], leftKeysNum + 1);
 
-    node.copyKeys(middle.getKey(0), &keys[(getLeftSplitProductKeys() + 1) * _recSize], getMiddleSplitProductKeys());
+    node.copyKeys(middle.getKey(0), &keys[(leftKeysNum + 1) * _recSize], middleKeysNum);
     if (!isLeaf)
-        node.copyCursors(middle.getCursorPtr(0), &cursors[(getLeftSplitProductKeys() + 1) * CURSOR_SZ],
-                getMiddleSplitProductKeys() + 1);
+        node.copyCursors(middle.getCursorPtr(0), &cursors[(leftKeysNum + 1) * CURSOR_SZ], middleKeysNum + 1);
 
-    right.setKeyNum(getRightSplitProductKeys(isShort));
-    node.copyKeys(right.getKey(0), &keys[(getLeftSplitProductKeys() + getMiddleSplitProductKeys() + 2) * _recSize],
-            getRightSplitProductKeys(isShort));
+    right.setKeyNum(rightKeysNum);
+    node.copyKeys(right.getKey(0), &keys[(leftKeysNum + middleKeysNum + 2) * _recSize], rightKeysNum);
     if (!isLeaf)
-        node.copyCursors(right.getCursorPtr(0),
-                &cursors[(getLeftSplitProductKeys() + getMiddleSplitProductKeys() + 2) * CURSOR_SZ],
-                getRightSplitProductKeys(isShort) + 1);
+        node.copyCursors(right.getCursorPtr(0), &cursors[(leftKeysNum + middleKeysNum + 2) * CURSOR_SZ],
+                rightKeysNum + 1);
 
-    node.copyKey(node.getKey(iLeft), &keys[getLeftSplitProductKeys() * _recSize]);
+    node.copyKey(node.getKey(iLeft), &keys[leftKeysNum * _recSize]);
 
     UShort parentKeysNum = node.getKeysNum() + 1;
     node.setKeyNum(parentKeysNum);
 
-    for (int i = parentKeysNum - 1; i > iLeft; --i)
-        node.copyKey(node.getKey(i), node.getKey(i - 1));
-
-    node.copyKey(node.getKey(iRight), &keys[(getLeftSplitProductKeys() + getMiddleSplitProductKeys() + 1) * _recSize]);
-
-    for (int i = parentKeysNum; i > iRight; --i)
-        node.copyCursors(node.getCursorPtr(i), node.getCursorPtr(i - 1), 1);
-
-    node.setCursor(iRight, middle.getPageNum());
-
-    left.writePage();
-    middle.writePage();
-    right.writePage();
-    node.writePage();
-
-    delete[] keys;
-    if (cursors != nullptr)
-        delete[] cursors;
-}
-
-bool BaseBStarTree::removeByKeyNum(UShort keyNum, PageWrapper& currentPage)
-{
-    UShort keysNum = currentPage.getKeysNum();
-    Byte* k = currentPage.getKey(keyNum);
-
-    if(currentPage.isLeaf())
-    {
-        for(int j = keyNum; j < keysNum - 1; ++j)
-            currentPage.copyKey(currentPage.getKey(j), currentPage.getKey(j + 1));
-
-        currentPage.setKeyNum(keysNum - 1);
-
-        currentPage.writePage();
-
-        return true;
-    }
-
-    const Byte* replace = nullptr;
-
-    PageWrapper leftChild(this), rightChild(this);
-    leftChild.readPageFromChild(currentPage, keyNum);
-    if(leftChild.getKeysNum() >= getMinKeys() + 1)
-        replace = getAndRemoveMaxKey(leftChild);
-
-    if(replace == nullptr)
-    {
-        rightChild.readPageFromChild(currentPage, keyNum + 1);
-        if(rightChild.getKeysNum() >= getMinKeys() + 1)
-            replace = getAndRemoveMinKey(rightChild);
-    }
-
-    if(replace != nullptr)
-    {
-        currentPage.copyKey(currentPage.getKey(keyNum), replace);
-        delete[] replace;
+    for (int i = parentKeysNum - 1; i > iLeft; --i)
+        node.copyKey(node.getKey(i), node.getKey(i - 1));
 
-        currentPage.writePage();
+    node.copyKey(node.getKey(iRight), &keys[(leftKeysNum + middleKeysNum + 1) * _recSize]);
 
-        return true;
-    }
+    for (int i = parentKeysNum; i > iRight; --i)
+        node.copyCursors(node.getCursorPtr(i), node.getCursorPtr(i - 1), 1);
 
-    if (currentPage.isRoot())
-    {
-        mergeChildren(leftChild, rightChild, currentPage, keyNum);
+    node.setCursor(iRight, middle.getPageNum());
 
-        if (leftChild.isRoot())
-            return removeByKeyNum(getMaxKeys() / 2, _rootPage);
-        else
-            return removeByKeyNum(getMaxKeys() / 2, leftChild);
-    }
+    left.writePage();
+    middle.writePage();
+    right.writePage();
+    node.writePage();
 
-    if (keyNum >= 1)
-    {
-        PageWrapper leftLeftNeighbour(this);
-        leftLeftNeighbour.readPageFromChild(currentPage, keyNum - 1);
-        prepareSubtree(keyNum, currentPage, leftChild, leftLeftNeighbour, rightChild);
-    }
-    else
-    {
-        PageWrapper rightRightNeighbour(this);
-        rightRightNeighbour.readPageFromChild(currentPage, keyNum + 2);
-        prepareSubtree(keyNum, currentPage, leftChild, rightChild, rightRightNeighbour);
-    }
+    delete[] keys;
+    if (cursors != nullptr)
+        delete[] cursors;
+}
+
+bool BaseBStarTree::removeByKeyNum(UShort keyNum, PageWrapper& currentPage)
+{
+    // The key is copied, since the page's keys are moved when its children are refilled.
+    std::vector<Byte> k(currentPage.getKey(keyNum), currentPage.getKey(keyNum) + _recSize);
 
-    return remove(k, leftChild);
+    return BaseBStarTree::remove(&k[0], currentPage);
 }
 
 bool BaseBStarTree::shareKeysWithLeftChildAndInsert(const Byte* k, PageWrapper& node, UShort iChild,
@@ -1728,6 +2970,10 @@ bool BaseBStarTree::shareKeysWithLeftChildAndInsert(const Byte* k, PageWrapper&
     UShort movedKeys = newLeftSiblingKeysNum - leftSiblingKeysNum;
     UShort childLeftKeys = childKeysNum - movedKeys;
 
+    // The sibling left with more keys than the child after the removals can't take any of them.
+    if (newLeftSiblingKeysNum <= leftSiblingKeysNum)
+        return false;
+
     if (newLeftSiblingKeysNum == getMaxKeys() && movedKeys == 1 && c->compare(k, child.getKey(0), _recSize))
         return false;
 
@@ -1789,6 +3035,9 @@ bool BaseBStarTree::shareKeysWithRightChildAndInsert(const Byte* k, PageWrapper&
     UShort movedKeys = newRightSiblingKeysNum - rightSiblingKeysNum;
     UShort childLeftKeys = childKeysNum - movedKeys;
 
+    if (newRightSiblingKeysNum <= rightSiblingKeysNum)
+        return false;
+
     if (newRightSiblingKeysNum == getMaxKeys() && movedKeys == 1
             && c->compare(child.getKey(childKeysNum - 1), k, _recSize))
         return false;
@@ -1826,34 +3075,86 @@ bool BaseBStarTree::shareKeysWithRightChildAndInsert(const Byte* k, PageWrapper&
 
 #ifdef BTREE_WITH_DELETION
 
-bool BaseBStarTree::remove(const Byte* k, PageWrapper& currentPage)
+bool BaseBStarTree::remove(const Byte* k, PageWrapper& page)
 {
-    int i;
-    UShort keysNum = currentPage.getKeysNum();
+    PathPages path(this);
+    PageWrapper* current = &page;
+    for( ; ; )
+    {
+        PageWrapper& currentPage = *current;
+        releaseAncestorLatches(currentPage);
 
-    for(i = 0; i < keysNum && _comparator->compare(currentPage.getKey(i), k, _recSize); ++i) ;
+        UShort keysNum = currentPage.getKeysNum();
+        int i = lowerBound(currentPage, k);
+        bool isFound = i < keysNum && _comparator->isEqual(k, currentPage.getKey(i), _recSize);
 
-    if(i < keysNum && _comparator->isEqual(k, currentPage.getKey(i), _recSize))
-    {
-        if(currentPage.isRoot())
-            return removeByKeyNum(i, _rootPage);
-        else
-            return removeByKeyNum(i, currentPage);
-    }
+        if(currentPage.isLeaf())
+        {
+            if(!isFound)
+                return false;
 
-    else if(currentPage.isLeaf())
-        return false;
+            for(int j = i; j < keysNum - 1; ++j)
+                currentPage.copyKey(currentPage.getKey(j), currentPage.getKey(j + 1));
+
+            currentPage.setKeyNum(keysNum - 1);
+
+            currentPage.writePage();
 
-    PageWrapper child(this);
-    PageWrapper leftNeighbour(this);
-    PageWrapper rightNeighbour(this);
-    if(prepareSubtree(i, currentPage, child, leftNeighbour, rightNeighbour))
-    {
-        if (remove(k, leftNeighbour))
             return true;
-    }
+        }
+
+        PageWrapper& child = path.take();
+        PageWrapper& leftNeighbour = path.take();
+        PageWrapper& rightNeighbour = path.take();
+
+        if(isFound)
+        {
+            // The removed key is kept in the page and replaced after the descent into the page's subtree.
+            KeptLatchesScope keptLatches(this);
+
+            const Byte* replace = nullptr;
+
+            child.readPageFromChild(currentPage, i);
+            if(child.getKeysNum() >= getMinKeys() + 1)
+                replace = getAndRemoveMaxKey(child);
+            else
+            {
+                rightNeighbour.readPageFromChild(currentPage, i + 1);
+                if(rightNeighbour.getKeysNum() >= getMinKeys() + 1)
+                    replace = getAndRemoveMinKey(rightNeighbour);
+            }
+
+            if(replace != nullptr)
+            {
+                currentPage.copyKey(currentPage.getKey(i), replace);
+                delete[] replace;
+
+                currentPage.writePage();
+
+                return true;
+            }
+        }
+
+        prepareSubtree(i, currentPage, child, leftNeighbour, rightNeighbour);
+
+        // The merged child becomes the root when the root's last key is moved to it.
+        if(child.isRoot() || leftNeighbour.isRoot())
+            continue;
 
-    return remove(k, child);
+        // The keys are moved between the page and its refilled children, and the three children merged
+        // into two keep them in either of them, so the key and the child are searched again.
+        i = lowerBound(currentPage, k);
+        if(i < currentPage.getKeysNum() && _comparator->isEqual(k, currentPage.getKey(i), _recSize))
+            continue;
+
+        UInt childPageNum = currentPage.getCursor(i);
+        if(childPageNum == leftNeighbour.getPageNum())
+            current = &leftNeighbour;
+        else if(childPageNum == rightNeighbour.getPageNum())
+            current = &rightNeighbour;
+        else
+            current = &child;
+    }
 }
 
 bool BaseBStarTree::prepareSubtree(UShort cursorNum, PageWrapper& currentPage,
@@ -1890,7 +3191,9 @@ bool BaseBStarTree::prepareSubtree(UShort cursorNum, PageWrapper& currentPage,
             }
         }
 
-        if (currentPage.isRoot())
+        // Only the root's two children are merged into one, the more children are merged three into two,
+        // since the two non-root children merged would overfill the page.
+        if (currentPage.isRoot() && keysNum == 1)
         {
             if (cursorNum >= 1)
             {
@@ -2029,7 +3332,7 @@ void BaseBStarTree::mergeChildren(PageWrapper& leftChild, PageWrapper& middleChi
     currentPage.copyKeys(&keys[(leftChild.getKeysNum() + middleChild.getKeysNum() + 2) * _recSize],
             rightChild.getKey(0), rightChild.getKeysNum());
     if (!isLeaf)
-        currentPage.copyCursors(&cursors[(leftChild.getKeysNum() + rightChild.getKeysNum() + 2) * CURSOR_SZ],
+        currentPage.copyCursors(&cursors[(leftChild.getKeysNum() + middleChild.getKeysNum() + 2) * CURSOR_SZ],
                 rightChild.getCursorPtr(0), rightChild.getKeysNum() + 1);
 
     UShort rightChildKeysNum = keysNum / 2;
@@ -2106,185 +3409,179 @@ void BaseBStarTree::setOrder(UShort order, UShort recSize)
 
 bool BaseBStarTree::isFull(const PageWrapper& page) const
 {
-    return (!page.isRoot() && BaseBTree::isFull(page)) || (page.isRoot() && page.getKeysNum() == getMaxRootKeys());
+    return (!page.isRoot() && BaseBTree::isFull(page)) || (page.isRoot() && page.getKeysNum() >= getMaxRootKeys());
 }
 
-Byte* BaseBStarPlusTree::search(const Byte* k, PageWrapper& currentPage, UInt currentDepth)
+bool BaseBStarPlusTree::search(const Byte* k, Byte* result, PageWrapper& page, UInt currentDepth)
 {
-    if(currentDepth > _maxSearchDepth)
-        _maxSearchDepth = currentDepth;
-
-    int i;
-    UShort keysNum = currentPage.getKeysNum();
-    for(i = 0; i < keysNum && _comparator->compare(currentPage.getKey(i), k, _recSize); ++i) ;
-
-    if(currentPage.isLeaf())
-        return BaseBTree::search(k, currentPage, currentDepth);
-    else
+    PathPages path(this);
+    UInt& maxSearchDepth = getThreadContext().maxSearchDepth;
+    PageWrapper* current = &page;
+    for( ; ; ++currentDepth)
     {
-        PageWrapper nextPage(this);
-        nextPage.readPageFromChild(currentPage, i);
-        return search(k, nextPage, currentDepth + 1);
-    }
-}
-
-int BaseBStarPlusTree::searchAll(const Byte* k, std::list<Byte*>& keys, PageWrapper& currentPage, UInt currentDepth)
-{
-    if(currentDepth > _maxSearchDepth)
-        _maxSearchDepth = currentDepth;
-
-    int amount = 0;
-    int i;
-    UShort keysNum = currentPage.getKeysNum();
-    bool isLeaf = currentPage.isLeaf();
+        PageWrapper& currentPage = *current;
+        releaseAncestorLatches(currentPage);
 
-    for(i = 0; i < keysNum && _comparator->compare(currentPage.getKey(i), k, _recSize); ++i) ;
+        if(currentPage.isLeaf())
+            return BaseBTree::search(k, result, currentPage, currentDepth);
 
-    int first = i;
-
-    PageWrapper nextPage(this);
-    for( ; i < keysNum && (i == first || _comparator->isEqual(k, currentPage.getKey(i), _recSize)); ++i)
-    {
-        if(isLeaf && _comparator->isEqual(k, currentPage.getKey(i), _recSize))
-        {
-            Byte* result = new Byte[_recSize];
-            currentPage.copyKey(result, currentPage.getKey(i));
-            keys.push_back(result);
-            ++amount;
-        }
+        if(currentDepth > maxSearchDepth)
+            maxSearchDepth = currentDepth;
 
-        if(!isLeaf)
-        {
-            nextPage.readPageFromChild(currentPage, i);
-            amount += searchAll(k, keys, nextPage, currentDepth + 1);
-        }
+        PageWrapper& nextPage = path.take();
+        nextPage.viewPageFromChild(currentPage, lowerBound(currentPage, k));
+        current = &nextPage;
     }
+}
 
-    if(!isLeaf)
-    {
-        nextPage.readPageFromChild(currentPage, i);
-        amount += searchAll(k, keys, nextPage, currentDepth + 1);
-    }
+int BaseBStarPlusTree::searchAll(const Byte* k, IKeyVisitor& visitor, PageWrapper& currentPage, UInt currentDepth)
+{
+    return searchRangeInLeaves(k, k, visitor, currentPage, currentDepth);
+}
 
-    return amount;
+int BaseBStarPlusTree::searchRange(const Byte* lo, const Byte* hi, IKeyVisitor& visitor,
+        PageWrapper& currentPage, UInt currentDepth)
+{
+    return searchRangeInLeaves(lo, hi, visitor, currentPage, currentDepth);
 }
 
 #ifdef BTREE_WITH_DELETION
 
-bool BaseBStarPlusTree::remove(const Byte* k, PageWrapper& currentPage)
+bool BaseBStarPlusTree::remove(const Byte* k, PageWrapper& page)
 {
-    int i;
-    UShort keysNum = currentPage.getKeysNum();
-    for(i = 0; i < keysNum && _comparator->compare(currentPage.getKey(i), k, _recSize); ++i) ;
+    PathPages path(this);
+    PageWrapper* current = &page;
 
-    if(currentPage.isLeaf())
-    {
-        if(i < keysNum && _comparator->isEqual(k, currentPage.getKey(i), _recSize))
-            removeByKeyNum(i, currentPage);
-        else
-            return false;
-    }
-    else
+    // The router of the lowest ancestor whose subtree's last leaf is descended into, see BaseBPlusTree.
+    PageWrapper* routerPage = nullptr;
+    UShort routerNum = 0;
+    for( ; ; )
     {
-        PageWrapper nextPage(this);
-        nextPage.readPageFromChild(currentPage, i);
-        if (!nextPage.isRoot() && nextPage.getKeysNum() == getMinKeys())
+        PageWrapper& currentPage = *current;
+
+        // The ancestor whose router is the removed key keeps its latch.
+        if(routerPage == nullptr || !_comparator->isEqual(k, routerPage->getKey(routerNum), _recSize))
+            releaseAncestorLatches(currentPage);
+
+        UShort keysNum = currentPage.getKeysNum();
+        int i = lowerBound(currentPage, k);
+
+        if(currentPage.isLeaf())
         {
-            bool isLeaf = nextPage.isLeaf();
+            if(i >= keysNum || !_comparator->isEqual(k, currentPage.getKey(i), _recSize))
+                return false;
 
-            PageWrapper leftSibling(this);
-            PageWrapper rightSibling(this);
+            removeByKeyNum(i, currentPage);
 
-            if (i > 0)
+            if(routerPage != nullptr && i == keysNum - 1 && i > 0
+                    && _comparator->isEqual(k, routerPage->getKey(routerNum), _recSize))
             {
-                leftSibling.readPageFromChild(currentPage, i - 1);
-                if (leftSibling.getKeysNum() > getMinKeys())
-                {
-                    nextPage.setKeyNum(getMinKeys() + 1);
-                    for (int j = getMinKeys(); j > 0; --j)
-                        currentPage.copyKey(nextPage.getKey(j), nextPage.getKey(j - 1));
-
-                    if (!isLeaf)
-                    {
-                        for (int j = getMinKeys() + 1; j > 0; --j)
-                            currentPage.copyCursors(nextPage.getCursorPtr(j), nextPage.getCursorPtr(j - 1), 1);
-                    }
-
-                    currentPage.copyKey(nextPage.getKey(0), leftSibling.getKey(leftSibling.getKeysNum() - 1));
-                    if (!isLeaf)
-                        currentPage.copyCursors(nextPage.getCursorPtr(0),
-                                leftSibling.getCursorPtr(leftSibling.getKeysNum()), 1);
-                    leftSibling.setKeyNum(leftSibling.getKeysNum() - 1);
-
-                    leftSibling.writePage();
-                    nextPage.writePage();
-
-                    return remove(k, nextPage);
-                }
+                routerPage->copyKey(routerPage->getKey(routerNum), currentPage.getKey(i - 1));
+                routerPage->writePage();
             }
 
-            if (i < keysNum)
+            return true;
+        }
+
+        PageWrapper& child = path.take();
+        child.readPageFromChild(currentPage, i);
+
+        bool isLeaf = child.isLeaf();
+        if(child.getKeysNum() > getMinKeys())
+        {
+            if(i < keysNum)
             {
-                rightSibling.readPageFromChild(currentPage, i + 1);
-                if (rightSibling.getKeysNum() > getMinKeys())
-                {
-                    nextPage.setKeyNum(getMinKeys() + 1);
-
-                    currentPage.copyKey(nextPage.getKey(getMinKeys()), rightSibling.getKey(0));
-                    currentPage.copyKey(currentPage.getKey(i), rightSibling.getKey(0));
-                    if (!isLeaf)
-                        currentPage.copyCursors(nextPage.getCursorPtr(getMinKeys() + 1),
-                                rightSibling.getCursorPtr(0), 1);
-                    int rightSiblingKeysNum = rightSibling.getKeysNum();
-                    for (int j = 0; j < rightSiblingKeysNum - 1; ++j)
-                        currentPage.copyKey(rightSibling.getKey(j), rightSibling.getKey(j + 1));
-                    if (!isLeaf)
-                    {
-                        for (int j = 0; j < rightSiblingKeysNum; ++j)
-                            currentPage.copyCursors(rightSibling.getCursorPtr(j), rightSibling.getCursorPtr(j + 1), 1);
-                    }
-                    rightSibling.setKeyNum(rightSiblingKeysNum - 1);
-
-                    nextPage.writePage();
-                    rightSibling.writePage();
-
-                    return remove(k, nextPage);
-                }
+                routerPage = &currentPage;
+                routerNum = i;
             }
 
-            if (i > 0 && i < keysNum)
+            current = &child;
+            continue;
+        }
+
+        // The child is refilled from its sibling or merged with the siblings, then the page is searched again,
+        // since its routers are changed.
+        PageWrapper& leftSibling = path.take();
+        PageWrapper& rightSibling = path.take();
+
+        if(i > 0)
+        {
+            leftSibling.readPageFromChild(currentPage, i - 1);
+            if(leftSibling.getKeysNum() > getMinKeys())
             {
-                if (isLeaf)
-                    mergeChildren(leftSibling, nextPage, rightSibling, currentPage, i - 1, i);
+                if(isLeaf)
+                    moveOneLeafKeyFromLeft(leftSibling, child, currentPage, i);
                 else
-                    BaseBStarTree::mergeChildren(leftSibling, nextPage, rightSibling, currentPage, i - 1, i);
-
-                if (remove(k, leftSibling))
-                    return true;
+                    moveOneKeyFromLeft(leftSibling, child, currentPage, i);
 
-                return remove(k, nextPage);
+                continue;
             }
+        }
 
-            if (i > 0)
+        if(i < keysNum)
+        {
+            rightSibling.readPageFromChild(currentPage, i + 1);
+            if(rightSibling.getKeysNum() > getMinKeys())
             {
-                if (leftSibling.getKeysNum() == getMinKeys())
-                {
-                    if (isLeaf)
-                        mergeChildren(leftSibling, nextPage, currentPage, i - 1);
-                    else
-                        BaseBStarTree::mergeChildren(leftSibling, nextPage, currentPage, i - 1);
+                if(isLeaf)
+                    moveOneLeafKeyFromRight(rightSibling, child, currentPage, i);
+                else
+                    moveOneKeyFromRight(rightSibling, child, currentPage, i);
 
-                    return remove(k, leftSibling);
-                }
+                continue;
             }
+        }
+
+        // Only the root's two children are merged into one, the more children are merged three into two,
+        // since the two non-root children merged would overfill the page.
+        if(currentPage.isRoot() && keysNum == 1)
+        {
+            PageWrapper& leftChild = i > 0 ? leftSibling : child;
+            PageWrapper& rightChild = i > 0 ? child : rightSibling;
+            if(isLeaf)
+                mergeChildren(leftChild, rightChild, currentPage, 0);
+            else
+                BaseBStarTree::mergeChildren(leftChild, rightChild, currentPage, 0);
+
+            continue;
+        }
 
-            if (isLeaf)
-                mergeChildren(nextPage, rightSibling, currentPage, i);
+        if(i > 0 && i < keysNum)
+        {
+            if(isLeaf)
+                mergeChildren(leftSibling, child, rightSibling, currentPage, i - 1, i);
+            else
+                BaseBStarTree::mergeChildren(leftSibling, child, rightSibling, currentPage, i - 1, i);
+
+            continue;
+        }
+
+        // The child is the first or the last one, so the next sibling after its minimal sibling refills
+        // that sibling, which refills the child then, or the three are merged.
+        PageWrapper& farSibling = path.take();
+        UShort leftNum = i > 0 ? i - 2 : i;
+        farSibling.readPageFromChild(currentPage, i > 0 ? i - 2 : i + 2);
+        if(farSibling.getKeysNum() > getMinKeys())
+        {
+            if(i > 0 && isLeaf)
+                moveOneLeafKeyFromLeft(farSibling, leftSibling, currentPage, i - 1);
+            else if(i > 0)
+                moveOneKeyFromLeft(farSibling, leftSibling, currentPage, i - 1);
+            else if(isLeaf)
+                moveOneLeafKeyFromRight(farSibling, rightSibling, currentPage, i + 1);
             else
-                BaseBStarTree::mergeChildren(nextPage, rightSibling, currentPage, i);
+                moveOneKeyFromRight(farSibling, rightSibling, currentPage, i + 1);
+
+            continue;
         }
 
-        return nextPage.isRoot() ? remove(k, _rootPage) : remove(k, nextPage);
+        PageWrapper& leftChild = i > 0 ? farSibling : child;
+        PageWrapper& middleChild = i > 0 ? leftSibling : rightSibling;
+        PageWrapper& rightChild = i > 0 ? child : farSibling;
+        if(isLeaf)
+            mergeChildren(leftChild, middleChild, rightChild, currentPage, leftNum, leftNum + 1);
+        else
+            BaseBStarTree::mergeChildren(leftChild, middleChild, rightChild, currentPage, leftNum, leftNum + 1);
     }
 }
 
@@ -2301,6 +3598,7 @@ void BaseBStarPlusTree::mergeChildren(PageWrapper& leftChild, PageWrapper& right
     leftChild.setKeyNum(keysNum);
 
     leftChild.copyKeys(leftChild.getKey(oldLeftKeysNum), rightChild.getKey(0), rightChild.getKeysNum());
+    leftChild.setNextLeaf(rightChild.getNextLeaf());
 
     for(int i = medianNum; i < parentKeysNum - 1; ++i)
     {
@@ -2362,6 +3660,7 @@ void BaseBStarPlusTree::mergeChildren(PageWrapper& leftChild, PageWrapper& middl
 
     middleChild.setKeyNum(rightChildKeysNum);
     currentPage.copyKeys(middleChild.getKey(0), &keys[leftChildKeysNum * _recSize], rightChildKeysNum);
+    middleChild.setNextLeaf(rightChild.getNextLeaf());
 
     for (int i = rightMedianNum; i < parentKeysNum - 1; ++i)
     {
@@ -2369,6 +3668,8 @@ void BaseBStarPlusTree::mergeChildren(PageWrapper& leftChild, PageWrapper& middl
         currentPage.copyCursors(currentPage.getCursorPtr(i + 1), currentPage.getCursorPtr(i + 2), 1);
     }
 
+    // The left child's router is its new max key.
+    currentPage.copyKey(currentPage.getKey(leftMedianNum), &keys[(leftChildKeysNum - 1) * _recSize]);
     currentPage.setKeyNum(currentPage.getKeysNum() - 1);
 
     leftChild.writePage();
@@ -2411,20 +3712,34 @@ void BaseBStarPlusTree::splitChildren(PageWrapper& node, UShort iLeft,
 
     UShort iRight = iLeft + 1;
 
-    middle.allocPage(getMiddleLeafSplitProductKeys(), isLeaf);
-
     UShort keysNum = left.getKeysNum() + right.getKeysNum();
+
+    // The leaves' keys are spread evenly if their numbers differ from the expected ones, see BaseBStarTree.
+    UShort leftKeysNum = getLeftSplitProductKeys();
+    UShort middleKeysNum = getMiddleLeafSplitProductKeys();
+    UShort rightKeysNum = getRightSplitProductKeys(isShort);
+    if (leftKeysNum + middleKeysNum + rightKeysNum != keysNum)
+    {
+        leftKeysNum = keysNum / 3;
+        middleKeysNum = (keysNum + 1) / 3;
+        rightKeysNum = keysNum - leftKeysNum - middleKeysNum;
+    }
+
+    middle.allocPage(middleKeysNum, isLeaf);
+
     Byte* keys = new Byte[keysNum * _recSize];
 
     node.copyKeys(&keys[0], left.getKey(0), left.getKeysNum());
     node.copyKeys(&keys[left.getKeysNum() * _recSize], right.getKey(0), right.getKeysNum());
 
-    left.setKeyNum(getLeftSplitProductKeys());
-    node.copyKeys(left.getKey(0), &keys[0], getLeftSplitProductKeys());
-    node.copyKeys(middle.getKey(0), &keys[getLeftSplitProductKeys() * _recSize], getMiddleLeafSplitProductKeys());
-    right.setKeyNum(getRightSplitProductKeys(isShort));
-    node.copyKeys(right.getKey(0), &keys[(getLeftSplitProductKeys() + getMiddleLeafSplitProductKeys()) * _recSize],
-                  getRightSplitProductKeys(isShort));
+    left.setKeyNum(leftKeysNum);
+    node.copyKeys(left.getKey(0), &keys[0], leftKeysNum);
+    node.copyKeys(middle.getKey(0), &keys[leftKeysNum * _recSize], middleKeysNum);
+    right.setKeyNum(rightKeysNum);
+    node.copyKeys(right.getKey(0), &keys[(leftKeysNum + middleKeysNum) * _recSize], rightKeysNum);
+
+    middle.setNextLeaf(right.getPageNum());
+    left.setNextLeaf(middle.getPageNum());
 
     UShort parentKeysNum = node.getKeysNum() + 1;
     node.setKeyNum(parentKeysNum);
@@ -2477,6 +3792,9 @@ bool BaseBStarPlusTree::shareKeysWithLeftChildAndInsert(const Byte* k, PageWrapp
     UShort movedKeys = newLeftSiblingKeysNum - leftSiblingKeysNum;
     UShort childLeftKeys = childKeysNum - movedKeys;
 
+    if (newLeftSiblingKeysNum <= leftSiblingKeysNum)
+        return false;
+
     if (newLeftSiblingKeysNum == getMaxKeys() && movedKeys == 1 && c->compare(k, child.getKey(0), _recSize))
         return false;
 
@@ -2532,6 +3850,9 @@ bool BaseBStarPlusTree::shareKeysWithRightChildAndInsert(const Byte* k, PageWrap
     UShort movedKeys = newRightSiblingKeysNum - rightSiblingKeysNum;
     UShort childLeftKeys = childKeysNum - movedKeys;
 
+    if (newRightSiblingKeysNum <= rightSiblingKeysNum)
+        return false;
+
     if (newRightSiblingKeysNum == getMaxKeys() && movedKeys == 1
         && c->compare(child.getKey(childKeysNum - 2), k, _recSize))
         return false;
@@ -2599,6 +3920,9 @@ void BaseBStarPlusTree::splitChild(PageWrapper& node, UShort iChild, PageWrapper
 
     leftChild.setKeyNum(leftChildKeysNum);
 
+    rightChild.setNextLeaf(leftChild.getNextLeaf());
+    leftChild.setNextLeaf(rightChild.getPageNum());
+
     leftChild.writePage();
     rightChild.writePage();
     node.writePage();
@@ -2638,18 +3962,21 @@ void BaseBStarPlusTree::setRouterKey(PageWrapper& page, UShort keyNum)
 //==============================================================================
 
 FileBaseBTree::FileBaseBTree(BaseBTree::TreeType treeType, UShort order, UShort recSize, BaseBTree::IComparator* comparator,
-    const std::string& fileName)
+    const std::string& fileName, StorageType storageType)
     : FileBaseBTree(treeType)
 {
+    _storageType = storageType;
     _tree->setComparator(comparator);
 
     checkTreeParams(order, recSize);
     createInternal(order, recSize, fileName);
 }
 
-FileBaseBTree::FileBaseBTree(BaseBTree::TreeType treeType, const std::string& fileName, BaseBTree::IComparator* comparator)
+FileBaseBTree::FileBaseBTree(BaseBTree::TreeType treeType, const std::string& fileName, BaseBTree::IComparator* comparator,
+    StorageType storageType)
     : FileBaseBTree(treeType)
 {
+    _storageType = storageType;
     _tree->setComparator(comparator);
     loadInternal(fileName);
 }
@@ -2658,10 +3985,10 @@ FileBaseBTree::FileBaseBTree(BaseBTree::TreeType treeType)
 {
     switch (treeType)
     {
-        case BaseBTree::TreeType::B_TREE: _tree = new BaseBTree(0, 0, nullptr, nullptr); break;
-        case BaseBTree::TreeType::B_PLUS_TREE: _tree = new BaseBPlusTree(0, 0, nullptr, nullptr); break;
-        case BaseBTree::TreeType::B_STAR_TREE: _tree = new BaseBStarTree(0, 0, nullptr, nullptr); break;
-        case BaseBTree::TreeType::B_STAR_PLUS_TREE: _tree = new BaseBStarPlusTree(0, 0, nullptr, nullptr); break;
+        case BaseBTree::TreeType::B_TREE: _tree = new BaseBTree(0, 0, nullptr, (IPageStore*)nullptr); break;
+        case BaseBTree::TreeType::B_PLUS_TREE: _tree = new BaseBPlusTree(0, 0, nullptr, (IPageStore*)nullptr); break;
+        case BaseBTree::TreeType::B_STAR_TREE: _tree = new BaseBStarTree(0, 0, nullptr, (IPageStore*)nullptr); break;
+        case BaseBTree::TreeType::B_STAR_PLUS_TREE: _tree = new BaseBStarPlusTree(0, 0, nullptr, (IPageStore*)nullptr); break;
     }
 
     isComposition = true;
@@ -2688,19 +4015,9 @@ void FileBaseBTree::create(UShort order, UShort recSize,
 void FileBaseBTree::createInternal(UShort order, UShort recSize,
     const std::string& fileName)
 {
-    _fileStream.open(fileName, 
-        std::fstream::in | std::fstream::out |
-        std::fstream::trunc |
-        std::fstream::binary);
-
-    if (_fileStream.fail())
-    {
-        _fileStream.close();
-        throw std::runtime_error("Can't open file for writing");
-    }
+    openStorage(fileName, true);
 
     _fileName = fileName;
-    _tree->setStream(&_fileStream);
 
     _tree->createTree(order, recSize);
 }
@@ -2715,18 +4032,9 @@ void FileBaseBTree::open(const std::string& fileName)
 
 void FileBaseBTree::loadInternal(const std::string& fileName)
 {
-    _fileStream.open(fileName,
-        std::fstream::in | std::fstream::out |
-        std::fstream::binary);
-
-    if (_fileStream.fail())
-    {
-        _fileStream.close();
-        throw std::runtime_error("Can't open file for reading");
-    }
+    openStorage(fileName, false);
 
     _fileName = fileName;
-    _tree->setStream(&_fileStream);
 
 
     try {
@@ -2734,12 +4042,12 @@ void FileBaseBTree::loadInternal(const std::string& fileName)
     }
     catch (std::exception& e)
     {
-        _fileStream.close();
+        closeStorage();
         throw e;
     }
     catch (...)
     {
-        _fileStream.close();
+        closeStorage();
         throw std::runtime_error("Error when loading btree");
     }
 }
@@ -2754,10 +4062,121 @@ void FileBaseBTree::close()
 
 void FileBaseBTree::closeInternal()
 {
-    _fileStream.close();
+    _tree->flushBufferPool();
+    closeStorage();
     _tree->resetBTree();
 }
 
+void FileBaseBTree::openStorage(const std::string& fileName, bool truncate)
+{
+    if (_storageType == MEMORY_MAPPED)
+    {
+
+#ifdef BTREE_WITH_MMAP
+
+        _mappedStore.open(fileName, truncate);
+        _tree->setStore(&_mappedStore);
+        return;
+
+#else
+
+        throw std::invalid_argument("Memory-mapped files are not supported on this platform");
+
+#endif
+
+    }
+
+    if (_storageType == POSITIONAL)
+    {
+
+#ifdef BTREE_WITH_POSIX_IO
+
+        _posixStore.open(fileName, truncate);
+        _tree->setStore(&_posixStore);
+        return;
+
+#else
+
+        throw std::invalid_argument("Positional I/O is not supported on this platform");
+
+#endif
+
+    }
+
+    if (_storageType == WRITE_AHEAD_LOG)
+    {
+
+#ifdef BTREE_WITH_POSIX_IO
+
+        _walStore.open(fileName, truncate);
+        _tree->setStore(&_walStore);
+        return;
+
+#else
+
+        throw std::invalid_argument("Write-ahead log is not supported on this platform");
+
+#endif
+
+    }
+
+    std::ios_base::openmode mode = std::fstream::in | std::fstream::out | std::fstream::binary;
+    if (truncate)
+        mode |= std::fstream::trunc;
+
+    _fileStream.open(fileName, mode);
+
+    if (_fileStream.fail())
+    {
+        _fileStream.close();
+        throw std::runtime_error(truncate ? "Can't open file for writing" : "Can't open file for reading");
+    }
+
+    _streamStore.setStream(&_fileStream);
+    _tree->setStore(&_streamStore);
+}
+
+void FileBaseBTree::closeStorage()
+{
+
+#ifdef BTREE_WITH_MMAP
+
+    if (_mappedStore.isOpen())
+    {
+        _mappedStore.close();
+        return;
+    }
+
+#endif
+
+#ifdef BTREE_WITH_POSIX_IO
+
+    if (_posixStore.isOpen())
+    {
+        _posixStore.close();
+        return;
+    }
+
+    if (_walStore.isOpen())
+    {
+        _walStore.close();
+        return;
+    }
+
+#endif
+
+    _fileStream.close();
+    _streamStore.setStream(nullptr);
+}
+
+void FileBaseBTree::setStorageType(StorageType storageType)
+{
+    if (isOpen())
+        throw std::runtime_error("Tree file is already open");
+
+    _storageType = storageType;
+}
+
 void FileBaseBTree::checkTreeParams(UShort order, UShort recSize)
 {
     if (order < 1 || recSize == 0)
@@ -2767,6 +4186,21 @@ void FileBaseBTree::checkTreeParams(UShort order, UShort recSize)
 
 bool FileBaseBTree::isOpen() const
 {
+
+#ifdef BTREE_WITH_MMAP
+
+    if (_mappedStore.isOpen())
+        return true;
+
+#endif
+
+#ifdef BTREE_WITH_POSIX_IO
+
+    if (_posixStore.isOpen() || _walStore.isOpen())
+        return true;
+
+#endif
+
     return (_fileStream.is_open());
 }
 
@@ -19,9 +19,19 @@
 
 #include <string>
 #include <fstream>
+#include <deque>
 #include <list>
+#include <map>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
 
 #include "utils.h"
+#include "bufferpool.h"
+#include "latch.h"
+#include "pagestore.h"
+#include "walpagestore.h"
 
 namespace btree {
 
@@ -38,6 +48,15 @@ namespace btree {
  *  to inherit this class and to implement casting to the right type in the inherited class
  *
  *  All pages are numbered from 1, 0 is nonexistent page (nullptr).
+ *
+ *  The searches hold the tree's latch shared, and the modifications (insert(), remove(), removeAll()) hold it
+ *  exclusively, so any number of threads can search the tree while one thread at a time modifies it.
+ *  With the latch coupling (see setLatchCoupling()) the modifications hold the tree's latch shared as well
+ *  and latch the pages they pass instead.
+ *  The B-link B+-tree (see setBLink()) is searched without the page latches, and the optimistic searches
+ *  (see setOptimisticSearch()) check the versions of the pages instead of latching them.
+ *  The search statistics and the path pages are kept per thread. The creation, the opening and the closing
+ *  of the tree, its settings, TreeCursor and BulkLoader are not synchronized and need the exclusive use.
  */
 class BaseBTree {
 public:
@@ -55,6 +74,15 @@ public:
 
         /** \brief The valid signature. */
         static const UInt VALID_SIGN = 0x19979AAA;
+
+        /** \brief The valid signature of the B-link tree, whose pages keep the right links and the high keys. */
+        static const UInt BLINK_SIGN = 0x19979AAB;
+
+        /** \brief The valid signature of the tree whose leaves are chained, see PageWrapper::getNextLeaf().
+         *
+         *  The B+- and B*+-trees of the files signed VALID_SIGN have no links in their leaves.
+         */
+        static const UInt CHAINED_SIGN = 0x19979AAC;
     public:
         Header() : order(0), recSize(0), sign(0) {}
         Header(UShort ord, UShort rs) : 
@@ -95,22 +123,6 @@ public:
     /** \brief The first real page offset. */
     static const UInt FIRST_PAGE_OFS = ROOT_PAGE_NUM_OFS + ROOT_PAGE_NUM_SZ;//PAGE_COUNTER_OFS + PAGE_COUNTER_SZ;
 
-#ifdef BTREE_WITH_REUSING_FREE_PAGES
-
-    /** \brief The offset of the free pages counter from the begin of the free pages numbers area. */
-    static const UInt FREE_PAGES_COUNTER_OFS = 0;
-
-    /** \brief The size of the free pages counter. */
-    static const UInt FREE_PAGES_COUNTER_SZ = 4;
-
-    /** \brief The offset of the first free page number from the begin of the free pages numbers area. */
-    static const UInt FIRST_FREE_PAGE_NUM_OFS = FREE_PAGES_COUNTER_OFS + FREE_PAGES_COUNTER_SZ;
-
-    /** \brief The size of the free page number. */
-    static const UInt FREE_PAGE_NUM_SZ = CURSOR_SZ;
-
-#endif
-
     /** \brief The node (page) information record offset. */
     static const UInt NODE_INFO_OFS = 0;
 
@@ -126,6 +138,12 @@ public:
     /** \brief The mask for flag which defines whether node (page) is leaf or not. */
     static const UShort LEAF_NODE_MASK = 0x8000;
 
+    /** \brief The keys range length below which the search inside the node is linear rather than binary. */
+    static const UShort LINEAR_SEARCH_THRESHOLD = 8;
+
+    /** \brief The max count of the released page buffers kept by the tree for the next page wrappers. */
+    static const UInt MAX_FREE_PAGE_BUFFERS = 64;
+
     /** \brief The wrapper above the raw bytes array.
      *
      *  Provides usable interface for access to the values of the page / key.
@@ -138,12 +156,22 @@ public:
 
         virtual ~PageWrapper();
 
-        /** \brief Reallocates memory for page. */
+        /** \brief Reallocates memory for page.
+         *
+         *  The page-sized buffers are borrowed from the tree's free buffers and returned to them.
+         */
         void reallocData(UInt sz);
 
         /** \brief Clears bytes array. */
         void clear();
 
+        /** \brief Detaches the wrapper from its page keeping the wrapper's buffer for the next page. */
+        void reset()
+        {
+            _data = _buffer;
+            _pageNum = 0;
+        }
+
         /** \brief Sets two fields: keys in the page number \c keyNum and feature defines whether page is
          *  the leaf or not \c isLeaf.
          *  Checks keys number for the correctness. Throws an exception if the keys number is incorrect.
@@ -218,6 +246,35 @@ public:
          */
         void setCursor(UShort cnum, UInt cval);
 
+        /** \brief Returns the number of the next leaf in the keys order or 0 if the page is the last leaf.
+         *
+         *  The leaves of the B+- and B*+-trees are chained, the link is stored in place of the leaf's
+         *  first cursor, which is not used by the leaves.
+         */
+        UInt getNextLeaf() const;
+
+        /** \brief Sets the number \c pnum of the next leaf in the keys order. */
+        void setNextLeaf(UInt pnum);
+
+        /** \brief Returns the number of the B-link tree's page to the right on the same level
+         *  or 0 if the page is the level's last one.
+         *
+         *  The leaves' right links are their next leaves, the inner pages' ones are stored after the cursors.
+         */
+        UInt getRightLink() const;
+
+        /** \brief Sets the number \c pnum of the B-link tree's page to the right on the same level. */
+        void setRightLink(UInt pnum);
+
+        /** \brief Returns the B-link tree's page's high key, which is not less than any key of the page's
+         *  subtree and less than the keys of the right page's subtree.
+         *
+         *  The high key is stored after the right link and is undefined if there is no right link.
+         */
+        Byte* getHighKey();
+
+        const Byte* getHighKey() const;
+
         /** \brief Returns the offset (in the cursors area) of the cursor with number \c cnum.
          *
          *  If there is not such a cursor, returns -1.
@@ -269,10 +326,26 @@ public:
          */
         void readPage(UInt pnum)
         {
+            _data = _buffer;
             _tree->readPage(pnum, _data);
             _pageNum = pnum;
         }
 
+        /** \brief Associates the wrapper with the page with number \c pnum for reading only.
+         *
+         *  If the tree's page store provides the pages' views (and the buffer pool is disabled),
+         *  the wrapper points straight at the stored page without copying, so the page should not be
+         *  modified through the wrapper and the view is valid until the next page allocation.
+         *  Otherwise it is the same as readPage().
+         */
+        void viewPage(UInt pnum);
+
+        /** \brief Views the child page with number \c chNum of the page \c pw similar to viewPage().
+         *
+         *  If the cursor number is incorrects, throws an exception.
+         */
+        void viewPageFromChild(PageWrapper& pw, UShort chNum);
+
         /** \brief Loads the child page with number \c chNum of the page \c pw to the current wrapper.
          *
          *  If the cursor number is incorrects, throws an exception.
@@ -322,9 +395,15 @@ public:
 
     protected:
 
-        /** \brief The raw data array. */
+        /** \brief The raw data array: the wrapper's own buffer or the viewed mapped page. */
         Byte* _data;
 
+        /** \brief The wrapper's own buffer. */
+        Byte* _buffer;
+
+        /** \brief The size of the wrapper's own buffer. */
+        UInt _bufferSize;
+
         /** \brief The pointer to the tree. */
         BaseBTree* _tree;
 
@@ -335,6 +414,9 @@ public:
 
     friend class PageWrapper;
 
+    /** \brief The cursor descends by the keys search inside the pages. */
+    friend class TreeCursor;
+
     /** \brief Interface defining the two tree's keys comparing operation. */
     class IComparator {
     public:
@@ -382,18 +464,45 @@ public:
 
     }; // class IKeyPrinter
 
+    /** \brief Interface receiving the found keys without copying them. */
+    class IKeyVisitor {
+
+    public:
+
+        /** \brief Receives the found key \c k.
+         *
+         *  \c k points into the page's data and is valid only during the call.
+         */
+        virtual void visit(const Byte* k) = 0;
+
+    protected:
+
+        ~IKeyVisitor() {};
+
+    }; // class IKeyVisitor
+
 public:
 
     /** \brief Constructs new B-tree using received params.
     *
-    *  Constructs new tree and writes it into \c stream. If file exists,
-    *  it will be overwritten. If file cannot be open, throws an exception.
+    *  The tree is stored in the page store \c store, which is not owned by the tree.
+    *  The tree is written into the store by createTree() or read from it by loadTree().
     *  \c order defines tree's order, \c recSize defines
     *  key's size (length) in bytes.
     */
+    BaseBTree(UShort order, UShort recSize, IComparator* comparator, IPageStore* store);
+
+    /** \brief Constructs blank tree, params of this tree will be read from existing tree's store. */
+    BaseBTree(IComparator* comparator, IPageStore* store);
+
+    /** \brief Constructs new B-tree stored in the stream \c stream, which is wrapped into
+     *  the StreamPageStore owned by the tree (see setStream()).
+     */
     BaseBTree(UShort order, UShort recSize, IComparator* comparator, std::iostream* stream);
 
-    /** \brief Constructs blank tree, params of this tree will be read from existing tree's file. */
+    /** \brief Constructs blank tree stored in the stream \c stream,
+     *  params of this tree will be read from existing tree's stream.
+     */
     BaseBTree(IComparator* comparator, std::iostream* stream);
 
     /** \brief Destructor. */
@@ -407,17 +516,17 @@ protected:
 
 public:
 
-    /** \brief Creates the tree and its root page and writes them to the stream. */
+    /** \brief Creates the tree and its root page and writes them to the store. */
     void createTree(UShort order, UShort recSize);
 
-    /** \brief Loads the tree and its root page from the stream. */
+    /** \brief Loads the tree and its root page from the store. */
     void loadTree();
 
     /** \brief Resets the tree's params. */
     void resetBTree();
 
     /** \brief Returns true if tree is opened, otherwise returns false. */
-    bool isOpened() const { return _stream != nullptr && !_stream->fail(); } // = 0;
+    bool isOpened() const { return _store != nullptr && _store->isOpen(); }
 
     /** \brief Reads page with number \c pnum from the file to the memory in \c dst.
      *
@@ -435,7 +544,7 @@ public:
      *
      *
      *  \c keyNum defines the node's keys number, isLeaf defines whether new node should be leaf or not.
-     *  If the stream is not ready, throws an exception.
+     *  If the store is not ready, throws an exception.
      */
     UInt allocPage(PageWrapper& pw, UShort keysNum, bool isLeaf = false);
 
@@ -450,13 +559,21 @@ public:
      */
     Byte* search(const Byte* k);
 
+    /** \brief For the given key \c k finds the first its occurrence in the tree and copies it
+     *  to the \c result of the key size.
+     *
+     *  \returns true if the key is found, otherwise false.
+     */
+    bool search(const Byte* k, Byte* result);
+
     /** \brief Searches the first occurrence of the key k recursively in the given page.
      *  \param k The key for searching.
+     *  \param result The memory for the copy of the found key.
      *  \param currentPage The given page.
      *  \param currentDepth The depth of the given page in the tree.
-     *  \returns The Byte* array with the copy of the key k.
+     *  \returns true if the key is found, otherwise false.
      */
-    virtual Byte* search(const Byte* k, PageWrapper& currentPage, UInt currentDepth);
+    virtual bool search(const Byte* k, Byte* result, PageWrapper& currentPage, UInt currentDepth);
 
     /** \brief For the given key \c k finds all its occurrences in the tree and save them in the \c keys.
      *
@@ -464,15 +581,64 @@ public:
      */
     int searchAll(const Byte* k, std::list<Byte*>& keys);
 
+    /** \brief For the given key \c k finds all its occurrences in the tree and appends them to \c keys
+     *  one after another.
+     *
+     *  The keys are not allocated one by one, the reused vector is not reallocated at all when its capacity is enough.
+     *  \returns The found elements count.
+     */
+    int searchAll(const Byte* k, std::vector<Byte>& keys);
+
+    /** \brief For the given key \c k finds all its occurrences in the tree and passes them to the \c visitor.
+     *
+     *  \returns The found elements count.
+     */
+    int searchAll(const Byte* k, IKeyVisitor& visitor);
+
     /**
-     * \brief Searches all the occurrences of the key k recursively in the given page.
+     * \brief Searches all the occurrences of the key k in the given page's subtree as the range [k, k].
      * \param k The key for searching.
-     * \param keys The list for saving the Byte* arrays with the copies of the key k.
+     * \param visitor The visitor receiving the found keys.
      * \param currentPage The given page.
      * \param currentDepth The depth of the given page in the tree.
      * \returns The amount of all the occurrences of the key k in the given subtree.
      */
-    virtual int searchAll(const Byte* k, std::list<Byte*>& keys, PageWrapper& currentPage, UInt currentDepth);
+    virtual int searchAll(const Byte* k, IKeyVisitor& visitor, PageWrapper& currentPage, UInt currentDepth);
+
+    /** \brief Finds all the keys not less than \c lo and not greater than \c hi and appends their copies
+     *  to \c keys in the keys order.
+     *
+     *  \returns The found keys count.
+     */
+    int searchRange(const Byte* lo, const Byte* hi, std::list<Byte*>& keys);
+
+    /** \brief Finds all the keys of the range [lo, hi] and appends them to \c keys one after another
+     *  in the keys order, similar to searchAll().
+     *
+     *  \returns The found keys count.
+     */
+    int searchRange(const Byte* lo, const Byte* hi, std::vector<Byte>& keys);
+
+    /** \brief Finds all the keys of the range [lo, hi] and passes them to the \c visitor in the keys order.
+     *
+     *  \returns The found keys count.
+     */
+    int searchRange(const Byte* lo, const Byte* hi, IKeyVisitor& visitor);
+
+    /**
+     * \brief Searches all the keys of the range [lo, hi] in the given page's subtree.
+     *
+     * Descends to each child which can contain the range's keys through the path pages,
+     * so the traversal doesn't recurse. The leaf-oriented tree's routers are not visited.
+     * \param lo The range's min key.
+     * \param hi The range's max key.
+     * \param visitor The visitor receiving the found keys.
+     * \param currentPage The given page.
+     * \param currentDepth The depth of the given page in the tree.
+     * \returns The amount of the range's keys in the given subtree.
+     */
+    virtual int searchRange(const Byte* lo, const Byte* hi, IKeyVisitor& visitor,
+            PageWrapper& currentPage, UInt currentDepth);
 
 #ifdef BTREE_WITH_DELETION
 
@@ -520,6 +686,17 @@ public:
     /** \brief Returns the min keys number in the node. Defined by the tree's order: <em>(_order - 1)<\em>. */
     UInt getMinKeys() const { return _minKeys; }
 
+    /** \brief Returns the max keys number in the node of the given kind. */
+    virtual UInt getMaxNodeKeys(bool /*isLeaf*/, bool /*isRoot*/) const { return getMaxKeys(); }
+
+    /** \brief Returns the min keys number in the non-root node of the given kind. */
+    virtual UInt getMinNodeKeys(bool /*isLeaf*/) const { return getMinKeys(); }
+
+    /** \brief Returns true if all the keys are stored in the leaves and the inner nodes keep the copies
+     *  of the leaves' max keys as the routers, otherwise each key is stored once in any node.
+     */
+    virtual bool isLeafOriented() const { return false; }
+
     /** \brief Returns the keys area size defined as the max keys number multiplied by the key size. */
     UInt getKeysSize() const { return _keysSize; }
 
@@ -533,19 +710,45 @@ public:
     UShort getRecSize() const { return _recSize; }
 
     /** \brief Returns the last written page number (the written pages count). */
-    UInt getLastPageNum() const { return _lastPageNum; }
+    UInt getLastPageNum() const { return _store != nullptr ? _store->getLastPageNum() : 0; }
 
     /** \brief Returns the unzero number of the tree's root page or 0 if there are no pages in the tree. */
     UInt getRootPageNum() const { return _rootPageNum;  }
 
-    /** \brief Returns max depth reached during searching process. */
-    UInt getMaxSearchDepth() const { return _maxSearchDepth; }
+    /** \brief Returns max depth reached during the calling thread's last searching process. */
+    UInt getMaxSearchDepth() const { return getThreadContext().maxSearchDepth; }
+
+    /** \brief Returns the disk operations count made by the calling thread. */
+    UInt getDiskOperationsCount() const { return getThreadContext().diskOperationsCount; }
+
+        /** \brief Sets the disk operations count of the calling thread to 0. */
+    void resetDiskOperationsCount() { getThreadContext().diskOperationsCount = 0; }
 
-    /** \brief Returns the disk operations count during the last insert/search/remove operation. */
-    UInt getDiskOperationsCount() const { return _diskOperationsCount; }
+    /** \brief Returns the count of the optimistic searches' restarts made by the calling thread. */
+    UInt getOptimisticRestartsCount() const { return getThreadContext().optimisticRestartsCount; }
 
-        /** \brief Sets the disk operations count during the last insert/search/remove operation to 0. */
-    void resetDiskOperationsCount() { _diskOperationsCount = 0; }
+    /** \brief Returns the count of the page reads served by the buffer pool (0 if the pool is disabled). */
+    UInt getBufferPoolHitsCount() const { return _bufferPool != nullptr ? _bufferPool->getHitsCount() : 0; }
+
+    /** \brief Returns the count of the page reads which missed the buffer pool (0 if the pool is disabled). */
+    UInt getBufferPoolMissesCount() const { return _bufferPool != nullptr ? _bufferPool->getMissesCount() : 0; }
+
+    /** \brief Sets the buffer pool's hits and misses counters to 0. */
+    void resetBufferPoolCounters() { if (_bufferPool != nullptr) _bufferPool->resetCounters(); }
+
+    /** \brief Returns the count of the page wrappers' buffers allocated in the heap. */
+    UInt getPageBuffersAllocsCount() const { return _pageBuffersAllocsCount; }
+
+    /** \brief Returns the count of the page wrappers' buffers reused instead of the allocation. */
+    UInt getPageBuffersReusesCount() const { return _pageBuffersReusesCount; }
+
+    /** \brief Sets the page wrappers' buffers counters to 0. */
+    void resetPageBuffersCounters() { _pageBuffersAllocsCount = 0; _pageBuffersReusesCount = 0; }
+
+    /** \brief Returns the count of the page wrappers kept for the calling thread's descents,
+     *  which depends on the tree's height.
+     */
+    UInt getPathPagesCount() const { return (UInt)getThreadContext().pathPages.size(); }
 
      /** \brief Returns the reference to the current root page. */
     PageWrapper& getRootPage() { return _rootPage; }
@@ -563,7 +766,184 @@ public:
 
     void setKeyPrinter(IKeyPrinter* keyPrinter) { _keyPrinter = keyPrinter; }
 
-    void setStream(std::iostream* s) { _stream  = s; }
+    /** \brief Returns the page store storing the tree. */
+    IPageStore* getStore() const { return _store; }
+
+    /** \brief Sets the page store storing the tree. It is not owned by the tree. */
+    void setStore(IPageStore* s) { _store = s; }
+
+    /** \brief Sets the stream storing the tree: the tree stores its pages in the StreamPageStore
+     *  wrapping the stream, which is owned by the tree.
+     */
+    void setStream(std::iostream* s);
+
+    /** \brief Writes the buffer pool's dirty pages and syncs the page store. */
+    void sync();
+
+    /** \brief Reports the end of the modifying operation to the page store. If the store asks for the commit,
+     *  writes the buffer pool's dirty pages and commits the changes.
+     *
+     *  It is called by insert(), remove() and removeAll(), the other modifications should call it as well.
+     *  The store which drops the failed operations' changes gets the buffer pool's dirty pages at each end.
+     */
+    void endOperation();
+
+    /** \brief Writes the buffer pool's dirty pages and commits the ended operations, so they are durable.
+     *
+     *  It is the barrier for the store committing the groups of operations, see WalPageStore:
+     *  unlike sync(), it doesn't sync the file itself.
+     */
+    void commit();
+
+    /** \brief Enables the buffer pool storing up to \c pages pages between the tree and its store.
+     *
+     *  0 disables the pool. If the tree is opened, the current pool's dirty pages are written back firstly.
+     */
+    void setBufferPoolCapacity(UInt pages);
+
+    /** \brief Enables the buffer pool with the memory budget \c bytes for the pages (at least one page).
+     *
+     *  0 disables the pool. The pages count is recalculated when the tree's page size changes.
+     */
+    void setBufferPoolBudget(ULong bytes);
+
+    /** \brief Returns the max pages count of the buffer pool, 0 if the pool is disabled. */
+    UInt getBufferPoolCapacity() const { return _bufferPool != nullptr ? _bufferPool->getCapacity() : 0; }
+
+    /** \brief Returns the buffer pool or nullptr if the pool is disabled. */
+    BufferPool* getBufferPool() const { return _bufferPool; }
+
+    /** \brief Writes the buffer pool's dirty pages into the store. */
+    void flushBufferPool();
+
+    /** \brief Turns the copy-on-write mode on or off.
+     *
+     *  In the copy-on-write mode insert(), remove() and removeAll() don't rewrite the pages: each modified page
+     *  is written to a free page together with the copies of its ancestors, and the operation is published
+     *  by the root page number at its end. The replaced pages are reused when no snapshot reads them.
+     *  An operation interrupted by an exception leaves the tree as it was.
+     *  \throws std::logic_error if the tree's leaves are chained (the B+- and B*+-trees),
+     *  since each leaf's copy would need the copies of all the preceding leaves,
+     *  or if the mode is turned off while there are snapshots.
+     */
+    void setCopyOnWrite(bool copyOnWrite);
+
+    /** \brief Returns true if the tree is in the copy-on-write mode. */
+    bool isCopyOnWrite() const { return _copyOnWrite; }
+
+    /** \brief Turns the latch coupling on or off.
+     *
+     *  With the latch coupling the operations latch the pages from the root down, shared for the searches
+     *  and exclusively for the modifications, and release the ancestors' latches once the child is safe:
+     *  it is split or refilled in advance, so the rest of the descent doesn't return to the ancestors.
+     *  So the modifications of the disjoint subtrees run in parallel. The modification which can split
+     *  or shrink the root holds the tree's latch exclusively instead. The pages' views are not used,
+     *  and the page store is accessed under a latch.
+     *  \throws std::logic_error if the tree is in the copy-on-write mode.
+     */
+    void setLatchCoupling(bool latchCoupling);
+
+    /** \brief Returns true if the latch coupling is on. */
+    bool isLatchCoupling() const { return _latchCoupling; }
+
+    /** \brief Turns the B-link mode on or off for the tree to be created.
+     *
+     *  In the B-link mode (Lehman and Yao) each page keeps the link to its right sibling and its high key,
+     *  the copy of the router to it in the parent. A split writes the new right page before the pages
+     *  linking it, so with the latch coupling the searches latch no pages: the search reaching a page
+     *  after its concurrent split finds the moved keys by the right links. The removals hold the tree's latch
+     *  exclusively. The mode is stored in the tree's header, so load() restores it.
+     *  \throws std::logic_error if the tree is not the B+-tree (see isBLinkSupported())
+     *  or if the tree is created already.
+     */
+    void setBLink(bool bLink);
+
+    /** \brief Returns true if the tree is in the B-link mode. */
+    bool isBLink() const { return _bLink; }
+
+    /** \brief Turns the optimistic searches on or off, they take effect with the latch coupling.
+     *
+     *  The optimistic search latches no pages: it remembers the versions of the pages it reads and,
+     *  after each page is read, checks that the page and its parent are not modified since, otherwise
+     *  it restarts from the root. The modifications lock the versions of their latched pages before they
+     *  write a page and change the versions when they release the pages. So the searches don't write
+     *  the shared memory of the root's latch and don't wait for each other. The found keys are buffered
+     *  and visited once the search succeeds. After MAX_OPTIMISTIC_RESTARTS restarts the search latches
+     *  the pages shared. The B-link tree's searches don't need the versions.
+     */
+    void setOptimisticSearch(bool optimisticSearch) { _optimisticSearch = optimisticSearch; }
+
+    /** \brief Returns true if the searches are optimistic. */
+    bool isOptimisticSearch() const { return _optimisticSearch; }
+
+    /** \brief Returns true if the tree can be in the B-link mode.
+     *
+     *  The B*- and B*+-trees move the keys to the existing left and right siblings when the pages are
+     *  shared and split 2 to 3, which the searches passing the pages without latches can't follow.
+     */
+    virtual bool isBLinkSupported() const { return false; }
+
+    /** \brief Sets the right links and the high keys of all the B-link tree's pages level by level,
+     *  e.g. after the pages are written by BulkLoader.
+     */
+    void linkSiblings();
+
+    /** \brief Returns the count of the pages whose latches are held or waited for. */
+    UInt getPageLatchesCount() { return _pageLatches.getLatchesCount(); }
+
+    /** \brief Returns the number of the tree's version, which grows with each published operation. */
+    UInt getVersion() const { return _version; }
+
+    /** \brief Returns the count of the replaced pages which can't be reused yet. */
+    UInt getRetiredPagesCount() const { return (UInt)_retiredPages.size(); }
+
+    /** \brief Read-only view of the tree's version published when the snapshot is created.
+     *
+     *  The version's pages are not reused while the snapshot exists, so the following operations of the tree
+     *  don't change what the snapshot reads. It is available in the copy-on-write mode only.
+     */
+    class Snapshot {
+
+    public:
+
+        /** \brief Creates the snapshot of the tree's current version.
+         *
+         *  \throws std::logic_error if the tree is not in the copy-on-write mode.
+         */
+        Snapshot(BaseBTree* tree);
+
+        /** \brief Destructor, lets the tree reuse the pages replaced after the version. */
+        ~Snapshot();
+
+    protected:
+
+        Snapshot(const Snapshot&);
+
+        Snapshot& operator= (Snapshot&);
+
+    public:
+
+        /** \brief Returns the version's root page number. */
+        UInt getRootPageNum() const { return _rootPageNum; }
+
+        /** \brief Returns the version's number. */
+        UInt getVersion() const { return _version; }
+
+        /** \brief Searches the key \c k in the version similar to BaseBTree::search(). */
+        bool search(const Byte* k, Byte* result);
+
+    protected:
+
+        /** \brief The tree. */
+        BaseBTree* _tree;
+
+        /** \brief The version's root page number. */
+        UInt _rootPageNum;
+
+        /** \brief The version's number. */
+        UInt _version;
+
+    }; // class Snapshot
 
 protected:
 
@@ -667,35 +1047,89 @@ protected:
     void moveOneKeyFromRight(PageWrapper& rightNeighbour, PageWrapper& child,
             PageWrapper& currentPage, UShort childCursorNum);
 
+    /**
+     * \brief Moves the last key of the leaf's left neighbour to the start of the leaf
+     * and makes the neighbour's new last key its router.
+     * \param leftNeighbour The leaf's left neighbour.
+     * \param child The leaf.
+     * \param currentPage The leaf's parent.
+     * \param childCursorNum The number of the parent's cursor to the leaf.
+     */
+    void moveOneLeafKeyFromLeft(PageWrapper& leftNeighbour, PageWrapper& child,
+            PageWrapper& currentPage, UShort childCursorNum);
+
+    /**
+     * \brief Moves the first key of the leaf's right neighbour to the end of the leaf
+     * and makes it the leaf's router.
+     * \param rightNeighbour The leaf's right neighbour.
+     * \param child The leaf.
+     * \param currentPage The leaf's parent.
+     * \param childCursorNum The number of the parent's cursor to the leaf.
+     */
+    void moveOneLeafKeyFromRight(PageWrapper& rightNeighbour, PageWrapper& child,
+            PageWrapper& currentPage, UShort childCursorNum);
+
 #endif
 
     virtual bool isFull(const PageWrapper& page) const;
 
+    /** \brief Returns the number of the first key of the page which is not less than \c k
+     *  or the keys number if there is no such a key.
+     *
+     *  The keys are searched by the binary search, which becomes linear for the short ranges.
+     *  Typed trees override it with the comparison known at compile time.
+     */
+    virtual UShort lowerBound(const PageWrapper& page, const Byte* k) const;
+
+    /** \brief Returns the number of the first key of the page which is greater than \c k
+     *  or the keys number if there is no such a key.
+     */
+    virtual UShort upperBound(const PageWrapper& page, const Byte* k) const;
+
+    /** \brief Searches all the keys of the range [lo, hi] in the tree with the chained leaves.
+     *
+     *  Descends from \c currentPage once to the leaf containing the first key not less than \c lo
+     *  and then walks the leaves by their links, so only (height + range's leaves) pages are read.
+     *  If the leaves are not chained, searches them by BaseBTree::searchRange().
+     *  \returns The amount of the range's keys.
+     */
+    int searchRangeInLeaves(const Byte* lo, const Byte* hi, IKeyVisitor& visitor,
+            PageWrapper& currentPage, UInt currentDepth);
+
     /** \brief Loads the tree's root page. */
     void loadRootPage();
 
-    /** \brief Creates and writes the tree's root page and writes it to the stream. */
+    /** \brief Links the B-link tree's right page \c rightChild split off the child \c iChild
+     *  of the page \c node: \c rightChild takes the right link and the high key of \c leftChild,
+     *  which is linked to \c rightChild and bounded by the router \c iChild.
+     *
+     *  The leaves' links are set by the leaves' splitting. Does nothing if the tree is not in the B-link mode.
+     */
+    void linkSplitPages(PageWrapper& node, UShort iChild, PageWrapper& leftChild, PageWrapper& rightChild);
+
+    /** \brief Gives the right link and the high key of the B-link tree's page \c rightChild
+     *  to the page \c leftChild it is merged into.
+     *
+     *  The leaves' links are set by the leaves' merging. Does nothing if the tree is not in the B-link mode.
+     */
+    void linkMergedPages(PageWrapper& leftChild, PageWrapper& rightChild);
+
+    /** \brief Creates and writes the tree's root page and writes it to the store. */
     void createRootPage();
 
-    /** \brief Checks whether the stream is opened (the tree is ready) or not, If not, throws an exception. */
+    /** \brief Checks whether the store is opened (the tree is ready) or not, If not, throws an exception. */
     void checkForOpenStream();
 
-    /** \brief Writes the tree's header into the stream. */
+    /** \brief Writes the tree's header into the store. */
     void writeHeader();
 
-    /** \brief Read the tree's header from the stream. */
+    /** \brief Read the tree's header from the store. */
     void readHeader(Header& hdr);
 
-    /** \brief Writes the written pages count into the stream. */
-    void writePageCounter(); // UInt pc);
-
-    /** \brief Reads the written pages count from the stream. */
-    void readPageCounter();
-
-    /** \brief Writes the tree's root page number into the stream. */
+    /** \brief Writes the tree's root page number into the store. */
     void writeRootPageNum();
 
-    /** \brief Reads the tree's root page number from the stream. */
+    /** \brief Reads the tree's root page number from the store. */
     void readRootPageNum();
 
     /** \brief Sets the root page number.
@@ -710,63 +1144,389 @@ protected:
     /** \brief Reallocates the memory for the working pages. */
     void reallocWorkPages();
 
-    /** \brief The inner part of the readPage(). */
-    void readPageInternal(UInt pnum, Byte* dst);
+    /** \brief Recreates the buffer pool using the current page size and pool's settings. */
+    void resetBufferPool();
 
-    /** \brief The inner part of the writePage(). */
-    void writePageInternal(UInt pnum, const Byte* dst);
+    /** \brief Returns the buffer of \c sz bytes for a page wrapper, reusing the free one if possible. */
+    Byte* acquirePageBuffer(UInt sz);
 
-    /** \brief Goes to the offset in the file matching to the page with number \c pnum. */
-    void gotoPage(UInt pnum);
+    /** \brief Takes back the page wrapper's buffer \c buffer of \c sz bytes for reusing or frees it. */
+    void releasePageBuffer(Byte* buffer, UInt sz);
 
-#ifdef BTREE_WITH_REUSING_FREE_PAGES
+    /** \brief Frees the kept page buffers, which are then reused for the pages of \c sz bytes. */
+    void resetPageBuffers(UInt sz);
 
-    /**
-     * \brief Allocate page using the free pages reusing concept.
-     * \param pw PageWrapper for getting access to the allocated page.
-     * \param keysNum The number of the keys in the allocated page.
-     * \param isRoot Shows whether the allocated page is the root of the tree or not.
-     * \param isLeaf Shows whether the allocated page is the leaf of the tree or not.
-     * \returns The number of the allocated page.
+    /** \brief The kinds of the operations taking the latches. */
+    enum LatchedOperation { SEARCH_OPERATION, OPTIMISTIC_SEARCH_OPERATION, INSERT_OPERATION, REMOVE_OPERATION };
+
+    /** \brief The modes of the page latches, the optimistic latches are the remembered pages' versions. */
+    enum LatchMode { NO_LATCHES, SHARED_LATCHES, EXCLUSIVE_LATCHES, OPTIMISTIC_LATCHES };
+
+    /** \brief The max count of the optimistic search's restarts, then the search latches the pages. */
+    static const UInt MAX_OPTIMISTIC_RESTARTS = 8;
+
+    /** \brief Thrown by the optimistic search's page reading if the read pages could be modified meanwhile,
+     *  the search is restarted then.
      */
-    UInt allocPageUsingFreePages(PageWrapper& pw, UShort keysNum, bool isRoot, bool isLeaf);
+    struct OptimisticRestart { };
+
+    /** \brief The tree's state of one thread. */
+    struct ThreadContext {
+
+        ThreadContext()
+            : maxSearchDepth(0)
+            , diskOperationsCount(0)
+            , optimisticRestartsCount(0)
+            , pathPagesUsed(0)
+            , latchMode(NO_LATCHES)
+            , isTreeLatchExclusive(false)
+            , keptLatchesDepth(0)
+        {
+        }
+
+        /** \brief The max reached tree's depth during the last search. */
+        UInt maxSearchDepth;
+
+        /** \brief The disk operations count. */
+        UInt diskOperationsCount;
+
+        /** \brief The optimistic searches' restarts count. */
+        UInt optimisticRestartsCount;
+
+        /** \brief The page wrappers reused by the descents, see PathPages. */
+        std::vector<PageWrapper*> pathPages;
+
+        /** \brief The count of the path pages taken by the descents in progress. */
+        UInt pathPagesUsed;
+
+        /** \brief The mode of the page latches taken by the operation in progress. */
+        LatchMode latchMode;
+
+        /** \brief True if the operation in progress holds the tree's latch exclusively. */
+        bool isTreeLatchExclusive;
+
+        /** \brief The numbers of the pages latched by the operation in progress. */
+        std::vector<UInt> latchedPages;
+
+        /** \brief The versions of the latched pages read by the optimistic search. */
+        std::vector<ULong> latchedVersions;
 
-    /** \brief Loads the free pages counter from the disk. */
-    void loadFreePagesCounter();
+        /** \brief The numbers of the latched pages whose versions are locked by the modification. */
+        std::vector<UInt> lockedVersionPages;
 
-    /** \brief Writes the free pages counter to the disk. */
-    void writeFreePagesCounter();
+        /** \brief The keys found by the optimistic search, which are visited once it succeeds. */
+        std::vector<Byte> foundKeys;
 
-    /** \brief Gets the last free page number from the disk.
-     *  \returns The last free page number.
+        /** \brief The depth of the nested KeptLatchesScope's. */
+        UInt keptLatchesDepth;
+
+    }; // struct ThreadContext
+
+    /** \brief Returns the calling thread's context, creating it on the first call. */
+    ThreadContext& getThreadContext() const;
+
+    /** \brief Takes the tree's latch for the operation and, with the latch coupling, the root page's latch.
+     *
+     *  If the modification can change the root page's number, the tree's latch is taken exclusively
+     *  and the pages are not latched.
      */
-    UInt getLastFreePageNum();
+    void beginLatching(LatchedOperation operation);
 
-    /**
-     * \brief The internal part of the allocPageUsingFreePages() method.
-     * \param pw PageWrapper for getting access to the allocated page.
-     * \param keysNum The number of the keys in the allocated page.
-     * \param isRoot Shows whether the allocated page is the root of the tree or not.
-     * \param isLeaf Shows whether the allocated page is the leaf of the tree or not.
-     * \param freePageNum The free page number for reusing.
+    /** \brief Releases the latches taken by the operation. */
+    void endLatching();
+
+    /** \brief Releases the page latches of the operation and latches the root page again,
+     *  so the operation can start the next descent.
      */
-    void allocPageUsingFreePagesInternal(PageWrapper& pw, UShort keysNum, bool isRoot, bool isLeaf, UInt freePageNum);
+    void restartLatching(LatchedOperation operation);
 
-    /**
-     * \brief Gets the page offset from the begin of the file.
-     * \param pageNum The page number for getting the offset.
-     * \returns The page offset from the begin of the file.
+    /** \brief Returns true if the modification can't change the root page's number. */
+    bool isRootSafe(LatchedOperation operation);
+
+    /** \brief Latches the page \c pnum in the operation's mode if it is not latched yet. */
+    void latchPage(UInt pnum);
+
+    /** \brief Releases the latch of the page \c pnum if it is held by the operation. */
+    void unlatchPage(UInt pnum);
+
+    /** \brief Latches the child page with number \c chNum of the page \c pw.
+     *
+     *  The leaves are passed from left to right along their chain, so the latched right siblings
+     *  of the child are released and latched again after the child.
      */
-    ULong getPageOfs(UInt pageNum);
+    void latchChildPage(PageWrapper& pw, UShort chNum);
+
+    /** \brief Releases the latch of the page \c pnum taken by the operation. */
+    void releasePageLatch(UInt pnum);
 
-    /** \brief Returns the offset of the free pages numbers area from the begin of the file. */
-    ULong getFreePagesInfoAreaOfs();
+    /** \brief Returns the operation of the search after \c restarts restarts. */
+    LatchedOperation getSearchOperation(UInt restarts) const;
 
-    /** \brief Returns the offset of the last free page number from the begin of the file. */
-    ULong getLastFreePageNumOfs();
+    /** \brief Throws OptimisticRestart if any page remembered by the optimistic search has another version. */
+    void validateLatchedPages();
+
+    /** \brief Locks the versions of the pages latched by the modification, if there are optimistic searches,
+     *  before the modification writes or frees a page.
+     */
+    void lockLatchedVersions();
+
+    /** \brief Unlocks the version of the page \c pnum if it is locked by the modification. */
+    void unlockLatchedVersion(UInt pnum);
+
+    /** \brief Releases the page latches of the operation except the latch of \c page.
+     *
+     *  The descent calls it when the rest of the descent goes through \c page only. Does nothing
+     *  within KeptLatchesScope.
+     */
+    void releaseAncestorLatches(const PageWrapper& page);
+
+    /** \brief The tree's latches held by the operation until the end of the scope. */
+    class OperationLatches {
+
+    public:
+
+        OperationLatches(BaseBTree* tree, LatchedOperation operation) : _tree(tree)
+        {
+            _tree->beginLatching(operation);
+        }
+
+        ~OperationLatches() { _tree->endLatching(); }
+
+    protected:
+
+        OperationLatches(const OperationLatches&);
+
+        OperationLatches& operator= (OperationLatches&);
+
+    protected:
+
+        /** \brief The tree. */
+        BaseBTree* _tree;
+
+    }; // class OperationLatches
+
+    /** \brief The scope in which the operation keeps all its page latches.
+     *
+     *  It is used by the descents which return to the passed pages (or their copies' keys) later.
+     */
+    class KeptLatchesScope {
+
+    public:
+
+        KeptLatchesScope(BaseBTree* tree) : _context(tree->getThreadContext()) { ++_context.keptLatchesDepth; }
+
+        ~KeptLatchesScope() { --_context.keptLatchesDepth; }
+
+    protected:
+
+        KeptLatchesScope(const KeptLatchesScope&);
+
+        KeptLatchesScope& operator= (KeptLatchesScope&);
+
+    protected:
+
+        /** \brief The thread's context. */
+        ThreadContext& _context;
+
+    }; // class KeptLatchesScope
+
+    /** \brief The page wrappers taken from the thread's path pages for the root-to-leaf descent
+     *  and given back to them at the end of the scope.
+     *
+     *  The path pages are constructed once and reused by the following descents,
+     *  their count grows with the tree's height only. The taken pages borrow their buffers
+     *  from the tree's free list and release them at the end of the scope, so the path pages
+     *  and the local page wrappers share the same buffers.
+     */
+    class PathPages {
+
+    public:
+
+        PathPages(BaseBTree* tree)
+            : _tree(tree)
+            , _context(tree->getThreadContext())
+            , _firstPage(_context.pathPagesUsed)
+        {
+        }
+
+        ~PathPages();
+
+    protected:
+
+        PathPages(const PathPages&);
+
+        PathPages& operator= (PathPages&);
+
+    public:
+
+        /** \brief Returns the next free path page detached from any page. */
+        PageWrapper& take();
+
+        /** \brief Returns the path page of the scope's level \c level, which is taken once and reused
+         *  each time the traversal returns to the level. The scope's pages are not taken by take() then.
+         */
+        PageWrapper& at(UInt level);
+
+    protected:
+
+        /** \brief The tree. */
+        BaseBTree* _tree;
+
+        /** \brief The thread's context keeping the path pages. */
+        ThreadContext& _context;
+
+        /** \brief The number of the first path page taken in the scope. */
+        UInt _firstPage;
+
+    }; // class PathPages
+
+    /** \brief The page of the traversal's path and the number of its next key. */
+    struct PathLevel {
+
+        PathLevel(PageWrapper* pg, int num)
+            : page(pg)
+            , keyNum(num)
+            , isChildVisited(false)
+        {
+        }
+
+        /** \brief The page. */
+        PageWrapper* page;
+
+        /** \brief The number of the next key. */
+        int keyNum;
+
+        /** \brief True if the child before the next key is visited. */
+        bool isChildVisited;
+
+    }; // struct PathLevel
+
+    /** \brief Returns the root page from which the search starts.
+     *
+     *  The search which doesn't latch the pages shared while the modifications run reads the root page's copy
+     *  taken from \c path, since the root page's wrapper is modified in place.
+     */
+    PageWrapper& getSearchRootPage(PathPages& path);
+
+    /** \brief Returns true if the key \c k is greater than the high key of the B-link tree's page \c page,
+     *  so the page was split after the search read its parent and the key is to the right.
+     */
+    bool isPastHighKey(const PageWrapper& page, const Byte* k) const;
+
+    /** \brief Returns the B-link tree's page whose subtree can contain the key \c k: \c page
+     *  or the right page found by the right links, which are read into the pages taken from \c path.
+     */
+    PageWrapper& moveRight(PageWrapper& page, const Byte* k, PathPages& path);
+
+    /** \brief Destructs the path pages of all the threads, so they get the buffers of the current page size
+     *  when created again.
+     */
+    void deletePathPages();
+
+    /** \brief The scope of the modifying operation in the page store.
+     *
+     *  If the operation is not ended by end() till the end of the scope, since it has failed,
+     *  its changes are dropped by abortOperation().
+     */
+    class OperationScope {
+
+    public:
+
+        OperationScope(BaseBTree* tree) : _tree(tree), _isActive(true) { }
+
+        ~OperationScope();
+
+    protected:
+
+        OperationScope(const OperationScope&);
+
+        OperationScope& operator= (OperationScope&);
+
+    public:
+
+        /** \brief Ends the operation by endOperation(). */
+        void end();
+
+    protected:
+
+        /** \brief The tree. */
+        BaseBTree* _tree;
+
+        /** \brief True until the operation is ended or dropped. */
+        bool _isActive;
+
+    }; // class OperationScope
+
+    /** \brief Drops the changes of the failed operation if the page store can drop them:
+     *  the buffer pool's pages are dropped, and the root is read again.
+     */
+    void abortOperation();
+
+    /** \brief The scope of the modifying operation in the copy-on-write mode.
+     *
+     *  If the operation is not published by commit() till the end of the scope, its page copies are dropped.
+     *  Does nothing if the tree is not in the copy-on-write mode.
+     */
+    class CopyOnWriteScope {
+
+    public:
+
+        CopyOnWriteScope(BaseBTree* tree);
+
+        ~CopyOnWriteScope();
+
+    protected:
+
+        CopyOnWriteScope(const CopyOnWriteScope&);
+
+        CopyOnWriteScope& operator= (CopyOnWriteScope&);
+
+    public:
+
+        /** \brief Publishes the operation. */
+        void commit();
+
+    protected:
+
+        /** \brief The tree. */
+        BaseBTree* _tree;
+
+        /** \brief True until the operation is published or dropped. */
+        bool _isActive;
+
+    }; // class CopyOnWriteScope
+
+    /** \brief Returns the number of the page which stores the page \c pnum in the current operation. */
+    UInt getShadowPageNum(UInt pnum) const;
+
+    /** \brief Copies the parents of the copied pages up to the root, so they point at the copies,
+     *  and publishes the new root page number.
+     */
+    void commitCopyOnWrite();
+
+    /** \brief Frees the pages allocated by the current operation and restores the root. */
+    void abortCopyOnWrite();
+
+    /** \brief Frees the replaced pages which are not read by the snapshots. */
+    void freeRetiredPages();
+
+#ifdef BTREE_WITH_REUSING_FREE_PAGES
+
+    /** \brief Postpones freeing the page with number \c pageNum in the copy-on-write mode.
+     *
+     *  \returns false if the page can be freed at once.
+     */
+    bool retirePage(UInt pageNum);
 
 #endif
 
+    /** \brief Returns the pointer to the page with number \c pnum in the store's memory.
+     *
+     *  If the page can't be viewed in place (the store can't provide it or the buffer pool is enabled),
+     *  returns nullptr.
+     */
+    Byte* getPageView(UInt pnum);
+
     /** \brief The internal part of the allocPage(). */
     UInt allocPageInternal(PageWrapper& pw, UShort keysNum, bool isRoot, bool isLeaf);
 
@@ -793,20 +1553,14 @@ protected:
     /** \brief The key record size (length). */
     UShort _recSize;
 
-    /** \brief The last written page number (the written pages count). */
-    UInt _lastPageNum;
-
     /** \brief The unzero number of the tree's root page or 0 if there are no pages in the tree. */
     UInt _rootPageNum;
 
-    /** \brief The max reached tree's depth during the last search. */
-    UInt _maxSearchDepth;
-
-    /** \brief The disk operations count during the last insert/search/remove operation. */
-    UInt _diskOperationsCount;
+    /** \brief The page store into / from which the tree is written / read. */
+    IPageStore* _store;
 
-    /** \brief The stream into / from which the tree is written / read. */
-    std::iostream* _stream;
+    /** \brief The page store wrapping the stream set by setStream(). */
+    StreamPageStore _streamStore;
 
     /** \brief The root page wrapper. Always stored in the memory. */
     PageWrapper _rootPage;
@@ -816,15 +1570,99 @@ protected:
 
     IKeyPrinter* _keyPrinter;
 
-#ifdef BTREE_WITH_REUSING_FREE_PAGES
+    /** \brief The buffer pool between the tree and the store, nullptr if the pool is disabled. */
+    BufferPool* _bufferPool;
 
-    /** \brief The free pages counter.
-     *
-     *  Contains the count of the free pages for reusing.
+    /** \brief The buffer pool's capacity in pages set by setBufferPoolCapacity(). */
+    UInt _bufferPoolCapacity;
+
+    /** \brief The buffer pool's memory budget in bytes set by setBufferPoolBudget(). */
+    ULong _bufferPoolBudget;
+
+    /** \brief The released page wrappers' buffers kept for reusing. */
+    std::vector<Byte*> _freePageBuffers;
+
+    /** \brief The size of the kept page buffers. */
+    UInt _freePageBuffersSize;
+
+    /** \brief The count of the page buffers allocated in the heap. */
+    UInt _pageBuffersAllocsCount;
+
+    /** \brief The count of the page buffers reused from \c _freePageBuffers. */
+    UInt _pageBuffersReusesCount;
+
+    /** \brief Guards the kept page buffers and their counters. */
+    std::mutex _pageBuffersMutex;
+
+    /** \brief The tree's unique number identifying it in the threads' cached contexts. */
+    UInt _treeId;
+
+    /** \brief The contexts of the threads which used the tree, they are kept until the tree is destructed. */
+    mutable std::map<std::thread::id, ThreadContext*> _threadContexts;
+
+    /** \brief Guards the threads' contexts map. */
+    mutable std::mutex _threadContextsMutex;
+
+    /** \brief Held shared by the searches and exclusively by the modifications. */
+    SharedLatch _latch;
+
+    /** \brief True if the operations latch the pages, see setLatchCoupling(). */
+    bool _latchCoupling;
+
+    /** \brief The latches of the pages. */
+    PageLatchTable _pageLatches;
+
+    /** \brief True if the searches are optimistic, see setOptimisticSearch(). */
+    bool _optimisticSearch;
+
+    /** \brief The versions of the pages checked by the optimistic searches. */
+    PageVersionTable _pageVersions;
+
+    /** \brief Held shared by the pages' reading and exclusively by the other accesses to the page store
+     *  and to the buffer pool, when the latch coupling is on.
      */
-    UInt _freePagesCounter;
+    SharedLatch _storeLatch;
 
-#endif
+    /** \brief True if the tree is in the copy-on-write mode. */
+    bool _copyOnWrite;
+
+    /** \brief True if the tree is in the B-link mode, see setBLink(). */
+    bool _bLink;
+
+    /** \brief True if the leaves of the B+- or B*+-tree are chained, false for the trees loaded from
+     *  the files written before the leaves' links, which are searched recursively.
+     */
+    bool _leavesChained;
+
+    /** \brief The offset of the B-link tree's page's right link, which is followed by the high key. */
+    UInt _linksOfs;
+
+    /** \brief True during the modifying operation in the copy-on-write mode. */
+    bool _isCopying;
+
+    /** \brief The root page number before the current copy-on-write operation. */
+    UInt _publishedRootPageNum;
+
+    /** \brief The numbers of the copies of the pages modified by the current operation. */
+    std::map<UInt, UInt> _shadowPages;
+
+    /** \brief The pages allocated by the current operation, they are not copied. */
+    std::set<UInt> _freshPages;
+
+    /** \brief The parents of the pages read by the current operation. */
+    std::map<UInt, UInt> _parentPages;
+
+    /** \brief The pages replaced by the current operation. */
+    std::vector<UInt> _replacedPages;
+
+    /** \brief The replaced pages with the versions which replaced them, in the versions order. */
+    std::deque<std::pair<UInt, UInt> > _retiredPages;
+
+    /** \brief The published version's number. */
+    UInt _version;
+
+    /** \brief The versions read by the snapshots. */
+    std::multiset<UInt> _snapshotVersions;
 
 }; // class BaseBTree
 
@@ -833,12 +1671,17 @@ class BaseBPlusTree : public BaseBTree {
 
 public:
 
+    BaseBPlusTree(UShort order, UShort recSize, IComparator* comparator, IPageStore* store)
+            : BaseBTree(order, recSize, comparator, store) { }
+
+    BaseBPlusTree(IComparator* comparator, IPageStore* store) : BaseBTree(comparator, store) { }
+
     BaseBPlusTree(UShort order, UShort recSize, IComparator* comparator, std::iostream* stream)
             : BaseBTree(order, recSize, comparator, stream) { }
 
     BaseBPlusTree(IComparator* comparator, std::iostream* stream) : BaseBTree(comparator, stream) { }
 
-    ~BaseBPlusTree();
+    ~BaseBPlusTree() { }
 
 protected:
 
@@ -848,9 +1691,12 @@ protected:
 
 protected:
 
-    virtual Byte* search(const Byte* k, PageWrapper& currentPage, UInt currentDepth) override;
+    virtual bool search(const Byte* k, Byte* result, PageWrapper& currentPage, UInt currentDepth) override;
+
+    virtual int searchAll(const Byte* k, IKeyVisitor& visitor,
+            PageWrapper& currentPage, UInt currentDepth) override;
 
-    virtual int searchAll(const Byte* k, std::list<Byte*>& keys,
+    virtual int searchRange(const Byte* lo, const Byte* hi, IKeyVisitor& visitor,
             PageWrapper& currentPage, UInt currentDepth) override;
 
 #ifdef BTREE_WITH_DELETION
@@ -876,6 +1722,17 @@ public:
      */
     UInt getMinLeafKeys() const { return _minLeafKeys; }
 
+    virtual UInt getMaxNodeKeys(bool isLeaf, bool /*isRoot*/) const override
+    {
+        return isLeaf ? getMaxLeafKeys() : getMaxKeys();
+    }
+
+    virtual UInt getMinNodeKeys(bool isLeaf) const override { return isLeaf ? getMinLeafKeys() : getMinKeys(); }
+
+    virtual bool isLeafOriented() const override { return true; }
+
+    virtual bool isBLinkSupported() const override { return true; }
+
 protected:
 
     virtual void splitChild(PageWrapper& node, UShort iChild, PageWrapper& leftChild, PageWrapper& rightChild) override;
@@ -903,12 +1760,17 @@ class BaseBStarTree : public BaseBTree {
 
 public:
 
+    BaseBStarTree(UShort order, UShort recSize, IComparator* comparator, IPageStore* store)
+            : BaseBTree(order, recSize, comparator, store) { }
+
+    BaseBStarTree(IComparator* comparator, IPageStore* store) : BaseBTree(comparator, store) { }
+
     BaseBStarTree(UShort order, UShort recSize, IComparator* comparator, std::iostream* stream)
             : BaseBTree(order, recSize, comparator, stream) { }
 
     BaseBStarTree(IComparator* comparator, std::iostream* stream) : BaseBTree(comparator, stream) { }
 
-    ~BaseBStarTree();
+    ~BaseBStarTree() { }
 
 protected:
 
@@ -951,6 +1813,11 @@ public:
      */
     UInt getMaxRootKeys() const { return _maxRootKeys; }
 
+    virtual UInt getMaxNodeKeys(bool /*isLeaf*/, bool isRoot) const override
+    {
+        return isRoot ? getMaxRootKeys() : getMaxKeys();
+    }
+
     /**
      * \brief Returns the keys number for the left split product in the B*-tree.
      * \returns The keys number for the left split product in the B*-tree.
@@ -1061,12 +1928,17 @@ class BaseBStarPlusTree : public BaseBStarTree {
 
 public:
 
+    BaseBStarPlusTree(UShort order, UShort recSize, IComparator* comparator, IPageStore* store)
+            : BaseBStarTree(order, recSize, comparator, store) { }
+
+    BaseBStarPlusTree(IComparator* comparator, IPageStore* store) : BaseBStarTree(comparator, store) { }
+
     BaseBStarPlusTree(UShort order, UShort recSize, IComparator* comparator, std::iostream* stream)
             : BaseBStarTree(order, recSize, comparator, stream) { }
 
     BaseBStarPlusTree(IComparator* comparator, std::iostream* stream) : BaseBStarTree(comparator, stream) { }
 
-    ~BaseBStarPlusTree();
+    ~BaseBStarPlusTree() { }
 
 protected:
 
@@ -1076,9 +1948,12 @@ protected:
 
 protected:
 
-    virtual Byte* search(const Byte* k, PageWrapper& currentPage, UInt currentDepth) override;
+    virtual bool search(const Byte* k, Byte* result, PageWrapper& currentPage, UInt currentDepth) override;
 
-    virtual int searchAll(const Byte* k, std::list<Byte*>& keys,
+    virtual int searchAll(const Byte* k, IKeyVisitor& visitor,
+            PageWrapper& currentPage, UInt currentDepth) override;
+
+    virtual int searchRange(const Byte* lo, const Byte* hi, IKeyVisitor& visitor,
             PageWrapper& currentPage, UInt currentDepth) override;
 
 #ifdef BTREE_WITH_DELETION
@@ -1127,6 +2002,8 @@ public:
      */
     UInt getMiddleLeafSplitProductKeys() const { return _middleLeafSplitProductKeys; }
 
+    virtual bool isLeafOriented() const override { return true; }
+
 protected:
 
     /**
@@ -1139,6 +2016,14 @@ protected:
 /** \brief B-tree based on the file stream. */
 class FileBaseBTree {
 
+public:
+
+    /** \brief The way the tree's file is accessed.
+     *
+     *  WRITE_AHEAD_LOG is the positional access with the changes committed through the write-ahead log.
+     */
+    enum StorageType { STREAM, MEMORY_MAPPED, POSITIONAL, WRITE_AHEAD_LOG };
+
 public:
 
     /** \brief Default constructor */
@@ -1169,13 +2054,14 @@ public:
      *  it will be overwritten. If file cannot be open, throws an exception.
      */
     FileBaseBTree(BaseBTree::TreeType treeType, UShort order, UShort recSize,
-            BaseBTree::IComparator* comparator, const std::string& fileName);
+            BaseBTree::IComparator* comparator, const std::string& fileName, StorageType storageType = STREAM);
 
     /** \brief Constructs the tree by the received type from existing tree's file.
      *
      *  If file cannot be opened, read or is incorrect, throws an exception.
      */
-    FileBaseBTree(BaseBTree::TreeType treeType, const std::string& fileName, BaseBTree::IComparator* comparator);
+    FileBaseBTree(BaseBTree::TreeType treeType, const std::string& fileName, BaseBTree::IComparator* comparator,
+            StorageType storageType = STREAM);
 
     /** \brief Destructor.
      *
@@ -1208,6 +2094,24 @@ public:
 
     BaseBTree* getTree() const { return _tree; }
 
+    /** \brief Returns the way the tree's file is accessed. */
+    StorageType getStorageType() const { return _storageType; }
+
+    /** \brief Sets the way the tree's file is accessed by the following create() or open().
+     *
+     *  If tree is already opened, throws an exception.
+     */
+    void setStorageType(StorageType storageType);
+
+#ifdef BTREE_WITH_POSIX_IO
+
+    /** \brief Returns the page store used by the WRITE_AHEAD_LOG storage type, so its group size
+     *  and checkpoints can be set.
+     */
+    WalPageStore& getWalStore() { return _walStore; }
+
+#endif
+
 public:
 
     void insert(const Byte* k) { _tree->insert(k); }
@@ -1216,6 +2120,17 @@ public:
 
     int searchAll(const Byte* k, std::list<Byte*>& keys) { return _tree->searchAll(k, keys); }
 
+    int searchRange(const Byte* lo, const Byte* hi, std::list<Byte*>& keys) { return _tree->searchRange(lo, hi, keys); }
+
+    bool search(const Byte* k, Byte* result) { return _tree->search(k, result); }
+
+    int searchAll(const Byte* k, BaseBTree::IKeyVisitor& visitor) { return _tree->searchAll(k, visitor); }
+
+    int searchRange(const Byte* lo, const Byte* hi, BaseBTree::IKeyVisitor& visitor)
+    {
+        return _tree->searchRange(lo, hi, visitor);
+    }
+
 #ifdef BTREE_WITH_DELETION
 
     bool remove(const Byte* k) { return _tree->remove(k); }
@@ -1237,6 +2152,15 @@ protected:
     /** \brief The internal part of close(). */
     void closeInternal();
 
+    /** \brief Opens the tree's file with name \c fileName according to the storage type.
+     *
+     *  If \c truncate is true, the file's content is dropped. If file cannot be open, throws an exception.
+     */
+    void openStorage(const std::string& fileName, bool truncate);
+
+    /** \brief Closes the tree's file. */
+    void closeStorage();
+
     /** \brief Checks the tree's params. If they are incorrect, throws an exception. */
     void checkTreeParams(UShort order, UShort recSize);
 
@@ -1248,6 +2172,29 @@ protected:
     /** \brief The file stream storing the tree. */
     std::fstream _fileStream;
 
+    /** \brief The page store above the file stream. */
+    StreamPageStore _streamStore;
+
+#ifdef BTREE_WITH_MMAP
+
+    /** \brief The page store above the memory-mapped file. */
+    MappedPageStore _mappedStore;
+
+#endif
+
+#ifdef BTREE_WITH_POSIX_IO
+
+    /** \brief The page store above the file accessed by the positional reads and writes. */
+    PosixPageStore _posixStore;
+
+    /** \brief The page store above the file with the write-ahead log. */
+    WalPageStore _walStore;
+
+#endif
+
+    /** \brief The way the tree's file is accessed. */
+    StorageType _storageType = STREAM;
+
     BaseBTree* _tree = nullptr;
 
     bool isComposition = false;
@@ -0,0 +1,256 @@
+/// \file
+/// \brief     LRU buffer pool of the tree's pages.
+/// \authors   Anton Rigin
+/// \version   0.1.0
+/// \date      16.10.2026
+///
+////////////////////////////////////////////////////////////////////////////////
+
+#include "bufferpool.h"
+
+#include <stdexcept>        // std::invalid_argument
+#include <cstring>          // memcpy
+
+namespace btree {
+
+//==============================================================================
+// class BufferPool
+//==============================================================================
+
+BufferPool::BufferPool(IPageIO* io, UInt pageSize, UInt capacity)
+    : _io(io),
+    _pageSize(pageSize),
+    _capacity(capacity),
+    _hitsCount(0),
+    _missesCount(0),
+    _evictionsCount(0),
+    _writeBacksCount(0)
+{
+    if (io == nullptr)
+        throw std::invalid_argument("Buffer pool's storage not set");
+
+    if (pageSize == 0 || capacity == 0)
+        throw std::invalid_argument("Buffer pool's page size and capacity can't be 0");
+}
+
+BufferPool::~BufferPool()
+{
+    for (std::vector<Frame>::iterator iter = _frames.begin(); iter != _frames.end(); ++iter)
+        delete[] iter->data;
+}
+
+Byte* BufferPool::pin(UInt pnum, bool load)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    bool hit;
+    UInt frameNum = load ? loadFrame(pnum) : getFrame(pnum, false, hit);
+
+    Frame& frame = _frames[frameNum];
+    ++frame.pinCount;
+
+    return frame.data;
+}
+
+void BufferPool::unpin(UInt pnum, bool dirty)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    std::unordered_map<UInt, UInt>::iterator found = _pageFrames.find(pnum);
+    if (found == _pageFrames.end() || _frames[found->second].pinCount == 0)
+        throw std::invalid_argument("Page is not pinned");
+
+    Frame& frame = _frames[found->second];
+    --frame.pinCount;
+    frame.dirty = frame.dirty || dirty;
+}
+
+void BufferPool::read(UInt pnum, Byte* dst)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    memcpy(dst, _frames[loadFrame(pnum)].data, _pageSize);
+}
+
+void BufferPool::write(UInt pnum, const Byte* src)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    bool hit;
+    Frame& frame = _frames[getFrame(pnum, false, hit)];
+
+    memcpy(frame.data, src, _pageSize);
+    frame.dirty = true;
+}
+
+void BufferPool::discard(UInt pnum)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    std::unordered_map<UInt, UInt>::iterator found = _pageFrames.find(pnum);
+    if (found == _pageFrames.end())
+        return;
+
+    UInt frameNum = found->second;
+    Frame& frame = _frames[frameNum];
+
+    if (frame.pinCount > 0)
+        throw std::runtime_error("Can't discard a pinned page");
+
+    _lru.erase(frame.lruPos);
+    _pageFrames.erase(found);
+
+    frame.pageNum = 0;
+    frame.dirty = false;
+    _freeFrames.push_back(frameNum);
+}
+
+void BufferPool::flush()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    for (std::vector<Frame>::iterator iter = _frames.begin(); iter != _frames.end(); ++iter)
+        writeBack(*iter);
+}
+
+void BufferPool::clear()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    _lru.clear();
+    _pageFrames.clear();
+    _freeFrames.clear();
+
+    for (UInt i = 0; i < _frames.size(); ++i)
+    {
+        _frames[i].pageNum = 0;
+        _frames[i].dirty = false;
+        _frames[i].pinCount = 0;
+        _freeFrames.push_back(i);
+    }
+}
+
+void BufferPool::resetCounters()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    _hitsCount = 0;
+    _missesCount = 0;
+    _evictionsCount = 0;
+    _writeBacksCount = 0;
+}
+
+UInt BufferPool::loadFrame(UInt pnum)
+{
+    bool hit;
+    UInt frameNum = getFrame(pnum, true, hit);
+
+    if (hit)
+        ++_hitsCount;
+    else
+        ++_missesCount;
+
+    return frameNum;
+}
+
+UInt BufferPool::getFrame(UInt pnum, bool load, bool& hit)
+{
+    std::unordered_map<UInt, UInt>::iterator found = _pageFrames.find(pnum);
+    if (found != _pageFrames.end())
+    {
+        hit = true;
+        touch(found->second);
+        return found->second;
+    }
+
+    hit = false;
+
+    UInt frameNum = getFreeFrame();
+    Frame& frame = _frames[frameNum];
+
+    if (load)
+    {
+        // The frame taken for the page that can't be read is given back, so it is not lost for the pool.
+        try {
+            _io->read(pnum, frame.data);
+        }
+        catch (...)
+        {
+            _freeFrames.push_back(frameNum);
+            throw;
+        }
+    }
+
+    frame.pageNum = pnum;
+    frame.dirty = false;
+    frame.pinCount = 0;
+
+    _lru.push_front(frameNum);
+    frame.lruPos = _lru.begin();
+    _pageFrames[pnum] = frameNum;
+
+    return frameNum;
+}
+
+UInt BufferPool::getFreeFrame()
+{
+    if (!_freeFrames.empty())
+    {
+        UInt frameNum = _freeFrames.back();
+        _freeFrames.pop_back();
+        return frameNum;
+    }
+
+    if (_frames.size() < _capacity)
+    {
+        Frame frame;
+        frame.pageNum = 0;
+        frame.data = new Byte[_pageSize];
+        frame.dirty = false;
+        frame.pinCount = 0;
+        _frames.push_back(frame);
+
+        return (UInt)_frames.size() - 1;
+    }
+
+    for (std::list<UInt>::reverse_iterator iter = _lru.rbegin(); iter != _lru.rend(); ++iter)
+    {
+        Frame& victim = _frames[*iter];
+        if (victim.pinCount > 0)
+            continue;
+
+        UInt frameNum = *iter;
+
+        writeBack(victim);
+
+        _pageFrames.erase(victim.pageNum);
+        _lru.erase(victim.lruPos);
+        victim.pageNum = 0;
+        ++_evictionsCount;
+
+        return frameNum;
+    }
+
+    throw std::runtime_error("All buffer pool's pages are pinned");
+}
+
+void BufferPool::touch(UInt frameNum)
+{
+    Frame& frame = _frames[frameNum];
+    if (frame.lruPos == _lru.begin())
+        return;
+
+    _lru.splice(_lru.begin(), _lru, frame.lruPos);
+}
+
+void BufferPool::writeBack(Frame& frame)
+{
+    if (frame.pageNum == 0 || !frame.dirty)
+        return;
+
+    _io->write(frame.pageNum, frame.data);
+    frame.dirty = false;
+    ++_writeBacksCount;
+}
+
+} // namespace btree
@@ -0,0 +1,216 @@
+/// \file
+/// \brief     LRU buffer pool of the tree's pages.
+/// \authors   Anton Rigin
+/// \version   0.1.0
+/// \date      16.10.2026
+///
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef BTREE_BUFFERPOOL_H_
+#define BTREE_BUFFERPOOL_H_
+
+#include <list>
+#include <mutex>
+#include <vector>
+#include <unordered_map>
+
+#include "utils.h"
+
+namespace btree {
+
+/** \brief Interface defining the pages reading / writing operations of the underlying storage.
+ *
+ *  All pages are numbered from 1, 0 is nonexistent page (nullptr).
+ */
+class IPageIO {
+public:
+
+    /** \brief Reads the page with number \c pnum from the storage to the memory in \c dst. */
+    virtual void read(UInt pnum, Byte* dst) = 0;
+
+    /** \brief Writes the page with number \c pnum from the memory in \c src to the storage. */
+    virtual void write(UInt pnum, const Byte* src) = 0;
+
+protected:
+
+    ~IPageIO() {};
+
+}; // class IPageIO
+
+/** \brief The buffer pool caching the pages of the fixed size in the memory.
+ *
+ *  Pages are read from the underlying IPageIO on a miss and are written back to it on the eviction
+ *  (if they are dirty) or on flush(). The least recently used unpinned page is evicted first.
+ *
+ *  A pinned page stays in the memory until all its pins are released by unpin().
+ *  The operations are serialized by the pool's mutex, so the concurrent readers of the tree share the pool.
+ */
+class BufferPool {
+
+public:
+
+    /** \brief Constructs the buffer pool.
+     *
+     *  \param io The underlying storage.
+     *  \param pageSize The page size in bytes.
+     *  \param capacity The max pages count stored in the pool. Should not be 0.
+     *  \throws std::invalid_argument if \c io is nullptr or \c pageSize or \c capacity is 0.
+     */
+    BufferPool(IPageIO* io, UInt pageSize, UInt capacity);
+
+    /** \brief Destructor. Does not write the dirty pages back, flush() should be called before. */
+    ~BufferPool();
+
+protected:
+
+    BufferPool(const BufferPool&);
+
+    BufferPool& operator= (BufferPool&);
+
+public:
+
+    /** \brief Pins the page with number \c pnum and returns the pointer to its data in the pool.
+     *
+     *  If \c load is false and the page is not in the pool, its data are not read from the storage
+     *  (it is useful when the whole page will be overwritten).
+     *  \throws std::runtime_error if all the pool's pages are pinned.
+     */
+    Byte* pin(UInt pnum, bool load = true);
+
+    /** \brief Releases one pin of the page with number \c pnum. Marks the page dirty if \c dirty is true.
+     *
+     *  \throws std::invalid_argument if the page is not pinned.
+     */
+    void unpin(UInt pnum, bool dirty = false);
+
+    /** \brief Copies the page with number \c pnum to the memory in \c dst (through the pool). */
+    void read(UInt pnum, Byte* dst);
+
+    /** \brief Copies the page with number \c pnum from the memory in \c src to the pool and marks it dirty. */
+    void write(UInt pnum, const Byte* src);
+
+    /** \brief Removes the page with number \c pnum from the pool without writing it back.
+     *
+     *  It is used when the page's content in the storage is replaced bypassing the pool or is not needed anymore.
+     *  \throws std::runtime_error if the page is pinned.
+     */
+    void discard(UInt pnum);
+
+    /** \brief Writes all the dirty pages back to the storage. */
+    void flush();
+
+    /** \brief Removes all the pages from the pool without writing them back. */
+    void clear();
+
+public:
+
+    /** \brief Returns the max pages count stored in the pool. */
+    UInt getCapacity() const { return _capacity; }
+
+    /** \brief Returns the page size. */
+    UInt getPageSize() const { return _pageSize; }
+
+    /** \brief Returns the pages count currently stored in the pool. */
+    UInt getPagesCount() const { return (UInt)_pageFrames.size(); }
+
+    /** \brief Returns the count of the page requests served from the pool. */
+    UInt getHitsCount() const { return _hitsCount; }
+
+    /** \brief Returns the count of the page requests which required reading the page from the storage. */
+    UInt getMissesCount() const { return _missesCount; }
+
+    /** \brief Returns the count of the evicted pages. */
+    UInt getEvictionsCount() const { return _evictionsCount; }
+
+    /** \brief Returns the count of the dirty pages written back to the storage. */
+    UInt getWriteBacksCount() const { return _writeBacksCount; }
+
+    /** \brief Sets all the counters to 0. */
+    void resetCounters();
+
+protected:
+
+    /** \brief The page frame of the pool. */
+    struct Frame {
+
+        /** \brief The number of the page stored in the frame, 0 if the frame is free. */
+        UInt pageNum;
+
+        /** \brief The page's data. */
+        Byte* data;
+
+        /** \brief Defines whether the page's data differ from the storage's ones. */
+        bool dirty;
+
+        /** \brief The pins count. */
+        UInt pinCount;
+
+        /** \brief The frame's position in the LRU list. */
+        std::list<UInt>::iterator lruPos;
+
+    }; // struct Frame
+
+    /** \brief Returns the index of the frame storing the page with number \c pnum, reading it on a miss,
+     *  and counts the hit or the miss.
+     */
+    UInt loadFrame(UInt pnum);
+
+    /** \brief Returns the index of the frame storing the page with number \c pnum.
+     *
+     *  If there is no such a frame, takes the free (or evicted) one and reads the page into it if \c load is true.
+     *  \c hit is set to true if the page was found in the pool.
+     */
+    UInt getFrame(UInt pnum, bool load, bool& hit);
+
+    /** \brief Returns the index of the free frame, evicts the least recently used unpinned page if necessary. */
+    UInt getFreeFrame();
+
+    /** \brief Moves the frame to the begin of the LRU list. */
+    void touch(UInt frameNum);
+
+    /** \brief Writes the frame's page back to the storage if it is dirty. */
+    void writeBack(Frame& frame);
+
+protected:
+
+    /** \brief The underlying storage. */
+    IPageIO* _io;
+
+    /** \brief The page size. */
+    UInt _pageSize;
+
+    /** \brief The max pages count stored in the pool. */
+    UInt _capacity;
+
+    /** \brief The frames (allocated lazily up to the capacity). */
+    std::vector<Frame> _frames;
+
+    /** \brief The indices of the free frames. */
+    std::vector<UInt> _freeFrames;
+
+    /** \brief The frames' indices ordered from the most recently to the least recently used one. */
+    std::list<UInt> _lru;
+
+    /** \brief The map from the page number to the index of the frame storing this page. */
+    std::unordered_map<UInt, UInt> _pageFrames;
+
+    /** \brief The count of the page requests served from the pool. */
+    UInt _hitsCount;
+
+    /** \brief The count of the page requests which required reading the page from the storage. */
+    UInt _missesCount;
+
+    /** \brief The count of the evicted pages. */
+    UInt _evictionsCount;
+
+    /** \brief The count of the dirty pages written back to the storage. */
+    UInt _writeBacksCount;
+
+    /** \brief Guards the frames and the counters. */
+    std::mutex _mutex;
+
+}; // class BufferPool
+
+} // namespace btree
+
+#endif // BTREE_BUFFERPOOL_H_
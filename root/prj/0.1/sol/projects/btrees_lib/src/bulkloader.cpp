@@ -0,0 +1,234 @@
+/// \file
+/// \brief     Bulk loading of the B-trees from the sorted keys.
+/// \authors   Anton Rigin
+/// \version   0.1.0
+/// \date      16.10.2026
+///
+////////////////////////////////////////////////////////////////////////////////
+
+#include "bulkloader.h"
+
+#include <cstring>          // memcpy
+#include <stdexcept>
+
+namespace btree {
+
+//==============================================================================
+// class BulkLoader
+//==============================================================================
+
+BulkLoader::BulkLoader(BaseBTree* tree, ULong keysCount, double fillFactor)
+    : _tree(tree)
+    , _keysCount(keysCount)
+    , _addedKeys(0)
+{
+    if (_tree == nullptr)
+        throw std::invalid_argument("Tree can't be nullptr");
+
+    if (!(fillFactor > 0.0 && fillFactor <= 1.0))
+        throw std::invalid_argument("Fill factor should be in (0, 1]");
+
+    if (!_tree->isOpened() || _tree->getRootPageNum() == 0)
+        throw std::invalid_argument("Tree is not created");
+
+    if (_tree->getComparator() == nullptr)
+        throw std::invalid_argument("Comparator not set. Can't load");
+
+    const BaseBTree::PageWrapper& root = _tree->getRootPage();
+    if (!root.isLeaf() || root.getKeysNum() != 0)
+        throw std::invalid_argument("Only an empty tree can be loaded");
+
+    _prevKey.resize(_tree->getRecSize());
+
+    planLevels(keysCount, fillFactor);
+}
+
+BulkLoader::~BulkLoader()
+{
+    for (std::vector<Level*>::iterator iter = _levels.begin(); iter != _levels.end(); ++iter)
+        delete *iter;
+}
+
+void BulkLoader::add(const Byte* k)
+{
+    if (_addedKeys == _keysCount)
+        throw std::invalid_argument("More keys than declared are added");
+
+    UShort recSize = _tree->getRecSize();
+    if (_addedKeys > 0 && _tree->getComparator()->compare(k, &_prevKey[0], recSize))
+        throw std::invalid_argument("Keys should be added in the ascending order");
+
+    memcpy(&_prevKey[0], k, recSize);
+    ++_addedKeys;
+
+    addKey(0, k);
+}
+
+void BulkLoader::finish()
+{
+    if (_addedKeys != _keysCount)
+        throw std::runtime_error("Less keys than declared are added");
+
+    // The root is written in place of the empty one, so it is only reloaded.
+    _tree->getRootPage().readPage(_tree->getRootPageNum());
+
+    // The pages are written level by level, so the B-link tree's siblings are linked afterwards.
+    _tree->linkSiblings();
+
+    // The loaded pages are committed at once rather than with the following operations.
+    _tree->flushBufferPool();
+    _tree->getStore()->commit();
+}
+
+void BulkLoader::planLevels(ULong keysCount, double fillFactor)
+{
+    ULong keys = keysCount;
+    bool isLeaf = true;
+
+    for ( ; ; )
+    {
+        Level* level = new Level(_tree);
+        _levels.push_back(level);
+
+        level->isLeaf = isLeaf;
+        level->node = 0;
+        level->children = 0;
+        level->awaitingSeparator = false;
+
+        if (keys <= _tree->getMaxNodeKeys(isLeaf, true))
+        {
+            level->nodes = 1;
+            level->nodeKeys = (UInt)keys;
+            level->extraNodes = 0;
+            level->isRoot = true;
+            resetPage(*level);
+
+            return;
+        }
+
+        level->isRoot = false;
+        resetPage(*level);
+
+        ULong maxKeys = _tree->getMaxNodeKeys(isLeaf, false);
+        ULong minKeys = _tree->getMinNodeKeys(isLeaf);
+        ULong targetKeys = (ULong)(fillFactor * maxKeys);
+        if (targetKeys < minKeys)
+            targetKeys = minKeys;
+        if (targetKeys == 0)
+            targetKeys = 1;
+
+        // Except the leaves of the B+- and B*+-trees, a key between each two neighbour nodes is moved
+        // to the upper level, so P nodes share (keys - P + 1) keys. Counting the moved key with the left node
+        // makes the nodes share (keys + 1) slots.
+        ULong slot = (isLeaf && _tree->isLeafOriented()) ? 0 : 1;
+        ULong slots = keys + slot;
+
+        ULong minNodes = (slots + maxKeys + slot - 1) / (maxKeys + slot);
+        ULong maxNodes = slots / (minKeys + slot);
+        ULong nodes = (slots + targetKeys + slot - 1) / (targetKeys + slot);
+        if (nodes > maxNodes)
+            nodes = maxNodes;
+        if (nodes < minNodes)
+            nodes = minNodes;
+
+        ULong storedKeys = keys - slot * (nodes - 1);
+        level->nodes = (UInt)nodes;
+        level->nodeKeys = (UInt)(storedKeys / nodes);
+        level->extraNodes = (UInt)(storedKeys % nodes);
+
+        // The upper level gets a separator or a router between each two neighbour nodes.
+        keys = nodes - 1;
+        isLeaf = false;
+    }
+}
+
+UInt BulkLoader::getPlannedKeys(const Level& level) const
+{
+    return level.nodeKeys + (level.node < level.extraNodes ? 1 : 0);
+}
+
+void BulkLoader::addKey(UInt levelNum, const Byte* k)
+{
+    Level& level = *_levels[levelNum];
+    if (level.awaitingSeparator)
+    {
+        level.awaitingSeparator = false;
+        addKey(levelNum + 1, k);
+
+        return;
+    }
+
+    UShort keysNum = level.page.getKeysNum();
+    level.page.setKeyNum(keysNum + 1, level.isRoot);
+    memcpy(level.page.getKey(keysNum), k, _tree->getRecSize());
+
+    // The inner nodes are completed by their last children.
+    if (level.isLeaf && keysNum + 1u == getPlannedKeys(level))
+        completeNode(levelNum);
+}
+
+void BulkLoader::addChild(UInt levelNum, UInt pnum)
+{
+    Level& level = *_levels[levelNum];
+
+    level.page.setCursor(level.children, pnum);
+    ++level.children;
+
+    if (level.children == getPlannedKeys(level) + 1)
+        completeNode(levelNum);
+}
+
+void BulkLoader::completeNode(UInt levelNum)
+{
+    Level& level = *_levels[levelNum];
+    if (level.isRoot)
+    {
+        _tree->writePage(_tree->getRootPageNum(), level.page.getData());
+
+        return;
+    }
+
+    bool isLast = level.node + 1 == level.nodes;
+
+    // The next leaf is allocated after this one and its completed parents.
+    if (!isLast && level.isLeaf && _tree->isLeafOriented())
+        level.page.setNextLeaf(_tree->getStore()->getAllocPageNum(1 + getCompletedParentsCount(levelNum)));
+
+    UInt pnum = _tree->getStore()->alloc(level.page.getData());
+    addChild(levelNum + 1, pnum);
+
+    if (!isLast)
+    {
+        if (level.isLeaf && _tree->isLeafOriented())
+            addKey(levelNum + 1, level.page.getKey(level.page.getKeysNum() - 1));
+        else
+            level.awaitingSeparator = true;
+    }
+
+    ++level.node;
+    level.children = 0;
+    resetPage(level);
+}
+
+UInt BulkLoader::getCompletedParentsCount(UInt levelNum) const
+{
+    UInt count = 0;
+    for (UInt parentNum = levelNum + 1; parentNum < _levels.size(); ++parentNum)
+    {
+        const Level& parent = *_levels[parentNum];
+        if (parent.isRoot || parent.children != getPlannedKeys(parent))
+            break;
+
+        ++count;
+    }
+
+    return count;
+}
+
+void BulkLoader::resetPage(Level& level)
+{
+    level.page.clear();
+    level.page.setKeyNumLeaf(0, level.isRoot, level.isLeaf);
+}
+
+} // namespace btree
@@ -0,0 +1,198 @@
+/// \file
+/// \brief     Bulk loading of the B-trees from the sorted keys.
+/// \authors   Anton Rigin
+/// \version   0.1.0
+/// \date      16.10.2026
+///
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef BTREE_BULKLOADER_H_
+#define BTREE_BULKLOADER_H_
+
+#include <iterator>         // std::distance, std::iterator_traits
+#include <type_traits>      // std::is_base_of
+#include <vector>
+
+#include "btree.h"
+
+namespace btree {
+
+/** \brief Builder of the tree from the keys given in the ascending order.
+ *
+ *  The tree is built bottom-up: the nodes of all the levels are filled simultaneously while the keys
+ *  are added, and each node is written to the store exactly once when it is completed.
+ *  The nodes' sizes are planned beforehand from the keys count, so each non-root node is filled
+ *  up to the fill factor of its max keys number but not less than its min keys number.
+ *
+ *  Works for all the tree types: in the B+- and B*+-trees the inner nodes get the copies of the
+ *  leaves' max keys as the routers and the leaves are chained, in the B- and B*-trees the separators
+ *  are moved up from the leaves.
+ */
+class BulkLoader {
+
+public:
+
+    /** \brief Constructs the loader of \c keysCount keys into the tree \c tree.
+     *
+     *  \param tree The tree created by createTree() and still empty.
+     *  \param keysCount The count of the keys which will be added.
+     *  \param fillFactor The part of the non-root nodes' max keys number filled by the loader.
+     *  \throws std::invalid_argument if \c fillFactor is not in (0, 1], the tree is not opened, is not empty
+     *  or has no comparator.
+     */
+    BulkLoader(BaseBTree* tree, ULong keysCount, double fillFactor = 1.0);
+
+    /** \brief Destructor. */
+    ~BulkLoader();
+
+protected:
+
+    BulkLoader(const BulkLoader&);
+
+    BulkLoader& operator= (BulkLoader&);
+
+public:
+
+    /** \brief Adds the key \c k which must not be less than the previous one.
+     *
+     *  \throws std::invalid_argument if the keys are not sorted or there are more keys than declared.
+     */
+    void add(const Byte* k);
+
+    /** \brief Reloads the tree's root written by the last added key.
+     *
+     *  \throws std::runtime_error if less keys than declared are added.
+     */
+    void finish();
+
+    /** \brief Returns the count of the added keys. */
+    ULong getAddedKeysCount() const { return _addedKeys; }
+
+    /** \brief Returns the levels count of the built tree. */
+    UInt getLevelsCount() const { return (UInt)_levels.size(); }
+
+    /** \brief Returns the count of the nodes on the level \c level, the leaves are on the level 0. */
+    UInt getNodesCount(UInt level) const { return _levels[level]->nodes; }
+
+protected:
+
+    /** \brief The planned nodes and the node being filled of a tree's level. */
+    struct Level {
+
+        Level(BaseBTree* tree) : page(tree) { }
+
+        /** \brief The nodes count. */
+        UInt nodes;
+
+        /** \brief The min keys number of the level's nodes. The first \c extraNodes nodes have one key more. */
+        UInt nodeKeys;
+
+        /** \brief The count of the nodes with one extra key. */
+        UInt extraNodes;
+
+        /** \brief True for the leaves. */
+        bool isLeaf;
+
+        /** \brief True if the level consists of the root only. */
+        bool isRoot;
+
+        /** \brief The node being filled. */
+        BaseBTree::PageWrapper page;
+
+        /** \brief The number of the node being filled. */
+        UInt node;
+
+        /** \brief The children count of the node being filled. */
+        UInt children;
+
+        /** \brief True if the next key coming to the level is the separator moved to the upper level. */
+        bool awaitingSeparator;
+
+    }; // struct Level
+
+protected:
+
+    /** \brief Plans the levels' nodes for \c keysCount keys. */
+    void planLevels(ULong keysCount, double fillFactor);
+
+    /** \brief Returns the keys number of the node being filled on the level \c level. */
+    UInt getPlannedKeys(const Level& level) const;
+
+    /** \brief Adds the key \c k to the node being filled on the level with number \c levelNum. */
+    void addKey(UInt levelNum, const Byte* k);
+
+    /** \brief Adds the child page \c pnum to the node being filled on the level with number \c levelNum. */
+    void addChild(UInt levelNum, UInt pnum);
+
+    /** \brief Writes the node being filled on the level with number \c levelNum and starts the next one. */
+    void completeNode(UInt levelNum);
+
+    /** \brief Returns the count of the non-root nodes above the level with number \c levelNum which will be
+     *  completed by adding the node being filled on this level.
+     */
+    UInt getCompletedParentsCount(UInt levelNum) const;
+
+    /** \brief Prepares the empty page of the node being filled on the level \c level. */
+    void resetPage(Level& level);
+
+protected:
+
+    /** \brief The tree being loaded. */
+    BaseBTree* _tree;
+
+    /** \brief The tree's levels from the leaves to the root. */
+    std::vector<Level*> _levels;
+
+    /** \brief The declared keys count. */
+    ULong _keysCount;
+
+    /** \brief The added keys count. */
+    ULong _addedKeys;
+
+    /** \brief The previous added key. */
+    std::vector<Byte> _prevKey;
+
+}; // class BulkLoader
+
+/** \brief Loads \c keysCount keys read from the sorted sequence starting at \c first
+ *  into the empty tree \c tree as BulkLoader does with the fill factor \c fillFactor.
+ *
+ *  The sequence is read once and the iterator is not advanced past its last key,
+ *  so single-pass iterators like std::istream_iterator may be used. Its values must be
+ *  convertible to const Byte*. The count must be known beforehand, as the levels are planned from it.
+ */
+template <typename Iterator>
+void bulkLoad(BaseBTree* tree, Iterator first, ULong keysCount, double fillFactor = 1.0)
+{
+    BulkLoader loader(tree, keysCount, fillFactor);
+
+    for (ULong i = 0; i < keysCount; ++i)
+    {
+        if (i > 0)
+            ++first;
+
+        loader.add(*first);
+    }
+
+    loader.finish();
+}
+
+/** \brief Loads the keys from the sorted range [first, last) into the empty tree \c tree
+ *  as BulkLoader does with the fill factor \c fillFactor.
+ *
+ *  The range is counted before the loading, so it must be a forward one at least.
+ *  Its values must be convertible to const Byte*.
+ */
+template <typename Iterator>
+void bulkLoad(BaseBTree* tree, Iterator first, Iterator last, double fillFactor = 1.0)
+{
+    static_assert(std::is_base_of<std::forward_iterator_tag,
+        typename std::iterator_traits<Iterator>::iterator_category>::value,
+        "Single-pass iterators need the keys count");
+
+    bulkLoad(tree, first, (ULong)std::distance(first, last), fillFactor);
+}
+
+} // namespace btree
+
+#endif // BTREE_BULKLOADER_H_
@@ -10,99 +10,166 @@
 
 #include "indexer.h"
 
+#include <algorithm>        // std::sort, std::inplace_merge
+#include <iterator>         // std::istreambuf_iterator
+#include <thread>
+
+#include "bulkloader.h"
+#include "mappedfile.h"
+
 namespace btree
 {
 
-Indexer::Key::Key(const std::wstring& nam) : offset(0)
+namespace
 {
-    int len = nam.length() + 1;
-    len = len > NAME_LENGTH ? NAME_LENGTH : len;
-    memcpy(name, nam.c_str(), len * 2);
-}
 
-bool Indexer::NameComparator::compare(const Byte* lhv, const Byte* rhv, UInt sz)
+/** \brief The bytes of the indexed file, mapped to the memory where it is supported and read otherwise. */
+class FileBytes
 {
-    if(lhv == nullptr)
-        throw std::invalid_argument("lhv was nullptr");
 
-    if(rhv == nullptr)
-        throw std::invalid_argument("rhv was nullptr");
+public:
 
-    int i = 0;
-
-    for( ; i < NAME_LENGTH; i += 2)
+    /** \brief Maps or reads the file with the name \c fileName.
+     *
+     *  \throws std::logic_error If the file cannot be opened.
+     */
+    FileBytes(const std::string& fileName)
     {
-        wchar_t lchar = lhv[i];
-        wchar_t rchar = rhv[i];
+#ifdef BTREE_WITH_MMAP
+        try
+        {
+            _file.openReadOnly(fileName);
+        }
+        catch(const std::runtime_error&)
+        {
+            throw std::logic_error("Cannot open file for indexing.\n");
+        }
+#else
+        std::ifstream file(fileName, std::ios_base::binary);
+
+        if(!file.is_open())
+            throw std::logic_error("Cannot open file for indexing.\n");
+
+        _data.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+#endif
+    }
 
-        if(lchar == 0 || rchar == 0)
-            break;
+public:
 
-        if(lchar < rchar)
-            return true;
+#ifdef BTREE_WITH_MMAP
 
-        if(lchar > rchar)
-            return false;
-    }
+    const char* begin() const { return (const char*) _file.getData(); }
 
-    if(i < NAME_LENGTH)
-    {
-        wchar_t lchar = lhv[i];
-        wchar_t rchar = rhv[i];
+    size_t size() const { return _file.getSize(); }
 
-        if(lchar == 0 && rchar != 0)
-            return true;
-    }
+#else
 
-    return false;
-}
+    const char* begin() const { return _data.data(); }
 
-bool Indexer::NameComparator::isEqual(const Byte* lhv, const Byte* rhv, UInt sz)
-{
-    if(lhv == nullptr)
-        throw std::invalid_argument("lhv was nullptr");
+    size_t size() const { return _data.size(); }
 
-    if(rhv == nullptr)
-        throw std::invalid_argument("rhv was nullptr");
+#endif
 
-    int i = 0;
+    const char* end() const { return begin() + size(); }
 
-    for( ; i < NAME_LENGTH; i += 2)
-    {
-        wchar_t lchar = lhv[i];
-        wchar_t rchar = rhv[i];
+private:
+
+#ifdef BTREE_WITH_MMAP
+    /** \brief The file mapped for reading. */
+    MappedFile _file;
+#else
+    /** \brief The file's contents. */
+    std::vector<char> _data;
+#endif
+
+}; // class FileBytes
 
-        if(lchar == 0 || rchar == 0)
+} // namespace
+
+Indexer::Key::Key(const std::wstring& nam) : offset(0)
+{
+    size_t len = 0;
+    for(std::wstring::const_iterator iter = nam.begin(); iter != nam.end() && appendChar(*iter, len); ++iter) ;
+
+    memset(name + len, 0, NAME_LENGTH - len);
+}
+
+Indexer::Key::Key(const char* nam, const char* namEnd, ULong ofs) : offset(ofs)
+{
+    size_t len = 0;
+    for(const unsigned char* c = (const unsigned char*) nam; c != (const unsigned char*) namEnd; )
+    {
+        // The ASCII characters are copied as they are.
+        if(*c < 0x80)
+        {
+            if(len == NAME_LENGTH)
+                break;
+
+            name[len++] = *c++;
+            continue;
+        }
+
+        wchar_t code;
+        size_t size = decodeChar(c, (const unsigned char*) namEnd, code);
+        if(!appendChar(code, len))
             break;
 
-        if(lchar != rchar)
-            return false;
+        c += size;
     }
 
-    if(i < NAME_LENGTH)
+    memset(name + len, 0, NAME_LENGTH - len);
+}
+
+bool Indexer::Key::appendChar(wchar_t code, size_t& len)
+{
+    ULong cp = (ULong) code;
+    size_t size = cp < 0x80 ? 1 : cp < 0x800 ? 2 : cp < 0x10000 ? 3 : 4;
+    if(len + size > NAME_LENGTH)
+        return false;
+
+    if(size == 1)
     {
-        wchar_t lchar = lhv[i];
-        wchar_t rchar = rhv[i];
-        if(lchar != rchar)
-            return false;
+        name[len++] = (char) cp;
+        return true;
     }
 
+    // The leading byte has as many high bits set as the sequence has bytes.
+    static const unsigned char LEADS[] = { 0, 0, 0xC0, 0xE0, 0xF0 };
+    name[len] = (char) (LEADS[size] | (cp >> (6 * (size - 1))));
+    for(size_t i = 1; i < size; ++i)
+        name[len + i] = (char) (0x80 | ((cp >> (6 * (size - 1 - i))) & 0x3F));
+
+    len += size;
     return true;
 }
 
-std::string Indexer::NameKeyPrinter::print(const Byte* key, UInt sz)
+bool Indexer::NameComparator::compare(const Byte* lhv, const Byte* rhv, UInt sz)
 {
-    std::string result;
+    if(lhv == nullptr)
+        throw std::invalid_argument("lhv was nullptr");
 
-    for (int i = 0; i < NAME_LENGTH; i += 2)
-    {
-        if (key[i] == 0)
-            break;
+    if(rhv == nullptr)
+        throw std::invalid_argument("rhv was nullptr");
 
-        result += std::string(1, *((char*) &key[i]));
-    }
+    // The names are padded by zeros, so the shorter name is less than the longer one starting with it.
+    return memcmp(lhv, rhv, NAME_LENGTH) < 0;
+}
 
-    return result;
+bool Indexer::NameComparator::isEqual(const Byte* lhv, const Byte* rhv, UInt sz)
+{
+    if(lhv == nullptr)
+        throw std::invalid_argument("lhv was nullptr");
+
+    if(rhv == nullptr)
+        throw std::invalid_argument("rhv was nullptr");
+
+    return memcmp(lhv, rhv, NAME_LENGTH) == 0;
+}
+
+std::string Indexer::NameKeyPrinter::print(const Byte* key, UInt sz)
+{
+    const char* name = (const char*) key;
+    return std::string(name, std::find(name, name + NAME_LENGTH, '\0'));
 }
 
 Indexer::~Indexer()
@@ -129,13 +196,23 @@ void Indexer::open(BaseBTree::TreeType treeType, const std::string& treeFileName
     _bt = new FileBaseBTree(treeType, treeFileName, &_comparator);
     _bt->getTree()->setKeyPrinter(&_keyPrinter);
 
+    if(_bt->getTree()->getRecSize() != sizeof(Key))
+    {
+        delete _bt;
+        _bt = nullptr;
+        throw std::invalid_argument("Stored keys size doesn't match the indexer's key size");
+    }
+
     lastFileName = "";
 }
 
 void Indexer::close()
 {
     if(_bt != nullptr)
+    {
         delete _bt;
+        _bt = nullptr;
+    }
 
     lastFileName = "";
 }
@@ -145,36 +222,131 @@ void Indexer::indexFile(const std::string& fileName)
     if(_bt == nullptr)
         throw std::logic_error("You should create or open B-tree firstly.\n");
 
-    std::wifstream file;
-    file.open(fileName, std::ios_base::binary);
+    FileBytes data(fileName);
 
-    if(!file.is_open())
-        throw std::logic_error("Cannot open file for indexing.\n");
+    for(const char* line = data.begin(); line != data.end(); )
+    {
+        const char* nameEnd;
+        const char* lineEnd = scanLine(line, data.end(), nameEnd);
 
-    std::wstring line;
+        Key key(line, nameEnd, line - data.begin());
 
-    ULong offset = file.tellg();
+        _bt->getTree()->insert((Byte*) &key);
 
-    while(std::getline(file, line))
+        line = lineEnd == data.end() ? lineEnd : lineEnd + 1;
+    }
+
+    lastFileName = fileName;
+}
+
+void Indexer::indexFile(const std::string& fileName, UInt threadsCount)
+{
+    if(_bt == nullptr)
+        throw std::logic_error("You should create or open B-tree firstly.\n");
+
+    FileBytes data(fileName);
+
+    if(threadsCount == 0)
+        threadsCount = std::max(std::thread::hardware_concurrency(), 1u);
+
+    // Each range ends after the line's end following its even share of the file.
+    std::vector<size_t> bounds(1, 0);
+    for(UInt i = 1; i < threadsCount; ++i)
     {
-        std::wstringstream sstream(line);
+        size_t bound = std::max(data.size() * i / threadsCount, bounds.back());
+        const char* lineEnd = (const char*) memchr(data.begin() + bound, '\n', data.size() - bound);
+        bounds.push_back(lineEnd == nullptr ? data.size() : lineEnd - data.begin() + 1);
+    }
 
-        std::wstring name;
-        std::getline(sstream, name, L';');
+    bounds.push_back(data.size());
 
-        Key key(name, offset);
+    std::vector<std::vector<Key> > runs(threadsCount);
+    std::vector<std::thread> threads;
+    for(UInt i = 0; i < threadsCount; ++i)
+        threads.push_back(std::thread([&data, &bounds, &runs, i]
+        {
+            parseLines(data.begin() + bounds[i], data.begin() + bounds[i + 1], bounds[i], runs[i]);
+            std::sort(runs[i].begin(), runs[i].end(), KeysOrder());
+        }));
 
-        _bt->getTree()->insert((Byte*) &key);
+    for(std::vector<std::thread>::iterator iter = threads.begin(); iter != threads.end(); ++iter)
+        iter->join();
 
-        offset = file.tellg();
+    std::vector<Key> keys;
+    std::vector<size_t> runsBounds(1, 0);
+    for(std::vector<std::vector<Key> >::iterator iter = runs.begin(); iter != runs.end(); ++iter)
+    {
+        keys.insert(keys.end(), iter->begin(), iter->end());
+        runsBounds.push_back(keys.size());
+        std::vector<Key>().swap(*iter);
     }
 
-    file.close();
+    // The neighbour runs are merged pairwise, the pairs of a round are merged in parallel.
+    while(runsBounds.size() > 2)
+    {
+        std::vector<size_t> mergedBounds;
+        threads.clear();
+        size_t i = 0;
+        for( ; i + 2 < runsBounds.size(); i += 2)
+        {
+            threads.push_back(std::thread([&keys, &runsBounds, i]
+            {
+                std::inplace_merge(keys.begin() + runsBounds[i], keys.begin() + runsBounds[i + 1],
+                        keys.begin() + runsBounds[i + 2], KeysOrder());
+            }));
+            mergedBounds.push_back(runsBounds[i]);
+        }
+
+        if(i + 1 < runsBounds.size())
+            mergedBounds.push_back(runsBounds[i]);
+
+        mergedBounds.push_back(keys.size());
+
+        for(std::vector<std::thread>::iterator iter = threads.begin(); iter != threads.end(); ++iter)
+            iter->join();
+
+        runsBounds.swap(mergedBounds);
+    }
+
+    BaseBTree* tree = _bt->getTree();
+    const BaseBTree::PageWrapper& root = tree->getRootPage();
+    if(root.isLeaf() && root.getKeysNum() == 0)
+    {
+        BulkLoader loader(tree, keys.size());
+        for(std::vector<Key>::const_iterator iter = keys.begin(); iter != keys.end(); ++iter)
+            loader.add((const Byte*) &*iter);
+
+        loader.finish();
+    }
+    else
+    {
+        for(std::vector<Key>::const_iterator iter = keys.begin(); iter != keys.end(); ++iter)
+            tree->insert((const Byte*) &*iter);
+    }
 
     lastFileName = fileName;
 }
 
 std::list<std::wstring> Indexer::findAllOccurrences(const std::wstring& name, const std::string& fileName)
+{
+    Occurrences occurrences;
+    findAllOccurrences(name, fileName, occurrences);
+
+    std::list<std::wstring> occurrencesStrings;
+    std::vector<wchar_t> chars;
+
+    for(size_t i = 0; i < occurrences.size(); ++i)
+    {
+        const char* line = occurrences.getLine(i);
+        chars.resize(occurrences.getLineLength(i));
+        size_t len = decodeName(line, line + chars.size(), chars.data(), chars.size());
+        occurrencesStrings.push_back(std::wstring(chars.data(), len));
+    }
+
+    return occurrencesStrings;
+}
+
+void Indexer::findAllOccurrences(const std::wstring& name, const std::string& fileName, Occurrences& occurrences)
 {
     if(_bt == nullptr)
         throw std::logic_error("You should create or open B-tree firstly.\n");
@@ -182,32 +354,97 @@ std::list<std::wstring> Indexer::findAllOccurrences(const std::wstring& name, co
     if(fileName != lastFileName)
         throw std::logic_error("You should index the file firstly.\n");
 
-    std::wifstream file(fileName);
-
-    if(!file.is_open())
-        throw std::logic_error("Cannot open file for indexing.\n");
+    FileBytes data(fileName);
 
     Key nameKey(name);
-    std::list<Byte*> occurrences;
-    _bt->getTree()->searchAll((Byte*) &nameKey, occurrences);
+    OffsetsCollector collector;
+    _bt->getTree()->searchAll((Byte*) &nameKey, collector);
 
-    std::list<std::wstring> occurrencesStrings;
+    // The lines are read in the file's order instead of the tree's one, which is random for the file.
+    std::sort(collector.offsets.begin(), collector.offsets.end());
 
-    for(std::list<Byte*>::iterator iter = occurrences.begin(); iter != occurrences.end(); ++iter)
+    occurrences.clear();
+    occurrences._linesBounds.reserve(collector.offsets.size() + 1);
+
+    for(std::vector<ULong>::iterator iter = collector.offsets.begin(); iter != collector.offsets.end(); ++iter)
     {
-        Key* occurrenceKey = (Key*) *iter;
+        if(*iter > data.size())
+            throw std::logic_error("The file was changed after indexing.\n");
 
-        file.seekg(occurrenceKey->offset, std::ios_base::beg);
-        std::wstring occurrenceString;
-        std::getline(file, occurrenceString);
-        occurrencesStrings.push_back(occurrenceString);
+        const char* line = data.begin() + *iter;
+        const char* nameEnd;
+        const char* lineEnd = scanLine(line, data.end(), nameEnd);
 
-        delete *iter;
+        occurrences._buffer.insert(occurrences._buffer.end(), line, lineEnd);
+        occurrences._linesBounds.push_back(occurrences._buffer.size());
     }
+}
 
-    file.close();
+bool Indexer::KeysOrder::operator()(const Key& lhv, const Key& rhv) const
+{
+    if(comparator.compare((const Byte*) &lhv, (const Byte*) &rhv, sizeof(Key)))
+        return true;
 
-    return occurrencesStrings;
+    if(comparator.compare((const Byte*) &rhv, (const Byte*) &lhv, sizeof(Key)))
+        return false;
+
+    return lhv.offset < rhv.offset;
+}
+
+void Indexer::parseLines(const char* begin, const char* end, ULong offset, std::vector<Key>& keys)
+{
+    for(const char* line = begin; line != end; )
+    {
+        const char* nameEnd;
+        const char* lineEnd = scanLine(line, end, nameEnd);
+
+        keys.push_back(Key(line, nameEnd, offset + (line - begin)));
+
+        line = lineEnd == end ? end : lineEnd + 1;
+    }
+}
+
+const char* Indexer::scanLine(const char* line, const char* end, const char*& nameEnd)
+{
+    // memchr is vectorized by the C library, so the bytes are scanned by words instead of one by one.
+    const char* lineEnd = (const char*) memchr(line, '\n', end - line);
+    if(lineEnd == nullptr)
+        lineEnd = end;
+
+    nameEnd = (const char*) memchr(line, ';', lineEnd - line);
+    if(nameEnd == nullptr)
+        nameEnd = lineEnd;
+
+    return lineEnd;
+}
+
+size_t Indexer::decodeName(const char* begin, const char* end, wchar_t* chars, size_t maxLength)
+{
+    size_t len = 0;
+
+    for(const unsigned char* c = (const unsigned char*) begin; c != (const unsigned char*) end && len < maxLength; )
+        c += decodeChar(c, (const unsigned char*) end, chars[len++]);
+
+    return len;
+}
+
+size_t Indexer::decodeChar(const unsigned char* c, const unsigned char* end, wchar_t& code)
+{
+    // The length of the sequence is given by the leading byte's high bits.
+    size_t length = *c < 0x80 ? 1 : (*c & 0xE0) == 0xC0 ? 2 : (*c & 0xF0) == 0xE0 ? 3 : (*c & 0xF8) == 0xF0 ? 4 : 0;
+    code = length == 1 ? *c : length == 2 ? *c & 0x1F : length == 3 ? *c & 0x0F : *c & 0x07;
+
+    size_t i = 1;
+    for( ; i < length && c + i != end && (c[i] & 0xC0) == 0x80; ++i)
+        code = (code << 6) | (c[i] & 0x3F);
+
+    if(length == 0 || i < length)
+    {
+        code = *c;
+        return 1;
+    }
+
+    return length;
 }
 
 std::string Indexer::getLine(std::ifstream& file)
@@ -15,6 +15,7 @@
 #include <cstring>
 #include <fstream>
 #include <sstream>
+#include <vector>
 #include <wchar.h>
 
 #include "btree.h"
@@ -29,15 +30,20 @@ class Indexer
 
 public:
 
-    /** \brief The max length of the stored name. */
+    /** \brief The max length of the stored name in UTF-8 bytes. */
     static const int NAME_LENGTH = 42;
 
 #pragma pack(push, 1)
-    /** \brief Represents the key for storing and searching. */
+    /** \brief Represents the key for storing and searching.
+     *
+     *  The name is stored in UTF-8 padded by zeros, so the keys are ordered by the names' code points
+     *  comparing their bytes, and the key takes 50 bytes instead of 42 wide characters.
+     *  The longer names are cut at the character's boundary.
+     */
     struct Key
     {
         /** \brief Default constructor. */
-        Key() : name(L""), offset(0) { }
+        Key() : name(), offset(0) { }
 
         /** \brief Constructor.
          *
@@ -53,11 +59,30 @@ public:
          */
         Key(const std::wstring& nam, ULong ofs) : Key(nam) { offset = ofs; }
 
+        /** \brief Constructor.
+         *
+         * The name's bytes are copied to the key, the invalid UTF-8 bytes are taken as the characters' codes,
+         * so the key is the same as the one constructed from the name decoded by decodeName().
+         * \param nam The first byte of the name in UTF-8.
+         * \param namEnd The byte following the name's last one.
+         * \param ofs The offset of record from the file's begin.
+         */
+        Key(const char* nam, const char* namEnd, ULong ofs);
+
         /** \brief The name for storing and searching. */
-        wchar_t name[NAME_LENGTH];
+        char name[NAME_LENGTH];
 
         /** \brief The offset of record from the file's begin. */
         ULong offset;
+
+    private:
+
+        /** \brief Appends the character \c code in UTF-8 to the first \c len bytes of the name.
+         *
+         *  \returns false if the name has no place for the character.
+         */
+        bool appendChar(wchar_t code, size_t& len);
+
     }; // struct Key
 #pragma pack(pop)
 
@@ -90,6 +115,45 @@ struct NameKeyPrinter : public BaseBTree::IKeyPrinter {
 
 }; // struct NameKeyPrinter
 
+    /** \brief Collects the offsets of the found keys without copying the keys. */
+    struct OffsetsCollector : public BaseBTree::IKeyVisitor {
+
+        virtual void visit(const Byte* key) override { offsets.push_back(((const Key*) key)->offset); }
+
+        /** \brief The found keys' offsets. */
+        std::vector<ULong> offsets;
+
+    }; // struct OffsetsCollector
+
+    /** \brief The lines of the found records in the file's order, stored one by one in a single buffer. */
+    class Occurrences {
+
+        friend class Indexer;
+
+    public:
+
+        /** \brief Returns the lines count. */
+        size_t size() const { return _linesBounds.size() - 1; }
+
+        /** \brief Returns the first byte of the line number \c num. The line is not null-terminated. */
+        const char* getLine(size_t num) const { return _buffer.data() + _linesBounds[num]; }
+
+        /** \brief Returns the bytes count of the line number \c num without its '\\n'. */
+        size_t getLineLength(size_t num) const { return _linesBounds[num + 1] - _linesBounds[num]; }
+
+        /** \brief Removes all the lines. */
+        void clear() { _buffer.clear(); _linesBounds.assign(1, 0); }
+
+    protected:
+
+        /** \brief The lines' bytes. */
+        std::vector<char> _buffer;
+
+        /** \brief The line number i is [_linesBounds[i], _linesBounds[i + 1]) of the buffer. */
+        std::vector<size_t> _linesBounds = std::vector<size_t>(1, 0);
+
+    }; // class Occurrences
+
 public:
 
     /** \brief Destructor.
@@ -112,6 +176,7 @@ public:
     /** \brief Opens the stored B-tree.
      *
      *  \param treeFileName Name of the file where the tree is stored.
+     *  \throws std::invalid_argument If the stored keys' size differs from the size of Key.
      */
     void open(BaseBTree::TreeType treeType, const std::string& treeFileName);
 
@@ -122,12 +187,26 @@ public:
 
     /** \brief Performs indexing of the file: all the file's records are being stored in the B-tree during this process.
      *
+     *  The file is mapped to the memory (or read into it where the mapping is not supported) and scanned
+     *  byte by byte, the names are decoded from UTF-8.
      *  \param fileName Name of the file for indexing.
      *  \throws std::logic_error If the B-tree was not created or opened yet.
      *  \throws Other exception if some special problem during reading the file appeared.
      */
     void indexFile(const std::string& fileName);
 
+    /** \brief Performs indexing of the file by \c threadsCount threads.
+     *
+     *  The file is split into the byte ranges at the lines' ends. The threads parse the names and the offsets
+     *  of their ranges and sort them, the sorted runs are merged pairwise in parallel and loaded into the empty
+     *  tree bottom-up by BulkLoader (or inserted one by one into the non-empty one). The names are decoded
+     *  from UTF-8.
+     *  \param fileName Name of the file for indexing.
+     *  \param threadsCount The threads count, 0 for the count of the hardware threads.
+     *  \throws std::logic_error If the B-tree was not created or opened yet.
+     */
+    void indexFile(const std::string& fileName, UInt threadsCount);
+
     /** \brief Finds all the occurrences of the given name in the given file using the B-tree.
      *
      *  File should be indexed firstly.
@@ -139,6 +218,18 @@ public:
      */
     std::list<std::wstring> findAllOccurrences(const std::wstring& name, const std::string& fileName);
 
+    /** \brief Finds all the occurrences of the given name in the given file using the B-tree
+     *  and replaces the lines of \c occurrences by their lines.
+     *
+     *  The found offsets are sorted, so the file (mapped to the memory where it is supported) is read
+     *  in one sequential pass, and the lines are stored in the file's order.
+     *  \param name Name for searching its occurrences.
+     *  \param fileName Name of the file which records are being found.
+     *  \param occurrences The found lines.
+     *  \throws std::logic_error If the B-tree was not created or opened or given file was not indexed yet.
+     */
+    void findAllOccurrences(const std::wstring& name, const std::string& fileName, Occurrences& occurrences);
+
     /** \brief Returns tree's max depth reached during searching process.
      *
      *  \returns Tree's max depth reached during searching process.
@@ -149,10 +240,50 @@ public:
 
     void resetDiskOperationsCount() { if (_bt != nullptr) _bt->getTree()->resetDiskOperationsCount(); }
 
+    UInt getBufferPoolHitsCount() { return _bt != nullptr ? _bt->getTree()->getBufferPoolHitsCount() : 0; }
+
+    UInt getBufferPoolMissesCount() { return _bt != nullptr ? _bt->getTree()->getBufferPoolMissesCount() : 0; }
+
+    void resetBufferPoolCounters() { if (_bt != nullptr) _bt->getTree()->resetBufferPoolCounters(); }
+
     FileBaseBTree* getTree() const { return _bt; }
 
 private:
 
+    /** \brief The order of the keys by their names and then by their offsets. */
+    struct KeysOrder
+    {
+        bool operator()(const Key& lhv, const Key& rhv) const;
+
+        /** \brief The comparator of the names. */
+        mutable NameComparator comparator;
+    }; // struct KeysOrder
+
+    /** \brief Parses the lines of the file's part [begin, end) starting at the offset \c offset
+     *  and appends their keys to \c keys.
+     */
+    static void parseLines(const char* begin, const char* end, ULong offset, std::vector<Key>& keys);
+
+    /** \brief Finds the end of the line starting at \c line in the file's part ending at \c end.
+     *
+     *  \param nameEnd Is set to the end of the line's name, which is followed by ';' or ends the line.
+     *  \returns The line's '\\n' or \c end if the line is the last one.
+     */
+    static const char* scanLine(const char* line, const char* end, const char*& nameEnd);
+
+    /** \brief Decodes at most \c maxLength characters of the UTF-8 name [begin, end) to \c chars,
+     *  the invalid bytes are taken as the characters' codes.
+     *
+     *  \returns The decoded characters count.
+     */
+    static size_t decodeName(const char* begin, const char* end, wchar_t* chars, size_t maxLength);
+
+    /** \brief Decodes the UTF-8 character at \c c, the invalid byte is taken as the character's code.
+     *
+     *  \returns The decoded bytes count.
+     */
+    static size_t decodeChar(const unsigned char* c, const unsigned char* end, wchar_t& code);
+
     /** \brief  Reads line from the file.
      *
      * \param   file The file.
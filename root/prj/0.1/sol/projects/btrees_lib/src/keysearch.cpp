@@ -0,0 +1,307 @@
+/// \file
+/// \brief     Search kernels for the nodes with the integer keys.
+/// \authors   Anton Rigin
+/// \version   0.1.0
+/// \date      16.10.2026
+///
+////////////////////////////////////////////////////////////////////////////////
+
+#include "keysearch.h"
+
+#include <cstring>          // memcpy
+
+#ifdef BTREE_WITH_SIMD
+
+#include <immintrin.h>
+
+#endif
+
+namespace btree {
+
+//==============================================================================
+// Scalar search
+//==============================================================================
+
+/** \brief Returns the key number \c num of the keys array \c keys. */
+template <typename Int>
+static Int loadKey(const Byte* keys, UShort num)
+{
+    Int key;
+    memcpy(&key, keys + (size_t)num * sizeof(Int), sizeof(Int));
+    return key;
+}
+
+/** \brief Narrows the range [first, last) containing the bound of \c key by the binary search
+ *  until it is short enough to be scanned.
+ *
+ *  The bound is the lower one if \c upper is false, otherwise it is the upper one.
+ */
+template <typename Int>
+static void narrowRange(const Byte* keys, UShort& first, UShort& last, Int key, bool upper)
+{
+    while (last - first > SIMD_SEARCH_RANGE)
+    {
+        UShort middle = first + (last - first) / 2;
+        Int middleKey = loadKey<Int>(keys, middle);
+        if (upper ? !(key < middleKey) : middleKey < key)
+            first = middle + 1;
+        else
+            last = middle;
+    }
+}
+
+/** \brief Returns the bound of \c key in the range [first, last) scanning it key by key. */
+template <typename Int>
+static UShort scanScalar(const Byte* keys, UShort first, UShort last, Int key, bool upper)
+{
+    for ( ; first < last; ++first)
+    {
+        Int currentKey = loadKey<Int>(keys, first);
+        if (upper ? key < currentKey : !(currentKey < key))
+            break;
+    }
+
+    return first;
+}
+
+//==============================================================================
+// Vector search
+//==============================================================================
+
+#ifdef BTREE_WITH_SIMD
+
+// Each scan compares a block of keys with the searched one and gets the mask of the keys before the bound.
+// As the keys are sorted, the mask is a prefix, so its bits count moves the range's begin
+// and the scan stops at the first block which is not passed entirely.
+
+__attribute__((target("avx2")))
+static UShort scanInt32Avx2(const Byte* keys, UShort first, UShort last, std::int32_t key, bool upper)
+{
+    const __m256i k = _mm256_set1_epi32(key);
+
+    while (last - first >= 16)
+    {
+        const __m256i* block = (const __m256i*)(keys + (size_t)first * sizeof(std::int32_t));
+        __m256i a = _mm256_loadu_si256(block);
+        __m256i b = _mm256_loadu_si256(block + 1);
+
+        // For the lower bound the keys less than the searched one are counted,
+        // for the upper bound the keys not greater than it.
+        __m256i ma = upper ? _mm256_cmpgt_epi32(a, k) : _mm256_cmpgt_epi32(k, a);
+        __m256i mb = upper ? _mm256_cmpgt_epi32(b, k) : _mm256_cmpgt_epi32(k, b);
+
+        UInt mask = (UInt)_mm256_movemask_ps(_mm256_castsi256_ps(ma))
+                | ((UInt)_mm256_movemask_ps(_mm256_castsi256_ps(mb)) << 8);
+        if (upper)
+            mask = ~mask & 0xFFFF;
+
+        UInt count = __builtin_popcount(mask);
+        first += count;
+        if (count < 16)
+            return first;
+    }
+
+    return scanScalar<std::int32_t>(keys, first, last, key, upper);
+}
+
+__attribute__((target("sse2")))
+static UShort scanInt32Sse(const Byte* keys, UShort first, UShort last, std::int32_t key, bool upper)
+{
+    const __m128i k = _mm_set1_epi32(key);
+
+    while (last - first >= 8)
+    {
+        const __m128i* block = (const __m128i*)(keys + (size_t)first * sizeof(std::int32_t));
+        __m128i a = _mm_loadu_si128(block);
+        __m128i b = _mm_loadu_si128(block + 1);
+
+        __m128i ma = upper ? _mm_cmpgt_epi32(a, k) : _mm_cmpgt_epi32(k, a);
+        __m128i mb = upper ? _mm_cmpgt_epi32(b, k) : _mm_cmpgt_epi32(k, b);
+
+        UInt mask = (UInt)_mm_movemask_ps(_mm_castsi128_ps(ma))
+                | ((UInt)_mm_movemask_ps(_mm_castsi128_ps(mb)) << 4);
+        if (upper)
+            mask = ~mask & 0xFF;
+
+        UInt count = __builtin_popcount(mask);
+        first += count;
+        if (count < 8)
+            return first;
+    }
+
+    return scanScalar<std::int32_t>(keys, first, last, key, upper);
+}
+
+__attribute__((target("avx2")))
+static UShort scanInt64Avx2(const Byte* keys, UShort first, UShort last, std::int64_t key, bool upper)
+{
+    const __m256i k = _mm256_set1_epi64x(key);
+
+    while (last - first >= 8)
+    {
+        const __m256i* block = (const __m256i*)(keys + (size_t)first * sizeof(std::int64_t));
+        __m256i a = _mm256_loadu_si256(block);
+        __m256i b = _mm256_loadu_si256(block + 1);
+
+        __m256i ma = upper ? _mm256_cmpgt_epi64(a, k) : _mm256_cmpgt_epi64(k, a);
+        __m256i mb = upper ? _mm256_cmpgt_epi64(b, k) : _mm256_cmpgt_epi64(k, b);
+
+        UInt mask = (UInt)_mm256_movemask_pd(_mm256_castsi256_pd(ma))
+                | ((UInt)_mm256_movemask_pd(_mm256_castsi256_pd(mb)) << 4);
+        if (upper)
+            mask = ~mask & 0xFF;
+
+        UInt count = __builtin_popcount(mask);
+        first += count;
+        if (count < 8)
+            return first;
+    }
+
+    return scanScalar<std::int64_t>(keys, first, last, key, upper);
+}
+
+__attribute__((target("sse4.2")))
+static UShort scanInt64Sse(const Byte* keys, UShort first, UShort last, std::int64_t key, bool upper)
+{
+    const __m128i k = _mm_set1_epi64x(key);
+
+    while (last - first >= 4)
+    {
+        const __m128i* block = (const __m128i*)(keys + (size_t)first * sizeof(std::int64_t));
+        __m128i a = _mm_loadu_si128(block);
+        __m128i b = _mm_loadu_si128(block + 1);
+
+        __m128i ma = upper ? _mm_cmpgt_epi64(a, k) : _mm_cmpgt_epi64(k, a);
+        __m128i mb = upper ? _mm_cmpgt_epi64(b, k) : _mm_cmpgt_epi64(k, b);
+
+        UInt mask = (UInt)_mm_movemask_pd(_mm_castsi128_pd(ma))
+                | ((UInt)_mm_movemask_pd(_mm_castsi128_pd(mb)) << 2);
+        if (upper)
+            mask = ~mask & 0xF;
+
+        UInt count = __builtin_popcount(mask);
+        first += count;
+        if (count < 4)
+            return first;
+    }
+
+    return scanScalar<std::int64_t>(keys, first, last, key, upper);
+}
+
+#endif // BTREE_WITH_SIMD
+
+//==============================================================================
+// Kernel selection
+//==============================================================================
+
+/** \brief Returns the best kernel supported by the processor. */
+static KeySearchKernel getBestKeySearchKernel()
+{
+
+#ifdef BTREE_WITH_SIMD
+
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        return AVX2_KERNEL;
+
+    if (__builtin_cpu_supports("sse4.2"))
+        return SSE_KERNEL;
+
+#endif
+
+    return SCALAR_KERNEL;
+}
+
+/** \brief Returns the current kernel, which is the best supported one at first. */
+static KeySearchKernel& currentKeySearchKernel()
+{
+    static KeySearchKernel kernel = getBestKeySearchKernel();
+    return kernel;
+}
+
+KeySearchKernel getKeySearchKernel()
+{
+    return currentKeySearchKernel();
+}
+
+KeySearchKernel setKeySearchKernel(KeySearchKernel kernel)
+{
+    KeySearchKernel bestKernel = getBestKeySearchKernel();
+    if (kernel > bestKernel)
+        kernel = bestKernel;
+
+    currentKeySearchKernel() = kernel;
+    return kernel;
+}
+
+/** \brief Returns the lower (if \c upper is false) or upper bound of \c key among the 32-bit keys. */
+static UShort searchInt32(const Byte* keys, UShort num, std::int32_t key, bool upper)
+{
+    UShort first = 0;
+    UShort last = num;
+    narrowRange<std::int32_t>(keys, first, last, key, upper);
+
+    switch (currentKeySearchKernel())
+    {
+
+#ifdef BTREE_WITH_SIMD
+
+    case AVX2_KERNEL:
+        return scanInt32Avx2(keys, first, last, key, upper);
+
+    case SSE_KERNEL:
+        return scanInt32Sse(keys, first, last, key, upper);
+
+#endif
+
+    default:
+        return scanScalar<std::int32_t>(keys, first, last, key, upper);
+    }
+}
+
+/** \brief Returns the lower (if \c upper is false) or upper bound of \c key among the 64-bit keys. */
+static UShort searchInt64(const Byte* keys, UShort num, std::int64_t key, bool upper)
+{
+    UShort first = 0;
+    UShort last = num;
+    narrowRange<std::int64_t>(keys, first, last, key, upper);
+
+    switch (currentKeySearchKernel())
+    {
+
+#ifdef BTREE_WITH_SIMD
+
+    case AVX2_KERNEL:
+        return scanInt64Avx2(keys, first, last, key, upper);
+
+    case SSE_KERNEL:
+        return scanInt64Sse(keys, first, last, key, upper);
+
+#endif
+
+    default:
+        return scanScalar<std::int64_t>(keys, first, last, key, upper);
+    }
+}
+
+UShort lowerBoundInt32(const Byte* keys, UShort num, std::int32_t key)
+{
+    return searchInt32(keys, num, key, false);
+}
+
+UShort upperBoundInt32(const Byte* keys, UShort num, std::int32_t key)
+{
+    return searchInt32(keys, num, key, true);
+}
+
+UShort lowerBoundInt64(const Byte* keys, UShort num, std::int64_t key)
+{
+    return searchInt64(keys, num, key, false);
+}
+
+UShort upperBoundInt64(const Byte* keys, UShort num, std::int64_t key)
+{
+    return searchInt64(keys, num, key, true);
+}
+
+} // namespace btree
@@ -0,0 +1,67 @@
+/// \file
+/// \brief     Search kernels for the nodes with the integer keys.
+/// \authors   Anton Rigin
+/// \version   0.1.0
+/// \date      16.10.2026
+///
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef BTREE_KEYSEARCH_H_
+#define BTREE_KEYSEARCH_H_
+
+#include <cstdint>
+
+#include "utils.h"
+
+namespace btree {
+
+/** \brief The implementation of the integer keys search. */
+enum KeySearchKernel {
+
+    /** \brief Plain C++ comparisons. */
+    SCALAR_KERNEL,
+
+    /** \brief 128-bit vectors: SSE2 for the 32-bit keys, SSE4.2 for the 64-bit ones. */
+    SSE_KERNEL,
+
+    /** \brief 256-bit AVX2 vectors. */
+    AVX2_KERNEL
+};
+
+/** \brief Keys range length down to which the binary search narrows the range before it is scanned
+ *  by the vectors.
+ */
+const UShort SIMD_SEARCH_RANGE = 32;
+
+/** \brief Returns the kernel used by the integer keys search.
+ *
+ *  By default it is the best kernel supported by the processor.
+ */
+KeySearchKernel getKeySearchKernel();
+
+/** \brief Sets the kernel used by the integer keys search.
+ *
+ *  If the processor doesn't support \c kernel, the best supported one is used.
+ *  \returns The kernel which is used.
+ */
+KeySearchKernel setKeySearchKernel(KeySearchKernel kernel);
+
+/** \brief Returns the number of the first key not less than \c key among \c num sorted 32-bit keys
+ *  stored contiguously and possibly unaligned at \c keys, or \c num if there is no such a key.
+ */
+UShort lowerBoundInt32(const Byte* keys, UShort num, std::int32_t key);
+
+/** \brief Returns the number of the first key greater than \c key among \c num sorted 32-bit keys
+ *  or \c num if there is no such a key.
+ */
+UShort upperBoundInt32(const Byte* keys, UShort num, std::int32_t key);
+
+/** \brief The same as lowerBoundInt32() for the 64-bit keys. */
+UShort lowerBoundInt64(const Byte* keys, UShort num, std::int64_t key);
+
+/** \brief The same as upperBoundInt32() for the 64-bit keys. */
+UShort upperBoundInt64(const Byte* keys, UShort num, std::int64_t key);
+
+} // namespace btree
+
+#endif // BTREE_KEYSEARCH_H_
@@ -0,0 +1,185 @@
+/// \file
+/// \brief     Latch shared by the readers and taken exclusively by the writers.
+/// \authors   Anton Rigin
+/// \version   0.1.0
+/// \date      16.10.2026
+///
+////////////////////////////////////////////////////////////////////////////////
+
+#include "latch.h"
+
+#include <stdexcept>        // std::invalid_argument
+#include <thread>           // std::this_thread::yield
+
+namespace btree {
+
+//==============================================================================
+// class SharedLatch
+//==============================================================================
+
+SharedLatch::SharedLatch()
+    : _readersCount(0)
+    , _waitingWritersCount(0)
+    , _isWriting(false)
+{
+}
+
+void SharedLatch::lock()
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    ++_waitingWritersCount;
+    _writersGate.wait(lock, [this] { return !_isWriting && _readersCount == 0; });
+    --_waitingWritersCount;
+
+    _isWriting = true;
+}
+
+void SharedLatch::unlock()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    _isWriting = false;
+
+    // The readers enter only when there are no more waiting writers.
+    if (_waitingWritersCount > 0)
+        _writersGate.notify_one();
+    else
+        _readersGate.notify_all();
+}
+
+void SharedLatch::lockShared()
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    _readersGate.wait(lock, [this] { return !_isWriting && _waitingWritersCount == 0; });
+    ++_readersCount;
+}
+
+void SharedLatch::unlockShared()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    --_readersCount;
+    if (_readersCount == 0 && _waitingWritersCount > 0)
+        _writersGate.notify_one();
+}
+
+//==============================================================================
+// class PageLatchTable
+//==============================================================================
+
+PageLatchTable::~PageLatchTable()
+{
+    for (std::unordered_map<UInt, Entry*>::iterator iter = _entries.begin(); iter != _entries.end(); ++iter)
+        delete iter->second;
+
+    for (std::vector<Entry*>::iterator iter = _freeEntries.begin(); iter != _freeEntries.end(); ++iter)
+        delete *iter;
+}
+
+void PageLatchTable::lock(UInt pnum)
+{
+    acquire(pnum).lock();
+}
+
+void PageLatchTable::unlock(UInt pnum)
+{
+    find(pnum).unlock();
+    release(pnum);
+}
+
+void PageLatchTable::lockShared(UInt pnum)
+{
+    acquire(pnum).lockShared();
+}
+
+void PageLatchTable::unlockShared(UInt pnum)
+{
+    find(pnum).unlockShared();
+    release(pnum);
+}
+
+UInt PageLatchTable::getLatchesCount()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    return (UInt)_entries.size();
+}
+
+SharedLatch& PageLatchTable::acquire(UInt pnum)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    Entry*& entry = _entries[pnum];
+    if (entry == nullptr)
+    {
+        if (_freeEntries.empty())
+            entry = new Entry();
+        else
+        {
+            entry = _freeEntries.back();
+            _freeEntries.pop_back();
+        }
+    }
+
+    ++entry->usersCount;
+
+    return entry->latch;
+}
+
+SharedLatch& PageLatchTable::find(UInt pnum)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    std::unordered_map<UInt, Entry*>::iterator found = _entries.find(pnum);
+    if (found == _entries.end())
+        throw std::invalid_argument("Page latch is not held");
+
+    return found->second->latch;
+}
+
+void PageLatchTable::release(UInt pnum)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    std::unordered_map<UInt, Entry*>::iterator found = _entries.find(pnum);
+    if (--found->second->usersCount != 0)
+        return;
+
+    if (_freeEntries.size() < MAX_FREE_ENTRIES)
+        _freeEntries.push_back(found->second);
+    else
+        delete found->second;
+
+    _entries.erase(found);
+}
+
+//==============================================================================
+// class PageVersionTable
+//==============================================================================
+
+PageVersionTable::PageVersionTable()
+    : _slots(new Slot[SLOTS_COUNT])
+{
+}
+
+PageVersionTable::~PageVersionTable()
+{
+    delete[] _slots;
+}
+
+ULong PageVersionTable::readVersion(UInt pnum) const
+{
+    // The writers hold the versions locked while they write the pages, which is short.
+    for ( ; ; )
+    {
+        ULong version = getSlot(pnum).load();
+        if ((version & LOCKS_MASK) == 0)
+            return version;
+
+        std::this_thread::yield();
+    }
+}
+
+} // namespace btree
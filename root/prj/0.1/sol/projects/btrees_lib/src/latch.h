@@ -0,0 +1,285 @@
+/// \file
+/// \brief     Latch shared by the readers and taken exclusively by the writers.
+/// \authors   Anton Rigin
+/// \version   0.1.0
+/// \date      16.10.2026
+///
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef BTREE_LATCH_H_
+#define BTREE_LATCH_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "utils.h"
+
+namespace btree {
+
+/** \brief Reader/writer latch: any count of the readers or one writer hold it at a time.
+ *
+ *  The waiting writer stops letting the new readers in, so the writers are not starved by a stream of readers.
+ *  Therefore the latch is not recursive: the thread holding it shared should not take it again.
+ */
+class SharedLatch {
+public:
+
+    SharedLatch();
+
+protected:
+
+    SharedLatch(const SharedLatch&);
+
+    SharedLatch& operator= (SharedLatch&);
+
+public:
+
+    /** \brief Takes the latch exclusively, waiting for the holders to leave. */
+    void lock();
+
+    /** \brief Releases the exclusively taken latch. */
+    void unlock();
+
+    /** \brief Takes the latch shared, waiting for the writer (the holding or the waiting one) to leave. */
+    void lockShared();
+
+    /** \brief Releases the shared latch. */
+    void unlockShared();
+
+protected:
+
+    /** \brief Guards the counters. */
+    std::mutex _mutex;
+
+    /** \brief Signaled when the readers can enter. */
+    std::condition_variable _readersGate;
+
+    /** \brief Signaled when a writer can enter. */
+    std::condition_variable _writersGate;
+
+    /** \brief The count of the readers holding the latch. */
+    UInt _readersCount;
+
+    /** \brief The count of the writers waiting for the latch. */
+    UInt _waitingWritersCount;
+
+    /** \brief True if a writer holds the latch. */
+    bool _isWriting;
+
+}; // class SharedLatch
+
+/** \brief Holds the latch shared until the end of the scope, if \c isLocking is true. */
+class SharedLock {
+public:
+
+    SharedLock(SharedLatch& latch, bool isLocking = true)
+        : _latch(latch)
+        , _isLocking(isLocking)
+    {
+        if (_isLocking)
+            _latch.lockShared();
+    }
+
+    ~SharedLock()
+    {
+        if (_isLocking)
+            _latch.unlockShared();
+    }
+
+protected:
+
+    SharedLock(const SharedLock&);
+
+    SharedLock& operator= (SharedLock&);
+
+protected:
+
+    /** \brief The latch. */
+    SharedLatch& _latch;
+
+    /** \brief True if the latch is held. */
+    bool _isLocking;
+
+}; // class SharedLock
+
+/** \brief Holds the latch exclusively until the end of the scope, if \c isLocking is true. */
+class ExclusiveLock {
+public:
+
+    ExclusiveLock(SharedLatch& latch, bool isLocking = true)
+        : _latch(latch)
+        , _isLocking(isLocking)
+    {
+        if (_isLocking)
+            _latch.lock();
+    }
+
+    ~ExclusiveLock()
+    {
+        if (_isLocking)
+            _latch.unlock();
+    }
+
+protected:
+
+    ExclusiveLock(const ExclusiveLock&);
+
+    ExclusiveLock& operator= (ExclusiveLock&);
+
+protected:
+
+    /** \brief The latch. */
+    SharedLatch& _latch;
+
+    /** \brief True if the latch is held. */
+    bool _isLocking;
+
+}; // class ExclusiveLock
+
+/** \brief The latches of the pages identified by their numbers.
+ *
+ *  A page's latch exists while it is held or waited for, and the released latches are kept for reusing.
+ */
+class PageLatchTable {
+public:
+
+    PageLatchTable() { }
+
+    ~PageLatchTable();
+
+protected:
+
+    PageLatchTable(const PageLatchTable&);
+
+    PageLatchTable& operator= (PageLatchTable&);
+
+public:
+
+    /** \brief Takes the latch of the page \c pnum exclusively. */
+    void lock(UInt pnum);
+
+    /** \brief Releases the exclusively taken latch of the page \c pnum. */
+    void unlock(UInt pnum);
+
+    /** \brief Takes the latch of the page \c pnum shared. */
+    void lockShared(UInt pnum);
+
+    /** \brief Releases the shared latch of the page \c pnum. */
+    void unlockShared(UInt pnum);
+
+    /** \brief Returns the count of the pages whose latches are held or waited for. */
+    UInt getLatchesCount();
+
+protected:
+
+    /** \brief The page's latch and the count of its holders and waiters. */
+    struct Entry {
+
+        Entry() : usersCount(0) { }
+
+        SharedLatch latch;
+
+        UInt usersCount;
+
+    }; // struct Entry
+
+    /** \brief Returns the latch of the page \c pnum counting its new user. */
+    SharedLatch& acquire(UInt pnum);
+
+    /** \brief Returns the held latch of the page \c pnum. */
+    SharedLatch& find(UInt pnum);
+
+    /** \brief Uncounts the user of the latch of the page \c pnum, the unused latch is kept for reusing. */
+    void release(UInt pnum);
+
+protected:
+
+    /** \brief The max count of the kept unused latches. */
+    static const UInt MAX_FREE_ENTRIES = 64;
+
+    /** \brief Guards the map and the kept latches. */
+    std::mutex _mutex;
+
+    /** \brief The latches of the pages. */
+    std::unordered_map<UInt, Entry*> _entries;
+
+    /** \brief The unused latches kept for reusing. */
+    std::vector<Entry*> _freeEntries;
+
+}; // class PageLatchTable
+
+/** \brief The versions of the pages identified by their numbers, which let the readers take no latches.
+ *
+ *  The writer locks the page's version before it modifies the page and unlocks it when it releases the page,
+ *  which changes the version. The reader waits till the version is unlocked, reads the page and then checks
+ *  that the version is the same, otherwise the page could be modified while it was read.
+ *  The pages share SLOTS_COUNT counters by their numbers, so the table doesn't grow with the tree,
+ *  but a modification of a page can make the readers of another page read it again.
+ */
+class PageVersionTable {
+public:
+
+    PageVersionTable();
+
+    ~PageVersionTable();
+
+protected:
+
+    PageVersionTable(const PageVersionTable&);
+
+    PageVersionTable& operator= (PageVersionTable&);
+
+public:
+
+    /** \brief Waits till the version of the page \c pnum is unlocked and returns it. */
+    ULong readVersion(UInt pnum) const;
+
+    /** \brief Returns true if the version of the page \c pnum is still \c version. */
+    bool isValid(UInt pnum, ULong version) const { return getSlot(pnum).load() == version; }
+
+    /** \brief Locks the version of the page \c pnum, it can be locked by several writers of the slot. */
+    void lock(UInt pnum) { getSlot(pnum).fetch_add(1); }
+
+    /** \brief Unlocks the version of the page \c pnum and increments it. */
+    void unlock(UInt pnum) { getSlot(pnum).fetch_add(VERSION_UNIT - 1); }
+
+protected:
+
+    /** \brief Returns the counter of the page \c pnum. */
+    std::atomic<ULong>& getSlot(UInt pnum) const { return _slots[pnum % SLOTS_COUNT].value; }
+
+protected:
+
+    /** \brief The count of the counters. */
+    static const UInt SLOTS_COUNT = 1024;
+
+    /** \brief The counter's low bits count the writers which locked it, the rest is the version. */
+    static const ULong LOCKS_MASK = 0xFFFF;
+
+    /** \brief The counter's increment of the version. */
+    static const ULong VERSION_UNIT = LOCKS_MASK + 1;
+
+    /** \brief The counter padded to the cache line, so the readers of a slot don't share it with the writers
+     *  of the neighbour slots.
+     */
+    struct Slot {
+
+        Slot() : value(0) { }
+
+        std::atomic<ULong> value;
+
+        Byte padding[64 - sizeof(std::atomic<ULong>)];
+
+    }; // struct Slot
+
+    /** \brief The counters. */
+    Slot* _slots;
+
+}; // class PageVersionTable
+
+} // namespace btree
+
+#endif // BTREE_LATCH_H_
@@ -0,0 +1,183 @@
+/// \file
+/// \brief     Memory-mapped file used as the tree's storage.
+/// \authors   Anton Rigin
+/// \version   0.1.0
+/// \date      16.10.2026
+///
+////////////////////////////////////////////////////////////////////////////////
+
+#include "mappedfile.h"
+
+#ifdef BTREE_WITH_MMAP
+
+#include <stdexcept>        // std::runtime_error
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace btree {
+
+//==============================================================================
+// class MappedFile
+//==============================================================================
+
+MappedFile::MappedFile()
+    : _fd(-1),
+    _isReadOnly(false),
+    _data(nullptr),
+    _size(0)
+{
+}
+
+MappedFile::~MappedFile()
+{
+    if (isOpen())
+        close(_size);
+}
+
+void MappedFile::open(const std::string& fileName, bool truncate)
+{
+    int flags = O_RDWR;
+    if (truncate)
+        flags |= O_CREAT | O_TRUNC;
+
+    open(fileName, flags);
+}
+
+void MappedFile::openReadOnly(const std::string& fileName)
+{
+    open(fileName, O_RDONLY);
+
+    if (_data != nullptr)
+        madvise(_data, _size, MADV_SEQUENTIAL);
+}
+
+void MappedFile::open(const std::string& fileName, int flags)
+{
+    if (isOpen())
+        throw std::runtime_error("File is already open");
+
+    _isReadOnly = (flags & O_ACCMODE) == O_RDONLY;
+    _fd = ::open(fileName.c_str(), flags, 0644);
+    if (_fd == -1)
+        throw std::runtime_error("Can't open file for mapping");
+
+    struct stat st;
+    if (fstat(_fd, &st) == -1)
+    {
+        ::close(_fd);
+        _fd = -1;
+        throw std::runtime_error("Can't get file size");
+    }
+
+    _size = (ULong)st.st_size;
+
+    try {
+        map();
+    }
+    catch (...)
+    {
+        ::close(_fd);
+        _fd = -1;
+        _size = 0;
+        throw;
+    }
+}
+
+void MappedFile::close(ULong size)
+{
+    if (!isOpen())
+        return;
+
+    unmap();
+
+    // The file stays valid even if its tail is not cut, so the result is ignored.
+    if (size < _size)
+    {
+        int res = ftruncate(_fd, (off_t)size);
+        (void)res;
+    }
+
+    ::close(_fd);
+    _fd = -1;
+    _size = 0;
+}
+
+void MappedFile::resize(ULong size)
+{
+    if (!isOpen())
+        throw std::runtime_error("File is not open");
+
+    if (size == _size)
+        return;
+
+    if (ftruncate(_fd, (off_t)size) == -1)
+        throw std::runtime_error("Can't resize mapped file");
+
+#ifdef __linux__
+
+    if (_data != nullptr && size != 0)
+    {
+        void* data = mremap(_data, _size, size, MREMAP_MAYMOVE);
+        if (data == MAP_FAILED)
+            throw std::runtime_error("Can't remap file");
+
+        _data = (Byte*)data;
+        _size = size;
+        return;
+    }
+
+#endif
+
+    unmap();
+    _size = size;
+    map();
+}
+
+void MappedFile::reserve(ULong size)
+{
+    if (size <= _size)
+        return;
+
+    ULong newSize = _size * 2;
+    if (newSize < MIN_GROW_SIZE)
+        newSize = MIN_GROW_SIZE;
+    if (newSize < size)
+        newSize = size;
+
+    resize(newSize);
+}
+
+void MappedFile::sync()
+{
+    if (_data != nullptr && msync(_data, _size, MS_SYNC) == -1)
+        throw std::runtime_error("Can't sync mapped file");
+}
+
+void MappedFile::map()
+{
+    if (_size == 0)
+        return;
+
+    int prot = _isReadOnly ? PROT_READ : PROT_READ | PROT_WRITE;
+    void* data = mmap(nullptr, _size, prot, MAP_SHARED, _fd, 0);
+    if (data == MAP_FAILED)
+        throw std::runtime_error("Can't map file");
+
+    _data = (Byte*)data;
+}
+
+void MappedFile::unmap()
+{
+    if (_data == nullptr)
+        return;
+
+    munmap(_data, _size);
+    _data = nullptr;
+}
+
+} // namespace btree
+
+#endif // BTREE_WITH_MMAP
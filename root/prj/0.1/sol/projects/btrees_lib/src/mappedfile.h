@@ -0,0 +1,118 @@
+/// \file
+/// \brief     Memory-mapped file used as the tree's storage.
+/// \authors   Anton Rigin
+/// \version   0.1.0
+/// \date      16.10.2026
+///
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef BTREE_MAPPEDFILE_H_
+#define BTREE_MAPPEDFILE_H_
+
+#include <string>
+
+#include "utils.h"
+
+#ifdef BTREE_WITH_MMAP
+
+namespace btree {
+
+/** \brief The file mapped to the memory as a whole.
+ *
+ *  The mapping is shared, so the changes made through getData() go to the file.
+ *  The file grows by resize() using ftruncate() and remapping (mremap() where it is available),
+ *  so the mapping's address can change after resize(): pointers into the mapping
+ *  should not be held across it.
+ */
+class MappedFile {
+
+public:
+
+    /** \brief Min size the file grows to when the mapping is extended. */
+    static const ULong MIN_GROW_SIZE = 64 * 1024;
+
+public:
+
+    MappedFile();
+
+    /** \brief Destructor. Closes the file if it is opened. */
+    ~MappedFile();
+
+protected:
+
+    MappedFile(const MappedFile&);
+
+    MappedFile& operator= (MappedFile&);
+
+public:
+
+    /** \brief Opens the file with name \c fileName and maps it.
+     *
+     *  If \c truncate is true, the file is created or its content is dropped.
+     *  \throws std::runtime_error if the file can't be opened or mapped.
+     */
+    void open(const std::string& fileName, bool truncate);
+
+    /** \brief Opens the existing file with name \c fileName and maps it for reading only.
+     *
+     *  The mapping is advised to be read sequentially.
+     *  \throws std::runtime_error if the file can't be opened or mapped.
+     */
+    void openReadOnly(const std::string& fileName);
+
+    /** \brief Unmaps and closes the file, cutting it to the \c size bytes before if it is longer. */
+    void close(ULong size);
+
+    /** \brief Returns true if the file is opened. */
+    bool isOpen() const { return _fd != -1; }
+
+    /** \brief Returns the current file (and mapping) size. */
+    ULong getSize() const { return _size; }
+
+    /** \brief Returns the mapping's address or nullptr if the file is empty. */
+    Byte* getData() const { return _data; }
+
+    /** \brief Sets the file size to \c size bytes and remaps it.
+     *
+     *  \throws std::runtime_error if the file can't be resized or remapped.
+     */
+    void resize(ULong size);
+
+    /** \brief Makes the file at least \c size bytes long, growing it at least twice if necessary. */
+    void reserve(ULong size);
+
+    /** \brief Writes the mapping's changes to the disk synchronously. */
+    void sync();
+
+protected:
+
+    /** \brief Opens the file with the flags \c flags and maps it. */
+    void open(const std::string& fileName, int flags);
+
+    /** \brief Maps the \c _size bytes of the file. */
+    void map();
+
+    /** \brief Unmaps the file. */
+    void unmap();
+
+protected:
+
+    /** \brief The file descriptor, -1 if the file is closed. */
+    int _fd;
+
+    /** \brief True if the file is opened for reading only. */
+    bool _isReadOnly;
+
+    /** \brief The mapping's address. */
+    Byte* _data;
+
+    /** \brief The file (and mapping) size. */
+    ULong _size;
+
+}; // class MappedFile
+
+} // namespace btree
+
+#endif // BTREE_WITH_MMAP
+
+#endif // BTREE_MAPPEDFILE_H_
@@ -0,0 +1,356 @@
+/// \file
+/// \brief     Page stores: the storages of the tree's pages.
+/// \authors   Anton Rigin
+/// \version   0.1.0
+/// \date      16.10.2026
+///
+////////////////////////////////////////////////////////////////////////////////
+
+#include "pagestore.h"
+
+#include <stdexcept>        // std::invalid_argument
+#include <cstring>          // memcpy
+
+#ifdef BTREE_WITH_POSIX_IO
+
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+
+#endif
+
+namespace btree {
+
+//==============================================================================
+// class BasePageStore
+//==============================================================================
+
+BasePageStore::BasePageStore()
+{
+    reset();
+}
+
+void BasePageStore::create(UInt pageCounterOfs, UInt firstPageOfs, UInt pageSize)
+{
+    _pageCounterOfs = pageCounterOfs;
+    _firstPageOfs = firstPageOfs;
+    _pageSize = pageSize;
+    _lastPageNum = 0;
+    _freePagesCounter = 0;
+
+    writePageCounter();
+    writeFreePagesCounter();
+}
+
+void BasePageStore::load(UInt pageCounterOfs, UInt firstPageOfs, UInt pageSize)
+{
+    _pageCounterOfs = pageCounterOfs;
+    _firstPageOfs = firstPageOfs;
+    _pageSize = pageSize;
+
+    readBytes(_pageCounterOfs, (Byte*)&_lastPageNum, PAGE_COUNTER_SZ);
+    readBytes(getFreePagesInfoAreaOfs(), (Byte*)&_freePagesCounter, FREE_PAGES_COUNTER_SZ);
+}
+
+void BasePageStore::read(UInt pnum, Byte* dst)
+{
+    readBytes(getPageOfs(pnum), dst, _pageSize);
+}
+
+void BasePageStore::write(UInt pnum, const Byte* src)
+{
+    writeBytes(getPageOfs(pnum), src, _pageSize);
+}
+
+UInt BasePageStore::alloc(const Byte* src)
+{
+    if (_freePagesCounter == 0)
+    {
+        // The new page takes the place of the free pages area, which is moved after it.
+        writeBytes(getFreePagesInfoAreaOfs(), src, _pageSize);
+
+        ++_lastPageNum;
+        writePageCounter();
+        writeFreePagesCounter();
+
+        return _lastPageNum;
+    }
+
+    UInt pnum;
+    readBytes(getLastFreePageNumOfs(), (Byte*)&pnum, FREE_PAGE_NUM_SZ);
+    write(pnum, src);
+
+    --_freePagesCounter;
+    writeFreePagesCounter();
+
+    return pnum;
+}
+
+UInt BasePageStore::getAllocPageNum(UInt num)
+{
+    // The free pages are reused from the last freed one, then the new pages are appended.
+    if (num >= _freePagesCounter)
+        return _lastPageNum + 1 + (num - _freePagesCounter);
+
+    UInt pnum;
+    readBytes(getLastFreePageNumOfs() - (ULong)num * FREE_PAGE_NUM_SZ, (Byte*)&pnum, FREE_PAGE_NUM_SZ);
+
+    return pnum;
+}
+
+void BasePageStore::free(UInt pnum)
+{
+    if (pnum == 0 || pnum > _lastPageNum)
+        throw std::invalid_argument("No page with a such number");
+
+    writeBytes(getLastFreePageNumOfs() + FREE_PAGE_NUM_SZ, (const Byte*)&pnum, FREE_PAGE_NUM_SZ);
+
+    ++_freePagesCounter;
+    writeFreePagesCounter();
+}
+
+ULong BasePageStore::getSize() const
+{
+    return getFreePagesInfoAreaOfs() + FIRST_FREE_PAGE_NUM_OFS + (ULong)_freePagesCounter * FREE_PAGE_NUM_SZ;
+}
+
+void BasePageStore::reset()
+{
+    _pageCounterOfs = 0;
+    _firstPageOfs = 0;
+    _pageSize = 0;
+    _lastPageNum = 0;
+    _freePagesCounter = 0;
+}
+
+ULong BasePageStore::getPageOfs(UInt pnum) const
+{
+    return (ULong)_firstPageOfs + (ULong)(pnum - 1) * _pageSize;
+}
+
+ULong BasePageStore::getFreePagesInfoAreaOfs() const
+{
+    return getPageOfs(_lastPageNum + 1);
+}
+
+ULong BasePageStore::getLastFreePageNumOfs() const
+{
+    return getFreePagesInfoAreaOfs() + FIRST_FREE_PAGE_NUM_OFS + (ULong)_freePagesCounter * FREE_PAGE_NUM_SZ
+            - FREE_PAGE_NUM_SZ;
+}
+
+void BasePageStore::writePageCounter()
+{
+    writeBytes(_pageCounterOfs, (const Byte*)&_lastPageNum, PAGE_COUNTER_SZ);
+}
+
+void BasePageStore::writeFreePagesCounter()
+{
+    writeBytes(getFreePagesInfoAreaOfs(), (const Byte*)&_freePagesCounter, FREE_PAGES_COUNTER_SZ);
+}
+
+//==============================================================================
+// class StreamPageStore
+//==============================================================================
+
+void StreamPageStore::sync()
+{
+    if (_stream != nullptr)
+        _stream->flush();
+}
+
+void StreamPageStore::setStream(std::iostream* stream)
+{
+    _stream = stream;
+    reset();
+}
+
+void StreamPageStore::readBytes(ULong ofs, Byte* dst, UInt sz)
+{
+    std::lock_guard<std::mutex> lock(_streamMutex);
+
+    _stream->seekg(ofs, std::ios_base::beg);
+    _stream->read((char*)dst, sz);
+}
+
+void StreamPageStore::writeBytes(ULong ofs, const Byte* src, UInt sz)
+{
+    std::lock_guard<std::mutex> lock(_streamMutex);
+
+    _stream->seekp(ofs, std::ios_base::beg);
+    _stream->write((const char*)src, sz);
+}
+
+//==============================================================================
+// class MemoryPageStore
+//==============================================================================
+
+Byte* MemoryPageStore::view(UInt pnum)
+{
+    if (pnum == 0 || pnum > _lastPageNum)
+        throw std::invalid_argument("Can't view a non-existing page");
+
+    return &_data[getPageOfs(pnum)];
+}
+
+void MemoryPageStore::clear()
+{
+    _data.clear();
+    reset();
+}
+
+void MemoryPageStore::readBytes(ULong ofs, Byte* dst, UInt sz)
+{
+    if (ofs + sz > _data.size())
+        throw std::runtime_error("Can't read beyond the end of the storage");
+
+    memcpy(dst, &_data[ofs], sz);
+}
+
+void MemoryPageStore::writeBytes(ULong ofs, const Byte* src, UInt sz)
+{
+    if (ofs + sz > _data.size())
+        _data.resize(ofs + sz);
+
+    memcpy(&_data[ofs], src, sz);
+}
+
+//==============================================================================
+// class MappedPageStore
+//==============================================================================
+
+#ifdef BTREE_WITH_MMAP
+
+MappedPageStore::~MappedPageStore()
+{
+    close();
+}
+
+void MappedPageStore::open(const std::string& fileName, bool truncate)
+{
+    _file.open(fileName, truncate);
+    reset();
+}
+
+void MappedPageStore::close()
+{
+    if (!_file.isOpen())
+        return;
+
+    // The mapped file grows by chunks, so its tail beyond the stored data is cut.
+    _file.close(_pageSize != 0 ? getSize() : _file.getSize());
+    reset();
+}
+
+Byte* MappedPageStore::view(UInt pnum)
+{
+    if (pnum == 0 || pnum > _lastPageNum)
+        throw std::invalid_argument("Can't view a non-existing page");
+
+    return _file.getData() + getPageOfs(pnum);
+}
+
+void MappedPageStore::readBytes(ULong ofs, Byte* dst, UInt sz)
+{
+    if (ofs + sz > _file.getSize())
+        throw std::runtime_error("Can't read beyond the end of the file");
+
+    memcpy(dst, _file.getData() + ofs, sz);
+}
+
+void MappedPageStore::writeBytes(ULong ofs, const Byte* src, UInt sz)
+{
+    _file.reserve(ofs + sz);
+    memcpy(_file.getData() + ofs, src, sz);
+}
+
+#endif // BTREE_WITH_MMAP
+
+//==============================================================================
+// class PosixPageStore
+//==============================================================================
+
+#ifdef BTREE_WITH_POSIX_IO
+
+PosixPageStore::PosixPageStore()
+    : _fd(-1)
+{
+}
+
+PosixPageStore::~PosixPageStore()
+{
+    close();
+}
+
+void PosixPageStore::open(const std::string& fileName, bool truncate)
+{
+    if (isOpen())
+        throw std::runtime_error("File is already open");
+
+    int flags = O_RDWR;
+    if (truncate)
+        flags |= O_CREAT | O_TRUNC;
+
+    _fd = ::open(fileName.c_str(), flags, 0644);
+    if (_fd == -1)
+        throw std::runtime_error(truncate ? "Can't open file for writing" : "Can't open file for reading");
+
+    reset();
+}
+
+void PosixPageStore::close()
+{
+    if (!isOpen())
+        return;
+
+    ::close(_fd);
+    _fd = -1;
+    reset();
+}
+
+void PosixPageStore::sync()
+{
+    if (isOpen() && fsync(_fd) == -1)
+        throw std::runtime_error("Can't sync file");
+}
+
+void PosixPageStore::readBytes(ULong ofs, Byte* dst, UInt sz)
+{
+    while (sz > 0)
+    {
+        ssize_t res = pread(_fd, dst, sz, (off_t)ofs);
+        if (res == -1 && errno == EINTR)
+            continue;
+
+        if (res == -1)
+            throw std::runtime_error("Can't read file");
+
+        if (res == 0)
+            throw std::runtime_error("Can't read beyond the end of the file");
+
+        dst += res;
+        ofs += res;
+        sz -= (UInt)res;
+    }
+}
+
+void PosixPageStore::writeBytes(ULong ofs, const Byte* src, UInt sz)
+{
+    while (sz > 0)
+    {
+        ssize_t res = pwrite(_fd, src, sz, (off_t)ofs);
+        if (res == -1 && errno == EINTR)
+            continue;
+
+        if (res == -1)
+            throw std::runtime_error("Can't write file");
+
+        src += res;
+        ofs += res;
+        sz -= (UInt)res;
+    }
+}
+
+#endif // BTREE_WITH_POSIX_IO
+
+} // namespace btree
@@ -0,0 +1,380 @@
+/// \file
+/// \brief     Page stores: the storages of the tree's pages.
+/// \authors   Anton Rigin
+/// \version   0.1.0
+/// \date      16.10.2026
+///
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef BTREE_PAGESTORE_H_
+#define BTREE_PAGESTORE_H_
+
+#include <string>
+#include <iostream>
+#include <mutex>
+#include <vector>
+
+#include "utils.h"
+#include "bufferpool.h"
+#include "mappedfile.h"
+
+namespace btree {
+
+/** \brief Interface of the storage of the tree's pages.
+ *
+ *  Besides the pages, the storage keeps the tree's header area (its first bytes)
+ *  and the numbers of the free pages which can be reused.
+ *  All pages are numbered from 1, 0 is nonexistent page (nullptr).
+ */
+class IPageStore : public IPageIO {
+public:
+
+    /** \brief Initializes the empty storage.
+     *
+     *  \param pageCounterOfs The offset of the pages counter in the header area.
+     *  \param firstPageOfs The first page offset (the header area's size).
+     *  \param pageSize The page size.
+     */
+    virtual void create(UInt pageCounterOfs, UInt firstPageOfs, UInt pageSize) = 0;
+
+    /** \brief Loads the pages counter and the free pages counter of the existing storage.
+     *
+     *  The params are the same as in create().
+     */
+    virtual void load(UInt pageCounterOfs, UInt firstPageOfs, UInt pageSize) = 0;
+
+    /** \brief Reads \c sz bytes at the offset \c ofs of the header area to the memory in \c dst. */
+    virtual void readHeader(UInt ofs, Byte* dst, UInt sz) = 0;
+
+    /** \brief Writes \c sz bytes from the memory in \c src to the offset \c ofs of the header area. */
+    virtual void writeHeader(UInt ofs, const Byte* src, UInt sz) = 0;
+
+    /** \brief Allocates the page (the last freed one if any, otherwise the new one), writes the page's
+     *  content from the memory in \c src to it and returns its number.
+     */
+    virtual UInt alloc(const Byte* src) = 0;
+
+    /** \brief Returns the number of the page which will be returned by the (\c num + 1)-th following alloc()
+     *  if there are no free() calls between them, so the pages can be linked before they are written.
+     */
+    virtual UInt getAllocPageNum(UInt num) = 0;
+
+    /** \brief Marks the page with number \c pnum as free for the following reusing by alloc().
+     *
+     *  \throws std::invalid_argument if there is no such a page.
+     */
+    virtual void free(UInt pnum) = 0;
+
+    /** \brief Writes all the changes to the underlying device. */
+    virtual void sync() = 0;
+
+    /** \brief Marks the end of the tree's modifying operation.
+     *
+     *  \returns true if the changes of the ended operations should be committed now.
+     */
+    virtual bool endOperation() = 0;
+
+    /** \brief Makes the changes of the ended operations durable as a whole. */
+    virtual void commit() = 0;
+
+    /** \brief Returns true if the store keeps the changes of each operation apart until the operation's end,
+     *  so abortOperation() drops them.
+     */
+    virtual bool canAbortOperation() const = 0;
+
+    /** \brief Drops the changes written since the end of the last operation, which has failed.
+     *
+     *  Does nothing if the store writes the changes at once.
+     */
+    virtual void abortOperation() = 0;
+
+    /** \brief Returns the pointer to the page with number \c pnum in the storage's memory
+     *  or nullptr if the storage can't provide it.
+     *
+     *  The pointer is valid until the next alloc().
+     */
+    virtual Byte* view(UInt pnum) = 0;
+
+    /** \brief Returns true if the storage is ready for reading and writing. */
+    virtual bool isOpen() const = 0;
+
+    /** \brief Returns the last page number (the pages count). */
+    virtual UInt getLastPageNum() const = 0;
+
+    /** \brief Returns the free pages count. */
+    virtual UInt getFreePagesCount() const = 0;
+
+    /** \brief Returns the size of the stored data in bytes. */
+    virtual ULong getSize() const = 0;
+
+protected:
+
+    ~IPageStore() {};
+
+}; // class IPageStore
+
+/** \brief Base page store laying the tree out in a linear address space.
+ *
+ *  The header area is followed by the pages, which are followed by the free pages counter and
+ *  the free pages numbers. Inheriting classes define how the bytes are read and written.
+ */
+class BasePageStore : public IPageStore {
+public:
+
+    /** \brief The pages counter size. */
+    static const UInt PAGE_COUNTER_SZ = 4;
+
+    /** \brief The offset of the free pages counter from the begin of the free pages numbers area. */
+    static const UInt FREE_PAGES_COUNTER_OFS = 0;
+
+    /** \brief The size of the free pages counter. */
+    static const UInt FREE_PAGES_COUNTER_SZ = 4;
+
+    /** \brief The offset of the first free page number from the begin of the free pages numbers area. */
+    static const UInt FIRST_FREE_PAGE_NUM_OFS = FREE_PAGES_COUNTER_OFS + FREE_PAGES_COUNTER_SZ;
+
+    /** \brief The size of the free page number. */
+    static const UInt FREE_PAGE_NUM_SZ = 4;
+
+public:
+
+    BasePageStore();
+
+    ~BasePageStore() {};
+
+protected:
+
+    BasePageStore(const BasePageStore&);
+
+    BasePageStore& operator= (BasePageStore&);
+
+public:
+
+    virtual void create(UInt pageCounterOfs, UInt firstPageOfs, UInt pageSize) override;
+
+    virtual void load(UInt pageCounterOfs, UInt firstPageOfs, UInt pageSize) override;
+
+    virtual void read(UInt pnum, Byte* dst) override;
+
+    virtual void write(UInt pnum, const Byte* src) override;
+
+    virtual void readHeader(UInt ofs, Byte* dst, UInt sz) override { readBytes(ofs, dst, sz); }
+
+    virtual void writeHeader(UInt ofs, const Byte* src, UInt sz) override { writeBytes(ofs, src, sz); }
+
+    virtual UInt alloc(const Byte* src) override;
+
+    virtual UInt getAllocPageNum(UInt num) override;
+
+    virtual void free(UInt pnum) override;
+
+    virtual bool endOperation() override { return false; }
+
+    virtual void commit() override { }
+
+    virtual bool canAbortOperation() const override { return false; }
+
+    virtual void abortOperation() override { }
+
+    virtual Byte* view(UInt /*pnum*/) override { return nullptr; }
+
+    virtual UInt getLastPageNum() const override { return _lastPageNum; }
+
+    virtual UInt getFreePagesCount() const override { return _freePagesCounter; }
+
+    virtual ULong getSize() const override;
+
+    /** \brief Returns the page size. */
+    UInt getPageSize() const { return _pageSize; }
+
+protected:
+
+    /** \brief Reads \c sz bytes at the offset \c ofs to the memory in \c dst. */
+    virtual void readBytes(ULong ofs, Byte* dst, UInt sz) = 0;
+
+    /** \brief Writes \c sz bytes from the memory in \c src to the offset \c ofs. */
+    virtual void writeBytes(ULong ofs, const Byte* src, UInt sz) = 0;
+
+    /** \brief Resets the layout and the counters, used when the storage is reopened. */
+    void reset();
+
+    /** \brief Returns the offset of the page with number \c pnum. */
+    ULong getPageOfs(UInt pnum) const;
+
+    /** \brief Returns the offset of the free pages numbers area. */
+    ULong getFreePagesInfoAreaOfs() const;
+
+    /** \brief Returns the offset of the last free page number. */
+    ULong getLastFreePageNumOfs() const;
+
+    /** \brief Writes the pages counter. */
+    void writePageCounter();
+
+    /** \brief Writes the free pages counter. */
+    void writeFreePagesCounter();
+
+protected:
+
+    /** \brief The offset of the pages counter in the header area. */
+    UInt _pageCounterOfs;
+
+    /** \brief The first page offset. */
+    UInt _firstPageOfs;
+
+    /** \brief The page size, 0 if the storage is not created or loaded. */
+    UInt _pageSize;
+
+    /** \brief The last page number (the pages count). */
+    UInt _lastPageNum;
+
+    /** \brief The free pages count. */
+    UInt _freePagesCounter;
+
+}; // class BasePageStore
+
+/** \brief Page store above the stream. The stream is not owned by the store.
+ *
+ *  The stream's position is shared, so the concurrent reads are serialized;
+ *  PosixPageStore and MappedPageStore serve them in parallel.
+ */
+class StreamPageStore : public BasePageStore {
+public:
+
+    StreamPageStore(std::iostream* stream = nullptr) : _stream(stream) { }
+
+    virtual void sync() override;
+
+    virtual bool isOpen() const override { return _stream != nullptr && !_stream->fail(); }
+
+    /** \brief Returns the stream. */
+    std::iostream* getStream() const { return _stream; }
+
+    /** \brief Sets the stream, the layout and the counters are reset. */
+    void setStream(std::iostream* stream);
+
+protected:
+
+    virtual void readBytes(ULong ofs, Byte* dst, UInt sz) override;
+
+    virtual void writeBytes(ULong ofs, const Byte* src, UInt sz) override;
+
+protected:
+
+    /** \brief The stream. */
+    std::iostream* _stream;
+
+    /** \brief Guards the stream's position between the seeking and the reading / writing. */
+    std::mutex _streamMutex;
+
+}; // class StreamPageStore
+
+/** \brief Page store keeping all the data in the memory, it is not persisted. */
+class MemoryPageStore : public BasePageStore {
+public:
+
+    virtual void sync() override { }
+
+    virtual Byte* view(UInt pnum) override;
+
+    virtual bool isOpen() const override { return true; }
+
+    /** \brief Drops all the data. */
+    void clear();
+
+protected:
+
+    virtual void readBytes(ULong ofs, Byte* dst, UInt sz) override;
+
+    virtual void writeBytes(ULong ofs, const Byte* src, UInt sz) override;
+
+protected:
+
+    /** \brief The data. */
+    std::vector<Byte> _data;
+
+}; // class MemoryPageStore
+
+#ifdef BTREE_WITH_MMAP
+
+/** \brief Page store above the memory-mapped file. Provides the pages' views without copying. */
+class MappedPageStore : public BasePageStore {
+public:
+
+    ~MappedPageStore();
+
+    /** \brief Opens and maps the file with name \c fileName.
+     *
+     *  If \c truncate is true, the file is created or its content is dropped.
+     *  \throws std::runtime_error if the file can't be opened or mapped.
+     */
+    void open(const std::string& fileName, bool truncate);
+
+    /** \brief Unmaps and closes the file, cutting it to the stored data size. */
+    void close();
+
+    virtual void sync() override { _file.sync(); }
+
+    virtual Byte* view(UInt pnum) override;
+
+    virtual bool isOpen() const override { return _file.isOpen(); }
+
+protected:
+
+    virtual void readBytes(ULong ofs, Byte* dst, UInt sz) override;
+
+    virtual void writeBytes(ULong ofs, const Byte* src, UInt sz) override;
+
+protected:
+
+    /** \brief The mapped file. */
+    MappedFile _file;
+
+}; // class MappedPageStore
+
+#endif // BTREE_WITH_MMAP
+
+#ifdef BTREE_WITH_POSIX_IO
+
+/** \brief Page store above the file accessed by the positional reads and writes (pread() / pwrite()).
+ *
+ *  There is no shared file position and no stream buffering, so the concurrent reads don't interfere.
+ */
+class PosixPageStore : public BasePageStore {
+public:
+
+    PosixPageStore();
+
+    ~PosixPageStore();
+
+    /** \brief Opens the file with name \c fileName.
+     *
+     *  If \c truncate is true, the file is created or its content is dropped.
+     *  \throws std::runtime_error if the file can't be opened.
+     */
+    void open(const std::string& fileName, bool truncate);
+
+    /** \brief Closes the file. */
+    void close();
+
+    virtual void sync() override;
+
+    virtual bool isOpen() const override { return _fd != -1; }
+
+protected:
+
+    virtual void readBytes(ULong ofs, Byte* dst, UInt sz) override;
+
+    virtual void writeBytes(ULong ofs, const Byte* src, UInt sz) override;
+
+protected:
+
+    /** \brief The file descriptor, -1 if the file is closed. */
+    int _fd;
+
+}; // class PosixPageStore
+
+#endif // BTREE_WITH_POSIX_IO
+
+} // namespace btree
+
+#endif // BTREE_PAGESTORE_H_
@@ -0,0 +1,229 @@
+/// \file
+/// \brief     Cursor iterating over the tree's keys in the order.
+/// \authors   Anton Rigin
+/// \version   0.1.0
+/// \date      16.10.2026
+///
+////////////////////////////////////////////////////////////////////////////////
+
+#include "treecursor.h"
+
+#include <stdexcept>
+
+namespace btree {
+
+//==============================================================================
+// class TreeCursor
+//==============================================================================
+
+TreeCursor::TreeCursor(BaseBTree* tree)
+    : _tree(tree)
+    , _depth(0)
+{
+    if (_tree == nullptr)
+        throw std::invalid_argument("Tree can't be nullptr");
+}
+
+TreeCursor::~TreeCursor()
+{
+    for (std::vector<Frame*>::iterator iter = _frames.begin(); iter != _frames.end(); ++iter)
+        delete *iter;
+}
+
+bool TreeCursor::seek(const Byte* k)
+{
+    BaseBTree::IComparator* c = _tree->getComparator();
+    if (c == nullptr)
+        throw std::runtime_error("Comparator not set. Can't seek");
+
+    pushRoot();
+    for ( ; ; )
+    {
+        Frame& top = getTop();
+        top.pos = _tree->lowerBound(top.page, k);
+        if (top.page.isLeaf())
+            break;
+
+        pushChild();
+    }
+
+    if (!settleForward())
+        return false;
+
+    // After the removals a router can be greater than its left leaf's max key,
+    // so the path can come to a leaf before the searched key's one.
+    while (c->compare(getKey(), k, _tree->getRecSize()))
+    {
+        if (!next())
+            return false;
+    }
+
+    return true;
+}
+
+bool TreeCursor::seekFirst()
+{
+    pushRoot();
+
+    Frame& root = getTop();
+    root.pos = 0;
+    if (!root.page.isLeaf())
+        descendLeftmost();
+
+    return settleForward();
+}
+
+bool TreeCursor::seekLast()
+{
+    pushRoot();
+
+    Frame& root = getTop();
+    root.pos = root.page.getKeysNum();
+    if (!root.page.isLeaf())
+        descendRightmost();
+    else
+        --root.pos;
+
+    return settleBackward();
+}
+
+bool TreeCursor::next()
+{
+    if (!isValid())
+        return false;
+
+    Frame& top = getTop();
+    ++top.pos;
+
+    // The key of the inner page (in the B- and B*-trees) is followed by the leftmost key of its right child.
+    if (!top.page.isLeaf())
+        descendLeftmost();
+
+    return settleForward();
+}
+
+bool TreeCursor::prev()
+{
+    if (!isValid())
+        return false;
+
+    Frame& top = getTop();
+
+    // The key of the inner page is preceded by the rightmost key of its left child.
+    if (!top.page.isLeaf())
+        descendRightmost();
+    else
+        --top.pos;
+
+    return settleBackward();
+}
+
+const Byte* TreeCursor::getKey() const
+{
+    if (!isValid())
+        return nullptr;
+
+    const Frame& top = *_frames[_depth - 1];
+    return top.page.getKey(top.pos);
+}
+
+void TreeCursor::pushRoot()
+{
+    _depth = 0;
+
+    if (_frames.empty())
+        _frames.push_back(new Frame(_tree));
+
+    _frames[0]->page.readPage(_tree->getRootPageNum());
+    _depth = 1;
+}
+
+void TreeCursor::pushChild()
+{
+    if (_frames.size() == _depth)
+        _frames.push_back(new Frame(_tree));
+
+    Frame& parent = getTop();
+    _frames[_depth]->page.readPageFromChild(parent.page, parent.pos);
+    ++_depth;
+}
+
+void TreeCursor::descendLeftmost()
+{
+    for ( ; ; )
+    {
+        pushChild();
+
+        Frame& top = getTop();
+        top.pos = 0;
+        if (top.page.isLeaf())
+            return;
+    }
+}
+
+void TreeCursor::descendRightmost()
+{
+    for ( ; ; )
+    {
+        pushChild();
+
+        Frame& top = getTop();
+        top.pos = top.page.getKeysNum();
+        if (top.page.isLeaf())
+        {
+            --top.pos;
+            return;
+        }
+    }
+}
+
+bool TreeCursor::settleForward()
+{
+    for ( ; ; )
+    {
+        if (getTop().pos < getTop().page.getKeysNum())
+            return true;
+
+        // Leaving the pages which are passed, the parent's position is the number of the passed child.
+        do
+        {
+            --_depth;
+            if (_depth == 0)
+                return false;
+        }
+        while (getTop().pos == getTop().page.getKeysNum());
+
+        // The parent's key following the child is the next one, unless it is only a router.
+        if (!_tree->isLeafOriented())
+            return true;
+
+        ++getTop().pos;
+        descendLeftmost();
+    }
+}
+
+bool TreeCursor::settleBackward()
+{
+    for ( ; ; )
+    {
+        if (getTop().pos >= 0)
+            return true;
+
+        do
+        {
+            --_depth;
+            if (_depth == 0)
+                return false;
+        }
+        while (getTop().pos == 0);
+
+        // The parent's key preceding the child is the previous one.
+        --getTop().pos;
+        if (!_tree->isLeafOriented())
+            return true;
+
+        descendRightmost();
+    }
+}
+
+} // namespace btree
@@ -0,0 +1,131 @@
+/// \file
+/// \brief     Cursor iterating over the tree's keys in the order.
+/// \authors   Anton Rigin
+/// \version   0.1.0
+/// \date      16.10.2026
+///
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef BTREE_TREECURSOR_H_
+#define BTREE_TREECURSOR_H_
+
+#include <vector>
+
+#include "btree.h"
+
+namespace btree {
+
+/** \brief Cursor moving forward and backward over the tree's keys in the keys order.
+ *
+ *  Not to be confused with the pages' cursors (the children numbers). The cursor keeps the path of
+ *  the pages from the root to the current key, so next() and prev() read only the pages which are
+ *  entered or left: a walk over a range reads each page of it once and the results are not stored.
+ *  In the B+- and B*+-trees only the leaves' keys are visited, the routers are skipped.
+ *
+ *  The cursor is valid until the tree is modified, then it should be set again by seek().
+ */
+class TreeCursor {
+
+public:
+
+    /** \brief Constructs the cursor of the tree \c tree which is not positioned at any key. */
+    TreeCursor(BaseBTree* tree);
+
+    /** \brief Destructor. */
+    ~TreeCursor();
+
+protected:
+
+    TreeCursor(const TreeCursor&);
+
+    TreeCursor& operator= (TreeCursor&);
+
+public:
+
+    /** \brief Positions the cursor at the first key not less than \c k.
+     *
+     *  \returns true if there is such a key, otherwise false and the cursor becomes invalid.
+     *  \throws std::runtime_error if the tree's comparator is not set.
+     */
+    bool seek(const Byte* k);
+
+    /** \brief Positions the cursor at the first key. Returns false if the tree is empty. */
+    bool seekFirst();
+
+    /** \brief Positions the cursor at the last key. Returns false if the tree is empty. */
+    bool seekLast();
+
+    /** \brief Moves the cursor to the next key.
+     *
+     *  \returns true if there is such a key, otherwise false and the cursor becomes invalid.
+     */
+    bool next();
+
+    /** \brief Moves the cursor to the previous key similar to next(). */
+    bool prev();
+
+    /** \brief Returns true if the cursor is positioned at a key. */
+    bool isValid() const { return _depth != 0; }
+
+    /** \brief Returns the pointer to the current key, which is valid until the cursor is moved,
+     *  or nullptr if the cursor is not valid.
+     */
+    const Byte* getKey() const;
+
+    /** \brief Makes the cursor invalid. */
+    void reset() { _depth = 0; }
+
+protected:
+
+    /** \brief The page of the path and the position in it. */
+    struct Frame {
+
+        Frame(BaseBTree* tree) : page(tree), pos(0) { }
+
+        /** \brief The page. */
+        BaseBTree::PageWrapper page;
+
+        /** \brief The number of the child which the path enters or, in the last page, of the current key. */
+        int pos;
+
+    }; // struct Frame
+
+protected:
+
+    /** \brief Returns the last page of the path. */
+    Frame& getTop() { return *_frames[_depth - 1]; }
+
+    /** \brief Starts the path from the root. */
+    void pushRoot();
+
+    /** \brief Adds to the path the child of the last page which number is the last page's position. */
+    void pushChild();
+
+    /** \brief Extends the path from its last (inner) page to the leftmost leaf of the current child. */
+    void descendLeftmost();
+
+    /** \brief Extends the path from its last (inner) page to the rightmost leaf of the current child. */
+    void descendRightmost();
+
+    /** \brief Moves the cursor from the position after the last page's keys to the next key. */
+    bool settleForward();
+
+    /** \brief Moves the cursor from the position before the last page's keys to the previous key. */
+    bool settleBackward();
+
+protected:
+
+    /** \brief The tree. */
+    BaseBTree* _tree;
+
+    /** \brief The path's pages, the first \c _depth of them are used. */
+    std::vector<Frame*> _frames;
+
+    /** \brief The path's length, 0 if the cursor is not valid. */
+    UInt _depth;
+
+}; // class TreeCursor
+
+} // namespace btree
+
+#endif // BTREE_TREECURSOR_H_
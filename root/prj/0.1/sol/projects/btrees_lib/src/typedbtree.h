@@ -0,0 +1,383 @@
+/// \file
+/// \brief     Typed B-trees with the keys comparison known at compile time.
+/// \authors   Anton Rigin
+/// \version   0.1.0
+/// \date      16.10.2026
+///
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef BTREE_TYPEDBTREE_H_
+#define BTREE_TYPEDBTREE_H_
+
+#include <cstring>          // memcpy
+#include <functional>       // std::less
+#include <iterator>         // std::distance
+#include <stdexcept>        // std::invalid_argument
+#include <type_traits>
+#include <vector>
+
+#include "btree.h"
+#include "bulkloader.h"
+#include "keysearch.h"
+#include "treecursor.h"
+
+namespace btree {
+
+/** \brief Maps the tree type to the class implementing it. */
+template <BaseBTree::TreeType treeType>
+struct TreeTypeTraits;
+
+template <>
+struct TreeTypeTraits<BaseBTree::B_TREE> { typedef BaseBTree Tree; };
+
+template <>
+struct TreeTypeTraits<BaseBTree::B_PLUS_TREE> { typedef BaseBPlusTree Tree; };
+
+template <>
+struct TreeTypeTraits<BaseBTree::B_STAR_TREE> { typedef BaseBStarTree Tree; };
+
+template <>
+struct TreeTypeTraits<BaseBTree::B_STAR_PLUS_TREE> { typedef BaseBStarPlusTree Tree; };
+
+/** \brief Comparator of the keys of type \c Key stored as raw bytes, ordered by \c Compare. */
+template <typename Key, typename Compare = std::less<Key> >
+class TypedComparator : public BaseBTree::IComparator {
+public:
+
+    TypedComparator(const Compare& compare = Compare()) : _compare(compare) { }
+
+    virtual bool compare(const Byte* lhv, const Byte* rhv, UInt sz) override
+    {
+        return _compare(load(lhv), load(rhv));
+    }
+
+    virtual bool isEqual(const Byte* lhv, const Byte* rhv, UInt sz) override
+    {
+        Key l = load(lhv);
+        Key r = load(rhv);
+        return !_compare(l, r) && !_compare(r, l);
+    }
+
+    /** \brief Returns the key stored at \c src. The keys in the pages are not aligned, so it is copied. */
+    static Key load(const Byte* src)
+    {
+        Key key;
+        memcpy(&key, src, sizeof(Key));
+        return key;
+    }
+
+    /** \brief Returns the keys ordering. */
+    const Compare& getCompare() const { return _compare; }
+
+protected:
+
+    /** \brief The keys ordering. */
+    Compare _compare;
+
+}; // class TypedComparator
+
+/** \brief Search of the key's bounds among the sorted keys of type \c Key stored contiguously
+ *  at \c keys, ordered by \c Compare.
+ *
+ *  The generic version is the binary search, which becomes linear for the short ranges.
+ */
+template <typename Key, typename Compare, typename Enable = void>
+struct KeySearch {
+
+    /** \brief Returns the number of the first key not less than \c key or \c num if there is no such a key. */
+    static UShort lowerBound(const Byte* keys, UShort num, const Key& key, const Compare& less)
+    {
+        UShort first = 0;
+        UShort last = num;
+
+        while (last - first > BaseBTree::LINEAR_SEARCH_THRESHOLD)
+        {
+            UShort middle = first + (last - first) / 2;
+            if (less(keyAt(keys, middle), key))
+                first = middle + 1;
+            else
+                last = middle;
+        }
+
+        for ( ; first < last && less(keyAt(keys, first), key); ++first) ;
+
+        return first;
+    }
+
+    /** \brief Returns the number of the first key greater than \c key or \c num if there is no such a key. */
+    static UShort upperBound(const Byte* keys, UShort num, const Key& key, const Compare& less)
+    {
+        UShort first = 0;
+        UShort last = num;
+
+        while (last - first > BaseBTree::LINEAR_SEARCH_THRESHOLD)
+        {
+            UShort middle = first + (last - first) / 2;
+            if (!less(key, keyAt(keys, middle)))
+                first = middle + 1;
+            else
+                last = middle;
+        }
+
+        for ( ; first < last && !less(key, keyAt(keys, first)); ++first) ;
+
+        return first;
+    }
+
+    /** \brief Returns the key number \c num. */
+    static Key keyAt(const Byte* keys, UShort num)
+    {
+        return TypedComparator<Key, Compare>::load(keys + (size_t)num * sizeof(Key));
+    }
+
+}; // struct KeySearch
+
+/** \brief Search among the signed 32-bit integer keys in the ascending order by the SIMD kernels. */
+template <typename Key>
+struct KeySearch<Key, std::less<Key>, typename std::enable_if<std::is_integral<Key>::value
+        && std::is_signed<Key>::value && sizeof(Key) == 4>::type> {
+
+    static UShort lowerBound(const Byte* keys, UShort num, const Key& key, const std::less<Key>&)
+    {
+        return lowerBoundInt32(keys, num, (std::int32_t)key);
+    }
+
+    static UShort upperBound(const Byte* keys, UShort num, const Key& key, const std::less<Key>&)
+    {
+        return upperBoundInt32(keys, num, (std::int32_t)key);
+    }
+
+}; // struct KeySearch
+
+/** \brief Search among the signed 64-bit integer keys in the ascending order by the SIMD kernels. */
+template <typename Key>
+struct KeySearch<Key, std::less<Key>, typename std::enable_if<std::is_integral<Key>::value
+        && std::is_signed<Key>::value && sizeof(Key) == 8>::type> {
+
+    static UShort lowerBound(const Byte* keys, UShort num, const Key& key, const std::less<Key>&)
+    {
+        return lowerBoundInt64(keys, num, (std::int64_t)key);
+    }
+
+    static UShort upperBound(const Byte* keys, UShort num, const Key& key, const std::less<Key>&)
+    {
+        return upperBoundInt64(keys, num, (std::int64_t)key);
+    }
+
+}; // struct KeySearch
+
+/** \brief B-tree of the type \c treeType storing the keys of type \c Key ordered by \c Compare.
+ *
+ *  The tree has the same pages format as the untyped one and can be used through BaseBTree,
+ *  but the search inside the nodes is instantiated for \c Key and \c Compare, so the keys
+ *  comparisons are inlined instead of being the virtual IComparator calls.
+ *  The signed 32- and 64-bit integer keys in the ascending order are searched by the SIMD kernels.
+ *  \c Key must be trivially copyable, it is stored as sizeof(Key) raw bytes.
+ */
+template <typename Key, typename Compare = std::less<Key>, BaseBTree::TreeType treeType = BaseBTree::B_TREE>
+class BTree : public TreeTypeTraits<treeType>::Tree {
+public:
+
+    /** \brief The untyped tree class. */
+    typedef typename TreeTypeTraits<treeType>::Tree Base;
+
+    typedef typename BaseBTree::PageWrapper PageWrapper;
+
+    static_assert(std::is_trivially_copyable<Key>::value, "Typed tree keys must be trivially copyable");
+
+public:
+
+    /** \brief Constructs the tree stored in the page store \c store, which is not owned by the tree.
+     *
+     *  The tree is written into the store by create() or read from it by load().
+     */
+    BTree(IPageStore* store, const Compare& compare = Compare())
+        : Base(0, 0, &_typedComparator, store),
+        _typedComparator(compare)
+    {
+    }
+
+public:
+
+    /** \brief Creates the tree of the order \c order and writes it to the store. */
+    void create(UShort order) { this->createTree(order, sizeof(Key)); }
+
+    /** \brief Reads the tree from the store.
+     *
+     *  \throws std::invalid_argument if the stored keys size differs from the size of \c Key.
+     */
+    void load()
+    {
+        this->loadTree();
+        if (this->getRecSize() != sizeof(Key))
+            throw std::invalid_argument("Stored keys size doesn't match the typed tree's key size");
+    }
+
+    /** \brief Inserts the key \c k into the tree. */
+    void insert(const Key& k) { BaseBTree::insert((const Byte*)&k); }
+
+    /** \brief Finds the first occurrence of the key \c k and copies it to \c result.
+     *
+     *  \returns true if the key is found, otherwise false.
+     */
+    bool search(const Key& k, Key& result)
+    {
+        return BaseBTree::search((const Byte*)&k, (Byte*)&result);
+    }
+
+    /** \brief Finds all the occurrences of the key \c k and appends them to \c keys.
+     *
+     *  \returns The found elements count.
+     */
+    int searchAll(const Key& k, std::vector<Key>& keys)
+    {
+        KeysAppender appender(keys);
+        return BaseBTree::searchAll((const Byte*)&k, appender);
+    }
+
+    /** \brief Finds all the keys from \c lo to \c hi inclusive and appends them to \c keys in the keys order.
+     *
+     *  \returns The found keys count.
+     */
+    int searchRange(const Key& lo, const Key& hi, std::vector<Key>& keys)
+    {
+        KeysAppender appender(keys);
+        return BaseBTree::searchRange((const Byte*)&lo, (const Byte*)&hi, appender);
+    }
+
+    /** \brief Loads \c keysCount keys read from the sorted sequence starting at \c first into the empty tree.
+     *
+     *  The sequence is read once and the iterator is not advanced past its last key,
+     *  so single-pass iterators like std::istream_iterator may be used.
+     *
+     *  \sa BulkLoader.
+     */
+    template <typename Iterator>
+    void bulkLoad(Iterator first, ULong keysCount, double fillFactor = 1.0)
+    {
+        BulkLoader loader(this, keysCount, fillFactor);
+
+        for (ULong i = 0; i < keysCount; ++i)
+        {
+            if (i > 0)
+                ++first;
+
+            Key k = *first;
+            loader.add((const Byte*)&k);
+        }
+
+        loader.finish();
+    }
+
+    /** \brief Loads the keys from the sorted range [first, last) into the empty tree.
+     *
+     *  The range is counted before the loading, so it must be a forward one at least.
+     *
+     *  \sa BulkLoader.
+     */
+    template <typename Iterator>
+    void bulkLoad(Iterator first, Iterator last, double fillFactor = 1.0)
+    {
+        static_assert(std::is_base_of<std::forward_iterator_tag,
+            typename std::iterator_traits<Iterator>::iterator_category>::value,
+            "Single-pass iterators need the keys count");
+
+        bulkLoad(first, (ULong)std::distance(first, last), fillFactor);
+    }
+
+#ifdef BTREE_WITH_DELETION
+
+    /** \brief Removes the first occurrence of the key \c k.
+     *
+     *  \returns true if the key is removed, otherwise false.
+     */
+    bool remove(const Key& k) { return BaseBTree::remove((const Byte*)&k); }
+
+    /** \brief Removes all the occurrences of the key \c k.
+     *
+     *  \returns The removed keys count.
+     */
+    int removeAll(const Key& k) { return BaseBTree::removeAll((const Byte*)&k); }
+
+#endif
+
+protected:
+
+    BTree(const BTree&);
+
+    BTree& operator= (BTree&);
+
+protected:
+
+    /** \brief Appends the typed copies of the visited keys to the vector. */
+    class KeysAppender : public BaseBTree::IKeyVisitor {
+    public:
+
+        KeysAppender(std::vector<Key>& keys) : _keys(keys) { }
+
+        virtual void visit(const Byte* k) override { _keys.push_back(TypedComparator<Key, Compare>::load(k)); }
+
+    protected:
+
+        std::vector<Key>& _keys;
+
+    }; // class KeysAppender
+
+protected:
+
+    virtual UShort lowerBound(const PageWrapper& page, const Byte* k) const override
+    {
+        UShort keysNum = page.getKeysNum();
+        if (keysNum == 0)
+            return 0;
+
+        return KeySearch<Key, Compare>::lowerBound(page.getKey(0), keysNum,
+                TypedComparator<Key, Compare>::load(k), _typedComparator.getCompare());
+    }
+
+    virtual UShort upperBound(const PageWrapper& page, const Byte* k) const override
+    {
+        UShort keysNum = page.getKeysNum();
+        if (keysNum == 0)
+            return 0;
+
+        return KeySearch<Key, Compare>::upperBound(page.getKey(0), keysNum,
+                TypedComparator<Key, Compare>::load(k), _typedComparator.getCompare());
+    }
+
+protected:
+
+    /** \brief The comparator used by the untyped part of the tree. */
+    TypedComparator<Key, Compare> _typedComparator;
+
+}; // class BTree
+
+/** \brief The tree cursor reading the keys of the type \c Key.
+ *
+ *  \sa TreeCursor.
+ */
+template <typename Key>
+class TypedTreeCursor : public TreeCursor {
+public:
+
+    /** \brief Constructs the cursor of the tree \c tree, which keys have the type \c Key. */
+    TypedTreeCursor(BaseBTree* tree) : TreeCursor(tree) { }
+
+public:
+
+    /** \brief Positions the cursor at the first key not less than \c k. */
+    bool seek(const Key& k) { return TreeCursor::seek((const Byte*)&k); }
+
+    /** \brief Returns the copy of the current key. The cursor must be valid. */
+    Key getKey() const
+    {
+        Key k;
+        memcpy(&k, TreeCursor::getKey(), sizeof(Key));
+        return k;
+    }
+
+}; // class TypedTreeCursor
+
+} // namespace btree
+
+#endif // BTREE_TYPEDBTREE_H_
@@ -25,6 +25,17 @@
 #define DEPRECATED
 #endif
 
+// Memory-mapped files and positional I/O (pread / pwrite) are available on the POSIX systems only.
+#if defined(__unix__) || defined(__APPLE__)
+#define BTREE_WITH_MMAP
+#define BTREE_WITH_POSIX_IO
+#endif
+
+// The SIMD keys search kernels are built for x86 by gcc and clang, which can select them at run time.
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define BTREE_WITH_SIMD
+#endif
+
 namespace btree {
 
 //==============================================================================
@@ -35,12 +46,8 @@ typedef unsigned char Byte;
 typedef unsigned short UShort;
 typedef unsigned int UInt;
 
-#ifdef BTREE_WITH_REUSING_FREE_PAGES
-
 typedef unsigned long ULong;
 
-#endif
-
 } // namespace btree
 
 #endif // BTREE_UTILS_H_
@@ -0,0 +1,460 @@
+/// \file
+/// \brief     Page store with the write-ahead log.
+/// \authors   Anton Rigin
+/// \version   0.1.0
+/// \date      16.10.2026
+///
+////////////////////////////////////////////////////////////////////////////////
+
+#include "walpagestore.h"
+
+#ifdef BTREE_WITH_POSIX_IO
+
+#include <algorithm>
+#include <stdexcept>        // std::invalid_argument
+#include <cstring>          // memcpy
+#include <iterator>         // std::prev
+
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace btree {
+
+namespace {
+
+/** \brief The log record's header: the begin sign, the changes count and the changes' size. */
+const UInt RECORD_HEADER_SZ = 4 + 4 + 8;
+
+/** \brief The change's header in the log record: the offset and the size. */
+const UInt CHANGE_HEADER_SZ = 8 + 4;
+
+/** \brief The log record's trailer: the changes' checksum and the end sign. */
+const UInt RECORD_TRAILER_SZ = 4 + 4;
+
+/** \brief Writes \c sz bytes from \c src to the offset \c ofs of the file \c fd. */
+void writeFile(int fd, ULong ofs, const Byte* src, ULong sz)
+{
+    while (sz > 0)
+    {
+        ssize_t res = pwrite(fd, src, sz, (off_t)ofs);
+        if (res == -1 && errno == EINTR)
+            continue;
+
+        if (res == -1)
+            throw std::runtime_error("Can't write log");
+
+        src += res;
+        ofs += res;
+        sz -= res;
+    }
+}
+
+/** \brief Reads up to \c sz bytes at the offset \c ofs of the file \c fd to \c dst, returns the read bytes count. */
+ULong readFile(int fd, ULong ofs, Byte* dst, ULong sz)
+{
+    ULong total = 0;
+    while (total < sz)
+    {
+        ssize_t res = pread(fd, dst + total, sz - total, (off_t)(ofs + total));
+        if (res == -1 && errno == EINTR)
+            continue;
+
+        if (res == -1)
+            throw std::runtime_error("Can't read log");
+
+        if (res == 0)
+            break;
+
+        total += res;
+    }
+
+    return total;
+}
+
+/** \brief Returns the size of the file \c fd. */
+ULong getFileSize(int fd)
+{
+    struct stat st;
+    if (fstat(fd, &st) == -1)
+        throw std::runtime_error("Can't get file size");
+
+    return (ULong)st.st_size;
+}
+
+/** \brief Appends \c sz bytes from \c src to \c buf. */
+void append(std::vector<Byte>& buf, const void* src, UInt sz)
+{
+    buf.insert(buf.end(), (const Byte*)src, (const Byte*)src + sz);
+}
+
+} // namespace
+
+//==============================================================================
+// class WalPageStore
+//==============================================================================
+
+WalPageStore::WalPageStore()
+    : _logFd(-1)
+    , _logSize(0)
+    , _fileSize(0)
+    , _maxChangeSize(0)
+    , _nextSeqNum(0)
+    , _operationSeqNum(0)
+    , _pendingOperations(0)
+    , _groupSize(DEFAULT_GROUP_SIZE)
+    , _checkpointLogSize(DEFAULT_CHECKPOINT_LOG_SIZE)
+    , _commitsCount(0)
+    , _checkpointsCount(0)
+    , _replayedRecordsCount(0)
+{
+}
+
+WalPageStore::~WalPageStore()
+{
+    close();
+}
+
+void WalPageStore::open(const std::string& fileName, bool truncate)
+{
+    PosixPageStore::open(fileName, truncate);
+
+    int flags = O_RDWR | O_CREAT;
+    if (truncate)
+        flags |= O_TRUNC;
+
+    _logFd = ::open(getLogFileName(fileName).c_str(), flags, 0644);
+    if (_logFd == -1)
+    {
+        PosixPageStore::close();
+        throw std::runtime_error("Can't open log");
+    }
+
+    clearChanges();
+    _pendingOperations = 0;
+    _replayedRecordsCount = 0;
+
+    try {
+        _fileSize = getFileSize(_fd);
+        _logSize = getFileSize(_logFd);
+        replayLog();
+    }
+    catch (...)
+    {
+        close();
+        throw;
+    }
+}
+
+void WalPageStore::close()
+{
+    if (_logFd == -1)
+        return;
+
+    // The closing can't throw, the changes which can't be made durable stay in the log if any.
+    try {
+        sync();
+    }
+    catch (...)
+    {
+    }
+
+    ::close(_logFd);
+    _logFd = -1;
+    clearChanges();
+    PosixPageStore::close();
+}
+
+void WalPageStore::sync()
+{
+    commit();
+    checkpoint();
+}
+
+bool WalPageStore::endOperation()
+{
+    for (std::vector<ChangesList::iterator>::const_iterator it = _supersededChanges.begin();
+            it != _supersededChanges.end(); ++it)
+        eraseChange(*it);
+
+    _supersededChanges.clear();
+    _operationSeqNum = _nextSeqNum;
+
+    ++_pendingOperations;
+    return _pendingOperations >= _groupSize;
+}
+
+void WalPageStore::abortOperation()
+{
+    // The running operation's changes are the last ones in the writing order.
+    while (!_changes.empty() && _changes.back().seqNum >= _operationSeqNum)
+        eraseChange(std::prev(_changes.end()));
+
+    for (std::vector<ChangesList::iterator>::const_iterator it = _supersededChanges.begin();
+            it != _supersededChanges.end(); ++it)
+        (*it)->isSuperseded = false;
+
+    _supersededChanges.clear();
+
+    if (_pageSize != 0)
+        load(_pageCounterOfs, _firstPageOfs, _pageSize);
+}
+
+void WalPageStore::commit()
+{
+    _pendingOperations = 0;
+    if (_changes.empty())
+        return;
+
+    std::vector<Byte> record;
+    UInt beginSign = RECORD_BEGIN_SIGN;
+    UInt endSign = RECORD_END_SIGN;
+    UInt changesCount = (UInt)_changes.size();
+    ULong changesSize = 0;
+    for (ChangesList::const_iterator it = _changes.begin(); it != _changes.end(); ++it)
+        changesSize += CHANGE_HEADER_SZ + it->data.size();
+
+    record.reserve(RECORD_HEADER_SZ + changesSize + RECORD_TRAILER_SZ);
+    append(record, &beginSign, 4);
+    append(record, &changesCount, 4);
+    append(record, &changesSize, 8);
+    for (ChangesList::const_iterator it = _changes.begin(); it != _changes.end(); ++it)
+    {
+        UInt sz = (UInt)it->data.size();
+        append(record, &it->ofs, 8);
+        append(record, &sz, 4);
+        append(record, it->data.data(), sz);
+    }
+
+    UInt checksum = getChecksum(record.data() + RECORD_HEADER_SZ, changesSize);
+    append(record, &checksum, 4);
+    append(record, &endSign, 4);
+
+    // The only sync of the group: the changes are durable as soon as the record is.
+    writeFile(_logFd, _logSize, record.data(), record.size());
+    if (fsync(_logFd) == -1)
+        throw std::runtime_error("Can't sync log");
+
+    _logSize += record.size();
+    ++_commitsCount;
+
+    for (ChangesList::const_iterator it = _changes.begin(); it != _changes.end(); ++it)
+    {
+        PosixPageStore::writeBytes(it->ofs, it->data.data(), (UInt)it->data.size());
+        _fileSize = std::max(_fileSize, it->ofs + it->data.size());
+    }
+
+    clearChanges();
+
+    if (_logSize >= _checkpointLogSize)
+        checkpoint();
+}
+
+void WalPageStore::checkpoint()
+{
+    if (_logSize == 0)
+        return;
+
+    PosixPageStore::sync();
+    truncateLog();
+    ++_checkpointsCount;
+}
+
+void WalPageStore::setGroupSize(UInt groupSize)
+{
+    if (groupSize == 0)
+        throw std::invalid_argument("Group size can't be 0");
+
+    _groupSize = groupSize;
+}
+
+void WalPageStore::readBytes(ULong ofs, Byte* dst, UInt sz)
+{
+    ULong end = ofs + sz;
+
+    // The bytes beyond the file are written by the changes only.
+    if (ofs < _fileSize)
+    {
+        UInt fileSz = (UInt)(std::min(end, _fileSize) - ofs);
+        PosixPageStore::readBytes(ofs, dst, fileSz);
+        memset(dst + fileSz, 0, sz - fileSz);
+    }
+    else
+        memset(dst, 0, sz);
+
+    if (_changes.empty())
+        return;
+
+    // The overlapping changes are applied in the writing order.
+    ChangesIndex::const_iterator it = _changesIndex.lower_bound(ofs > _maxChangeSize ? ofs - _maxChangeSize : 0);
+    ChangesIndex::const_iterator last = _changesIndex.lower_bound(end);
+
+    std::vector<const Change*> overlapping;
+    for ( ; it != last; ++it)
+    {
+        const Change& change = *it->second;
+        if (change.ofs + change.data.size() > ofs)
+            overlapping.push_back(&change);
+    }
+
+    std::sort(overlapping.begin(), overlapping.end(),
+        [](const Change* a, const Change* b) { return a->seqNum < b->seqNum; });
+
+    for (std::vector<const Change*>::const_iterator ch = overlapping.begin(); ch != overlapping.end(); ++ch)
+    {
+        const Change& change = **ch;
+        ULong from = std::max(ofs, change.ofs);
+        ULong to = std::min(end, change.ofs + change.data.size());
+        memcpy(dst + (from - ofs), change.data.data() + (from - change.ofs), to - from);
+    }
+}
+
+void WalPageStore::writeBytes(ULong ofs, const Byte* src, UInt sz)
+{
+    ULong end = ofs + sz;
+
+    // The changes covered by the new one entirely are dropped, so a page rewritten many times is logged once.
+    // The ended operations' changes are dropped at the running operation's end, since it can fail.
+    ChangesIndex::iterator it = _changesIndex.lower_bound(ofs);
+    while (it != _changesIndex.end() && it->first < end)
+    {
+        Change& covered = *it->second;
+        if (covered.ofs + covered.data.size() > end)
+            ++it;
+        else if (covered.seqNum >= _operationSeqNum)
+        {
+            _changes.erase(it->second);
+            it = _changesIndex.erase(it);
+        }
+        else
+        {
+            if (!covered.isSuperseded)
+            {
+                covered.isSuperseded = true;
+                _supersededChanges.push_back(it->second);
+            }
+
+            ++it;
+        }
+    }
+
+    _changes.push_back(Change());
+    Change& change = _changes.back();
+    change.seqNum = _nextSeqNum++;
+    change.ofs = ofs;
+    change.isSuperseded = false;
+    change.data.assign(src, src + sz);
+
+    _changesIndex.insert(std::make_pair(ofs, std::prev(_changes.end())));
+    _maxChangeSize = std::max(_maxChangeSize, sz);
+}
+
+void WalPageStore::replayLog()
+{
+    if (_logSize == 0)
+        return;
+
+    std::vector<Byte> log(_logSize);
+    _logSize = readFile(_logFd, 0, log.data(), _logSize);
+
+    // The records are replayed up to the first incomplete one: its group was not committed.
+    ULong pos = 0;
+    for ( ; ; )
+    {
+        if (pos + RECORD_HEADER_SZ > _logSize)
+            break;
+
+        UInt beginSign, changesCount;
+        ULong changesSize;
+        memcpy(&beginSign, &log[pos], 4);
+        memcpy(&changesCount, &log[pos + 4], 4);
+        memcpy(&changesSize, &log[pos + 8], 8);
+
+        if (beginSign != RECORD_BEGIN_SIGN || changesSize > _logSize - pos - RECORD_HEADER_SZ
+                || pos + RECORD_HEADER_SZ + changesSize + RECORD_TRAILER_SZ > _logSize)
+            break;
+
+        const Byte* changes = &log[pos + RECORD_HEADER_SZ];
+        UInt checksum, endSign;
+        memcpy(&checksum, changes + changesSize, 4);
+        memcpy(&endSign, changes + changesSize + 4, 4);
+
+        if (endSign != RECORD_END_SIGN || checksum != getChecksum(changes, changesSize))
+            break;
+
+        ULong chPos = 0;
+        for (UInt i = 0; i < changesCount; ++i)
+        {
+            if (chPos + CHANGE_HEADER_SZ > changesSize)
+                throw std::runtime_error("Log record is corrupted");
+
+            ULong chOfs;
+            UInt chSz;
+            memcpy(&chOfs, changes + chPos, 8);
+            memcpy(&chSz, changes + chPos + 8, 4);
+            chPos += CHANGE_HEADER_SZ;
+
+            if (chPos + chSz > changesSize)
+                throw std::runtime_error("Log record is corrupted");
+
+            PosixPageStore::writeBytes(chOfs, changes + chPos, chSz);
+            _fileSize = std::max(_fileSize, chOfs + chSz);
+            chPos += chSz;
+        }
+
+        pos += RECORD_HEADER_SZ + changesSize + RECORD_TRAILER_SZ;
+        ++_replayedRecordsCount;
+    }
+
+    // The log is emptied when the replayed changes are durable in the file.
+    PosixPageStore::sync();
+    truncateLog();
+}
+
+void WalPageStore::truncateLog()
+{
+    if (ftruncate(_logFd, 0) == -1 || fsync(_logFd) == -1)
+        throw std::runtime_error("Can't truncate log");
+
+    _logSize = 0;
+}
+
+void WalPageStore::clearChanges()
+{
+    _changes.clear();
+    _changesIndex.clear();
+    _supersededChanges.clear();
+    _maxChangeSize = 0;
+    _operationSeqNum = _nextSeqNum;
+}
+
+void WalPageStore::eraseChange(ChangesList::iterator change)
+{
+    std::pair<ChangesIndex::iterator, ChangesIndex::iterator> range = _changesIndex.equal_range(change->ofs);
+    for (ChangesIndex::iterator it = range.first; it != range.second; ++it)
+        if (it->second == change)
+        {
+            _changesIndex.erase(it);
+            break;
+        }
+
+    _changes.erase(change);
+}
+
+UInt WalPageStore::getChecksum(const Byte* data, ULong sz)
+{
+    // FNV-1a.
+    UInt hash = 2166136261u;
+    for (ULong i = 0; i < sz; ++i)
+    {
+        hash ^= data[i];
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
+
+} // namespace btree
+
+#endif // BTREE_WITH_POSIX_IO
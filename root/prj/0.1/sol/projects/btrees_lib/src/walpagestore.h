@@ -0,0 +1,229 @@
+/// \file
+/// \brief     Page store with the write-ahead log.
+/// \authors   Anton Rigin
+/// \version   0.1.0
+/// \date      16.10.2026
+///
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef BTREE_WALPAGESTORE_H_
+#define BTREE_WALPAGESTORE_H_
+
+#include <list>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "pagestore.h"
+
+#ifdef BTREE_WITH_POSIX_IO
+
+namespace btree {
+
+/** \brief Page store above the file which changes are made durable through the write-ahead log.
+ *
+ *  The written bytes are kept in the memory until the commit, so the file never contains the changes
+ *  of the uncommitted operations. The commit appends all the changes of the group of operations to the log
+ *  (the file with the ".wal" suffix) as one record, syncs the log once and then writes the changes
+ *  to the file in place without syncing it. The checkpoint syncs the file and empties the log.
+ *  After a crash open() replays the complete records of the log, so the file gets the state of the last commit.
+ *
+ *  The tree reports the ends of its modifying operations by endOperation() and commits the changes
+ *  when the group of \c groupSize operations is complete, so one log sync serves the whole group.
+ *
+ *  The ended operation is not durable until its group is committed: a crash loses up to (groupSize - 1)
+ *  last ended operations, but never a part of an operation. The group size 1 commits each operation
+ *  before it returns, and BaseBTree::commit() is the barrier which commits the ended operations at once,
+ *  e.g. before their results are reported. If the operation fails, the tree drops its changes
+ *  by abortOperation(), so they don't get to the next commit.
+ */
+class WalPageStore : public PosixPageStore {
+public:
+
+    /** \brief The default count of the operations committed together. */
+    static const UInt DEFAULT_GROUP_SIZE = 32;
+
+    /** \brief The default log size which causes the checkpoint after the commit. */
+    static const ULong DEFAULT_CHECKPOINT_LOG_SIZE = 16 * 1024 * 1024;
+
+    /** \brief The mark of the log record's begin. */
+    static const UInt RECORD_BEGIN_SIGN = 0x474C4157;   // WALG
+
+    /** \brief The mark of the log record's end. */
+    static const UInt RECORD_END_SIGN = 0x434C4157;     // WALC
+
+public:
+
+    WalPageStore();
+
+    ~WalPageStore();
+
+protected:
+
+    WalPageStore(const WalPageStore&);
+
+    WalPageStore& operator= (WalPageStore&);
+
+public:
+
+    /** \brief Opens the file with name \c fileName and its log, replaying the log's committed changes.
+     *
+     *  If \c truncate is true, the file and the log are created or their content is dropped.
+     *  \throws std::runtime_error if the files can't be opened or the log can't be replayed.
+     */
+    void open(const std::string& fileName, bool truncate);
+
+    /** \brief Commits the changes, makes the checkpoint and closes the file and the log. */
+    void close();
+
+    /** \brief Commits the changes and makes the checkpoint. */
+    virtual void sync() override;
+
+    /** \brief Counts the operation and returns true when the group of operations is complete. */
+    virtual bool endOperation() override;
+
+    virtual bool canAbortOperation() const override { return true; }
+
+    /** \brief Drops the changes written since the end of the last operation and reads the pages counters
+     *  again, since the operation's allocations are dropped as well.
+     */
+    virtual void abortOperation() override;
+
+    /** \brief Writes the changes made since the last commit to the log, syncs the log
+     *  and then writes the changes to the file.
+     */
+    virtual void commit() override;
+
+    /** \brief Syncs the file and empties the log. The changes which are not committed are kept. */
+    void checkpoint();
+
+    /** \brief Sets the count of the operations committed together, 1 commits each operation.
+     *
+     *  The greater count syncs the log less often, but up to (groupSize - 1) ended operations are not durable.
+     */
+    void setGroupSize(UInt groupSize);
+
+    /** \brief Returns the count of the operations committed together. */
+    UInt getGroupSize() const { return _groupSize; }
+
+    /** \brief Sets the log size which causes the checkpoint after the commit. */
+    void setCheckpointLogSize(ULong size) { _checkpointLogSize = size; }
+
+    /** \brief Returns the current log size. */
+    ULong getLogSize() const { return _logSize; }
+
+    /** \brief Returns the count of the commits (the log syncs). */
+    UInt getCommitsCount() const { return _commitsCount; }
+
+    /** \brief Returns the count of the checkpoints. */
+    UInt getCheckpointsCount() const { return _checkpointsCount; }
+
+    /** \brief Returns the count of the log records replayed by the last open(). */
+    UInt getReplayedRecordsCount() const { return _replayedRecordsCount; }
+
+    /** \brief Returns the log's file name of the file \c fileName. */
+    static std::string getLogFileName(const std::string& fileName) { return fileName + ".wal"; }
+
+protected:
+
+    virtual void readBytes(ULong ofs, Byte* dst, UInt sz) override;
+
+    virtual void writeBytes(ULong ofs, const Byte* src, UInt sz) override;
+
+protected:
+
+    /** \brief The bytes written since the last commit. */
+    struct Change {
+
+        /** \brief The number of the change in the writing order. */
+        ULong seqNum;
+
+        /** \brief The offset. */
+        ULong ofs;
+
+        /** \brief The bytes. */
+        std::vector<Byte> data;
+
+        /** \brief True if the change of the ended operation is covered by the running operation's one. */
+        bool isSuperseded;
+
+    }; // struct Change
+
+    typedef std::list<Change> ChangesList;
+
+    typedef std::multimap<ULong, ChangesList::iterator> ChangesIndex;
+
+protected:
+
+    /** \brief Replays the complete records of the log to the file and empties the log. */
+    void replayLog();
+
+    /** \brief Empties the log. */
+    void truncateLog();
+
+    /** \brief Drops the changes kept in the memory. */
+    void clearChanges();
+
+    /** \brief Drops the change \c change. */
+    void eraseChange(ChangesList::iterator change);
+
+    /** \brief Returns the checksum of \c sz bytes in \c data. */
+    static UInt getChecksum(const Byte* data, ULong sz);
+
+protected:
+
+    /** \brief The log's file descriptor, -1 if the log is closed. */
+    int _logFd;
+
+    /** \brief The log size. */
+    ULong _logSize;
+
+    /** \brief The file size, the bytes beyond it are only in the changes. */
+    ULong _fileSize;
+
+    /** \brief The changes in the writing order, a page written again replaces its previous change. */
+    ChangesList _changes;
+
+    /** \brief The changes by their offsets. */
+    ChangesIndex _changesIndex;
+
+    /** \brief The max size of the kept changes. */
+    UInt _maxChangeSize;
+
+    /** \brief The next change's number. */
+    ULong _nextSeqNum;
+
+    /** \brief The number of the running operation's first change. */
+    ULong _operationSeqNum;
+
+    /** \brief The changes of the ended operations covered by the running operation's changes.
+     *
+     *  They are dropped at the operation's end, so the failed operation's changes are dropped alone.
+     */
+    std::vector<ChangesList::iterator> _supersededChanges;
+
+    /** \brief The count of the operations ended since the last commit. */
+    UInt _pendingOperations;
+
+    /** \brief The count of the operations committed together. */
+    UInt _groupSize;
+
+    /** \brief The log size which causes the checkpoint. */
+    ULong _checkpointLogSize;
+
+    /** \brief The commits count. */
+    UInt _commitsCount;
+
+    /** \brief The checkpoints count. */
+    UInt _checkpointsCount;
+
+    /** \brief The count of the log records replayed by the last open(). */
+    UInt _replayedRecordsCount;
+
+}; // class WalPageStore
+
+} // namespace btree
+
+#endif // BTREE_WITH_POSIX_IO
+
+#endif // BTREE_WALPAGESTORE_H_
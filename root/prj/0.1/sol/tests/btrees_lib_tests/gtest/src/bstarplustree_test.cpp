@@ -10,6 +10,8 @@
 
 #include <gtest-fus/gtest.h>
 
+#include <random>
+#include <set>
 
 #include "individual.h"
 #include "btree.h"
@@ -417,6 +419,54 @@ TEST_F(BStarPlusTreeTest, InsertS8)
     }
 }
 
+TEST_F(BStarPlusTreeTest, RangeScan1)
+{
+    std::string& fn = getFn("RangeScan1.xibt");
+
+    ByteComparator comparator;
+    FileBaseBTree bt(BaseBTree::TreeType::B_STAR_PLUS_TREE, ORDER, 1, &comparator, fn);
+
+    // The keys from 0 to 99 are inserted twice, the key 50 is inserted 40 times more.
+    for (int rep = 0; rep < 2; ++rep)
+        for (int i = 0; i < 100; ++i)
+        {
+            Byte k = (Byte)((i * 37) % 100);
+            bt.insert(&k);
+        }
+
+    for (int i = 0; i < 40; ++i)
+    {
+        Byte k = 50;
+        bt.insert(&k);
+    }
+
+    std::list<Byte*> keys;
+    Byte lo = 10;
+    Byte hi = 20;
+    EXPECT_EQ(22, bt.searchRange(&lo, &hi, keys));
+    int n = 0;
+    for (std::list<Byte*>::iterator iter = keys.begin(); iter != keys.end(); ++iter, ++n)
+        EXPECT_EQ(lo + n / 2, **iter);
+    clearKeysList(keys);
+
+    lo = 0;
+    hi = 255;
+    EXPECT_EQ(240, bt.searchRange(&lo, &hi, keys));
+    clearKeysList(keys);
+
+    lo = 30;
+    hi = 29;
+    EXPECT_EQ(0, bt.searchRange(&lo, &hi, keys));
+
+    // The duplicates are found by one descent and the following walk through the chained leaves.
+    Byte k = 50;
+    BaseBTree* tree = bt.getTree();
+    tree->resetDiskOperationsCount();
+    EXPECT_EQ(42, bt.searchAll(&k, keys));
+    clearKeysList(keys);
+    EXPECT_TRUE(tree->getDiskOperationsCount() <= tree->getMaxSearchDepth() + 42 / tree->getMinNodeKeys(true) + 2);
+}
+
 #ifdef BTREE_WITH_REUSING_FREE_PAGES
 
 TEST_F(BStarPlusTreeTest, Reusing1)
@@ -932,6 +982,53 @@ TEST_F(BStarPlusTreeTest, Remove8)
     }
 }
 
+TEST_F(BStarPlusTreeTest, RandomRemoves1)
+{
+    std::string& fn = getFn("RandomRemoves1.xibt");
+
+    ByteComparator comparator;
+
+    // The removals refill the leaves and the inner nodes from their siblings and merge three of them into two,
+    // the routers of the removed max keys are replaced, so the duplicates are found after them.
+    const int orders[] = { 4, 7, 20 };
+    for (int order : orders)
+        for (unsigned int seed = 1; seed <= 10; ++seed)
+        {
+            FileBaseBTree bt(BaseBTree::TreeType::B_STAR_PLUS_TREE, order, 1, &comparator, fn);
+            std::multiset<Byte> reference;
+
+            std::mt19937 random(seed);
+            for (int op = 0; op < 3000; ++op)
+            {
+                Byte k = (Byte)(random() % 200);
+                if (random() % 100 < 60)
+                {
+                    bt.insert(&k);
+                    reference.insert(k);
+                }
+                else
+                {
+                    std::multiset<Byte>::iterator found = reference.find(k);
+                    ASSERT_EQ(found != reference.end(), bt.remove(&k));
+                    if (found != reference.end())
+                        reference.erase(found);
+                }
+
+                Byte searched = (Byte)(random() % 200);
+                Byte result;
+                ASSERT_EQ(reference.count(searched) != 0, bt.search(&searched, &result));
+            }
+
+            for (int k = 0; k < 200; ++k)
+            {
+                Byte key = (Byte)k;
+                std::list<Byte*> keys;
+                EXPECT_EQ((int)reference.count(key), bt.searchAll(&key, keys));
+                clearKeysList(keys);
+            }
+        }
+}
+
 #ifdef BTREE_WITH_REUSING_FREE_PAGES
 
 TEST_F(BStarPlusTreeTest, RemoveAndReuse1)
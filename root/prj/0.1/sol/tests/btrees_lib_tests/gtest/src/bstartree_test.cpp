@@ -10,6 +10,8 @@
 
 #include <gtest-fus/gtest.h>
 
+#include <random>
+#include <set>
 
 #include "individual.h"
 #include "btree.h"
@@ -836,6 +838,53 @@ TEST_F(BStarTreeTest, Remove7)
     }
 }
 
+TEST_F(BStarTreeTest, RandomRemoves1)
+{
+    std::string& fn = getFn("RandomRemoves1.xibt");
+
+    ByteComparator comparator;
+
+    // The removals refill the children from their siblings and merge them, the tree must keep the same keys
+    // as the reference multiset after each operation.
+    const int orders[] = { 4, 7, 20 };
+    for (int order : orders)
+        for (unsigned int seed = 1; seed <= 10; ++seed)
+        {
+            FileBaseBTree bt(BaseBTree::TreeType::B_STAR_TREE, order, 1, &comparator, fn);
+            std::multiset<Byte> reference;
+
+            std::mt19937 random(seed);
+            for (int op = 0; op < 3000; ++op)
+            {
+                Byte k = (Byte)(random() % 200);
+                if (random() % 100 < 60)
+                {
+                    bt.insert(&k);
+                    reference.insert(k);
+                }
+                else
+                {
+                    std::multiset<Byte>::iterator found = reference.find(k);
+                    ASSERT_EQ(found != reference.end(), bt.remove(&k));
+                    if (found != reference.end())
+                        reference.erase(found);
+                }
+
+                Byte searched = (Byte)(random() % 200);
+                Byte result;
+                ASSERT_EQ(reference.count(searched) != 0, bt.search(&searched, &result));
+            }
+
+            for (int k = 0; k < 200; ++k)
+            {
+                Byte key = (Byte)k;
+                std::list<Byte*> keys;
+                EXPECT_EQ((int)reference.count(key), bt.searchAll(&key, keys));
+                clearKeysList(keys);
+            }
+        }
+}
+
 #ifdef BTREE_WITH_REUSING_FREE_PAGES
 
 TEST_F(BStarTreeTest, RemoveAndReuse1)
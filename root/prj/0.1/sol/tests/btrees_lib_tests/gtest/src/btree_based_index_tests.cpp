@@ -366,3 +366,141 @@ TEST_F(BTreeBasedIndexTest, DISABLED_IndexerWithDifferentParamsAndAggregatesTest
             L"1e consult poliklinisch", 1136
     );
 }
+
+TEST_F(BTreeBasedIndexTest, ParallelIndexerTest1)
+{
+    std::string fileName = TEST_FILES_PATH + std::string("Parallel_index.csv");
+    std::string treeFileName = TEST_FILES_PATH + std::string("BTree_Parallel_index.xibt");
+    std::ofstream file(fileName, std::ios_base::binary);
+    for (int i = 0; i < 2000; ++i)
+        file << (char)('A' + i % 20) << "name;" << i << "\n";
+    file.close();
+
+    btree::Indexer indexer;
+    indexer.create(ORDER, treeFileName);
+    indexer.indexFile(fileName, 4);
+
+    std::list<std::wstring> occurrences = indexer.findAllOccurrences(L"Cname", fileName);
+    EXPECT_EQ(100, occurrences.size());
+    for (std::list<std::wstring>::iterator iter = occurrences.begin(); iter != occurrences.end(); ++iter)
+        EXPECT_EQ(L"Cname;", iter->substr(0, 6));
+
+    // The keys are inserted into the tree which is not empty.
+    indexer.indexFile(fileName, 3);
+    EXPECT_EQ(200, indexer.findAllOccurrences(L"Tname", fileName).size());
+
+    indexer.close();
+    std::remove(fileName.c_str());
+    std::remove(treeFileName.c_str());
+}
+
+TEST_F(BTreeBasedIndexTest, ScannedIndexerTest1)
+{
+    // "Имя" in UTF-8.
+    const std::string utf8Name = "\xD0\x98\xD0\xBC\xD1\x8F";
+
+    std::string fileName = TEST_FILES_PATH + std::string("Scanned_index.csv");
+    std::string treeFileName = TEST_FILES_PATH + std::string("BTree_Scanned_index.xibt");
+    std::ofstream file(fileName, std::ios_base::binary);
+    for (int i = 0; i < 2000; ++i)
+        file << (char)('A' + i % 20) << "name;" << i << "\n";
+    file << utf8Name << ";2000";
+    file.close();
+
+    Indexer::Key decoded(utf8Name.data(), utf8Name.data() + utf8Name.size(), 5);
+    Indexer::Key constructed(L"Имя", 5);
+    Indexer::NameComparator comparator;
+    EXPECT_TRUE(comparator.isEqual((const Byte*) &decoded, (const Byte*) &constructed, sizeof(Indexer::Key)));
+    EXPECT_EQ(5, decoded.offset);
+
+    btree::Indexer indexer;
+    indexer.create(ORDER, treeFileName);
+    indexer.indexFile(fileName);
+
+    std::list<std::wstring> occurrences = indexer.findAllOccurrences(L"Cname", fileName);
+    EXPECT_EQ(100, occurrences.size());
+    for (std::list<std::wstring>::iterator iter = occurrences.begin(); iter != occurrences.end(); ++iter)
+        EXPECT_EQ(L"Cname;", iter->substr(0, 6));
+
+    // The last line has no line's end.
+    Indexer::OffsetsCollector collector;
+    EXPECT_EQ(1, indexer.getTree()->getTree()->searchAll((const Byte*) &constructed, collector));
+    ASSERT_EQ(1, collector.offsets.size());
+
+    std::ifstream check(fileName, std::ios_base::binary);
+    check.seekg(collector.offsets[0]);
+    std::string line;
+    std::getline(check, line);
+    EXPECT_EQ(utf8Name + ";2000", line);
+    check.close();
+
+    indexer.close();
+    std::remove(fileName.c_str());
+    std::remove(treeFileName.c_str());
+}
+
+TEST_F(BTreeBasedIndexTest, OccurrencesBufferTest1)
+{
+    std::string fileName = TEST_FILES_PATH + std::string("Occurrences_buffer.csv");
+    std::string treeFileName = TEST_FILES_PATH + std::string("BPlusTree_Occurrences_buffer.xibt");
+    std::ofstream file(fileName, std::ios_base::binary);
+    for (int i = 0; i < 2000; ++i)
+        file << (char)('A' + i % 20) << "name;" << i << "\n";
+    file << "\xD0\x98\xD0\xBC\xD1\x8F;2000";
+    file.close();
+
+    btree::Indexer indexer;
+    indexer.create(BaseBTree::B_PLUS_TREE, ORDER, treeFileName);
+    indexer.indexFile(fileName, 2);
+
+    // The lines are in the file's order.
+    Indexer::Occurrences occurrences;
+    indexer.findAllOccurrences(L"Cname", fileName, occurrences);
+    ASSERT_EQ(100, occurrences.size());
+    for (size_t i = 0; i < occurrences.size(); ++i)
+        EXPECT_EQ("Cname;" + std::to_string(i * 20 + 2), std::string(occurrences.getLine(i), occurrences.getLineLength(i)));
+
+    indexer.findAllOccurrences(L"Zname", fileName, occurrences);
+    EXPECT_EQ(0, occurrences.size());
+
+    std::list<std::wstring> lines = indexer.findAllOccurrences(L"Имя", fileName);
+    ASSERT_EQ(1, lines.size());
+    EXPECT_EQ(L"Имя;2000", lines.front());
+
+    indexer.close();
+    std::remove(fileName.c_str());
+    std::remove(treeFileName.c_str());
+}
+
+TEST_F(BTreeBasedIndexTest, CompactKeysTest1)
+{
+    EXPECT_EQ(Indexer::NAME_LENGTH + sizeof(ULong), sizeof(Indexer::Key));
+
+    Indexer::NameComparator comparator;
+    Indexer::Key shorter(L"Ab");
+    Indexer::Key longer(L"Abc");
+    EXPECT_TRUE(comparator.compare((const Byte*) &shorter, (const Byte*) &longer, sizeof(Indexer::Key)));
+    EXPECT_FALSE(comparator.compare((const Byte*) &longer, (const Byte*) &shorter, sizeof(Indexer::Key)));
+
+    // The names differing in their last characters or beyond the stored length.
+    std::string tail(50, 'x');
+    std::string fileName = TEST_FILES_PATH + std::string("Compact_keys.csv");
+    std::string treeFileName = TEST_FILES_PATH + std::string("BStarTree_Compact_keys.xibt");
+    std::ofstream file(fileName, std::ios_base::binary);
+    for (int i = 0; i < 300; ++i)
+        file << "Name" << (char)('a' + i % 3) << ";" << i << "\n" << "Long" << tail << i % 2 << ";" << i << "\n";
+    file.close();
+
+    btree::Indexer indexer;
+    indexer.create(BaseBTree::B_STAR_TREE, ORDER, treeFileName);
+    indexer.indexFile(fileName);
+
+    EXPECT_EQ(100, indexer.findAllOccurrences(L"Namea", fileName).size());
+    EXPECT_EQ(100, indexer.findAllOccurrences(L"Namec", fileName).size());
+    EXPECT_EQ(0, indexer.findAllOccurrences(L"Name", fileName).size());
+    EXPECT_EQ(300, indexer.findAllOccurrences(L"Long" + std::wstring(tail.begin(), tail.end()), fileName).size());
+
+    indexer.close();
+    std::remove(fileName.c_str());
+    std::remove(treeFileName.c_str());
+}
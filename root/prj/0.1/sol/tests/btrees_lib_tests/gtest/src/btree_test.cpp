@@ -10,6 +10,14 @@
 
 #include <gtest-fus/gtest.h>
 
+#include <algorithm>
+#include <fstream>
+#include <limits>
+#include <map>
+#include <sstream>
+#include <thread>
+#include <vector>
+
 
 #include "individual.h"
 #include "btree.h"
@@ -262,6 +270,998 @@ TEST_F(BTreeTest, InsertS3)
     }
 }
 
+TEST_F(BTreeTest, BufferPool1)
+{
+    std::string& fn = getFn("BufferPool1.xibt");
+
+    ByteComparator comparator;
+
+    {
+        FileBaseBTree bt(ORDER, 1, &comparator, fn);
+        bt.getTree()->setBufferPoolCapacity(4);
+        EXPECT_EQ(4, bt.getTree()->getBufferPoolCapacity());
+
+        for (Byte k = 0x01; k <= 0x28; ++k)
+            bt.insert(&k);
+
+        EXPECT_TRUE(bt.getTree()->getBufferPool()->getPagesCount() <= 4);
+        EXPECT_TRUE(bt.getTree()->getBufferPool()->getEvictionsCount() > 0);
+
+        bt.getTree()->resetBufferPoolCounters();
+        for (Byte k = 0x01; k <= 0x28; ++k)
+        {
+            Byte* searched = bt.search(&k);
+            EXPECT_TRUE(searched != nullptr);
+            delete[] searched;
+        }
+
+        // The root page is always hot.
+        EXPECT_TRUE(bt.getTree()->getBufferPoolHitsCount() > 0);
+    }
+
+    // Dirty pages should have been written back on close.
+    FileBaseBTree bt(fn, &comparator);
+    EXPECT_TRUE(bt.getTree()->getBufferPool() == nullptr);
+    for (Byte k = 0x01; k <= 0x28; ++k)
+    {
+        Byte* searched = bt.search(&k);
+        EXPECT_TRUE(searched != nullptr);
+        delete[] searched;
+    }
+}
+
+TEST_F(BTreeTest, BufferPool2)
+{
+    std::string& fn = getFn("BufferPool2.xibt");
+
+    ByteComparator comparator;
+    FileBaseBTree bt(ORDER, 1, &comparator, fn);
+
+    UInt pageSize = bt.getTree()->getNodePageSize();
+    bt.getTree()->setBufferPoolBudget(pageSize * 3 + 1);
+    EXPECT_EQ(3, bt.getTree()->getBufferPoolCapacity());
+
+    // The budget less than one page still gives one page.
+    bt.getTree()->setBufferPoolBudget(1);
+    EXPECT_EQ(1, bt.getTree()->getBufferPoolCapacity());
+
+    bt.getTree()->setBufferPoolCapacity(0);
+    EXPECT_TRUE(bt.getTree()->getBufferPool() == nullptr);
+}
+
+#ifdef BTREE_WITH_MMAP
+
+TEST_F(BTreeTest, MappedFile1)
+{
+    std::string& fn = getFn("MappedFile1.xibt");
+
+    ByteComparator comparator;
+
+    {
+        FileBaseBTree bt(BaseBTree::TreeType::B_TREE, ORDER, 1, &comparator, fn, FileBaseBTree::MEMORY_MAPPED);
+        EXPECT_EQ(FileBaseBTree::MEMORY_MAPPED, bt.getStorageType());
+
+        for (Byte k = 0x01; k <= 0x28; ++k)
+            bt.insert(&k);
+
+        Byte k = 0x05;
+        bt.insert(&k);
+
+        for (Byte k = 0x01; k <= 0x28; ++k)
+        {
+            Byte* searched = bt.search(&k);
+            EXPECT_TRUE(searched != nullptr);
+            EXPECT_EQ(k, *searched);
+            delete[] searched;
+        }
+
+        std::list<Byte*> keys;
+        EXPECT_EQ(2, bt.searchAll(&k, keys));
+        clearKeysList(keys);
+    }
+
+    // The mapped file has the same format as the stream one.
+    FileBaseBTree bt(fn, &comparator);
+    for (Byte k = 0x01; k <= 0x28; ++k)
+    {
+        Byte* searched = bt.search(&k);
+        EXPECT_TRUE(searched != nullptr);
+        delete[] searched;
+    }
+
+    Byte k = 0x29;
+    bt.insert(&k);
+    bt.close();
+
+    bt.setStorageType(FileBaseBTree::MEMORY_MAPPED);
+    bt.getTree()->setComparator(&comparator);
+    bt.open(fn);
+    for (Byte k = 0x01; k <= 0x29; ++k)
+    {
+        Byte* searched = bt.search(&k);
+        EXPECT_TRUE(searched != nullptr);
+        delete[] searched;
+    }
+
+    k = 0x30;
+    EXPECT_TRUE(bt.search(&k) == nullptr);
+}
+
+TEST_F(BTreeTest, MappedFile2)
+{
+    std::string& fn = getFn("MappedFile2.xibt");
+
+    ByteComparator comparator;
+    FileBaseBTree bt(BaseBTree::TreeType::B_TREE, ORDER, 1, &comparator, fn, FileBaseBTree::MEMORY_MAPPED);
+
+    // Views are disabled while the buffer pool is on, so the searches go through the pool.
+    bt.getTree()->setBufferPoolCapacity(2);
+    for (Byte k = 0x01; k <= 0x10; ++k)
+        bt.insert(&k);
+
+    bt.getTree()->resetBufferPoolCounters();
+    for (Byte k = 0x01; k <= 0x10; ++k)
+    {
+        Byte* searched = bt.search(&k);
+        EXPECT_TRUE(searched != nullptr);
+        delete[] searched;
+    }
+
+    EXPECT_TRUE(bt.getTree()->getBufferPoolHitsCount() + bt.getTree()->getBufferPoolMissesCount() > 0);
+
+    EXPECT_THROW(bt.setStorageType(FileBaseBTree::STREAM), std::runtime_error);
+}
+
+#endif // BTREE_WITH_MMAP
+
+TEST_F(BTreeTest, BinarySearch1)
+{
+    std::string& fn = getFn("BinarySearch1.xibt");
+
+    ByteComparator comparator;
+
+    // The nodes are long enough for the binary search inside them.
+    const BaseBTree::TreeType treeTypes[] = { BaseBTree::TreeType::B_TREE, BaseBTree::TreeType::B_PLUS_TREE,
+            BaseBTree::TreeType::B_STAR_TREE, BaseBTree::TreeType::B_STAR_PLUS_TREE };
+    for (BaseBTree::TreeType treeType : treeTypes)
+    {
+        FileBaseBTree bt(treeType, 20, 1, &comparator, fn);
+
+        for (int rep = 0; rep < 3; ++rep)
+            for (int i = 0; i < 200; ++i)
+            {
+                Byte k = (Byte)((i * 37 + rep) % 200);
+                bt.insert(&k);
+            }
+
+        std::list<Byte*> keys;
+        for (int i = 0; i < 200; ++i)
+        {
+            Byte k = (Byte)i;
+            Byte* searched = bt.search(&k);
+            EXPECT_TRUE(searched != nullptr);
+            delete[] searched;
+
+            EXPECT_EQ(3, bt.searchAll(&k, keys));
+            clearKeysList(keys);
+        }
+
+        Byte k = 200;
+        EXPECT_TRUE(bt.search(&k) == nullptr);
+
+#ifdef BTREE_WITH_DELETION
+
+        for (int i = 0; i < 200; i += 2)
+        {
+            k = (Byte)i;
+            EXPECT_TRUE(bt.remove(&k));
+        }
+
+        for (int i = 0; i < 200; ++i)
+        {
+            k = (Byte)i;
+            EXPECT_EQ(i % 2 == 0 ? 2 : 3, bt.searchAll(&k, keys));
+            clearKeysList(keys);
+        }
+
+#endif
+
+    }
+}
+
+/** \brief Counts the visited keys and checks their order. */
+struct CountingVisitor : public BaseBTree::IKeyVisitor {
+
+    CountingVisitor() : count(0), last(0), isSorted(true) { }
+
+    virtual void visit(const Byte* k) override
+    {
+        if (count > 0 && *k < last)
+            isSorted = false;
+
+        last = *k;
+        ++count;
+    }
+
+    int count;
+
+    Byte last;
+
+    bool isSorted;
+
+}; // struct CountingVisitor
+
+TEST_F(BTreeTest, SearchVisitor1)
+{
+    std::string& fn = getFn("SearchVisitor1.xibt");
+
+    ByteComparator comparator;
+
+    const BaseBTree::TreeType treeTypes[] = { BaseBTree::TreeType::B_TREE, BaseBTree::TreeType::B_PLUS_TREE,
+            BaseBTree::TreeType::B_STAR_TREE, BaseBTree::TreeType::B_STAR_PLUS_TREE };
+    for (BaseBTree::TreeType treeType : treeTypes)
+    {
+        FileBaseBTree bt(treeType, 20, 1, &comparator, fn);
+
+        // Each key is repeated 50 times, so its occurrences fill several nodes.
+        for (int rep = 0; rep < 50; ++rep)
+            for (int i = 0; i < 100; ++i)
+            {
+                Byte k = (Byte)((i * 37 + rep) % 100);
+                bt.insert(&k);
+            }
+
+        Byte k = 42;
+        Byte result = 0;
+        EXPECT_TRUE(bt.search(&k, &result));
+        EXPECT_EQ(42, result);
+
+        k = 100;
+        EXPECT_FALSE(bt.search(&k, &result));
+
+        // The keys are appended one after another without reallocations of the reserved memory.
+        std::vector<Byte> keys;
+        keys.reserve(50);
+        const Byte* data = keys.data();
+        k = 7;
+        EXPECT_EQ(50, bt.getTree()->searchAll(&k, keys));
+        ASSERT_EQ(50, keys.size());
+        EXPECT_EQ(data, keys.data());
+        EXPECT_EQ(50, std::count(keys.begin(), keys.end(), 7));
+
+        CountingVisitor visitor;
+        EXPECT_EQ(50, bt.searchAll(&k, visitor));
+        EXPECT_EQ(50, visitor.count);
+
+        Byte lo = 10;
+        Byte hi = 19;
+        CountingVisitor rangeVisitor;
+        EXPECT_EQ(500, bt.searchRange(&lo, &hi, rangeVisitor));
+        EXPECT_EQ(500, rangeVisitor.count);
+        EXPECT_TRUE(rangeVisitor.isSorted);
+
+        keys.clear();
+        EXPECT_EQ(500, bt.getTree()->searchRange(&lo, &hi, keys));
+        EXPECT_TRUE(std::is_sorted(keys.begin(), keys.end()));
+        EXPECT_EQ(10, keys.front());
+        EXPECT_EQ(19, keys.back());
+    }
+}
+
+TEST_F(BTreeTest, PageBuffers1)
+{
+    std::string& fn = getFn("PageBuffers1.xibt");
+
+    ByteComparator comparator;
+
+    const BaseBTree::TreeType treeTypes[] = { BaseBTree::TreeType::B_TREE, BaseBTree::TreeType::B_PLUS_TREE,
+            BaseBTree::TreeType::B_STAR_TREE, BaseBTree::TreeType::B_STAR_PLUS_TREE };
+    for (BaseBTree::TreeType treeType : treeTypes)
+    {
+        FileBaseBTree bt(treeType, 4, 1, &comparator, fn);
+
+        for (int rep = 0; rep < 5; ++rep)
+            for (int i = 0; i < 100; ++i)
+            {
+                Byte k = (Byte)((i * 37 + rep) % 100);
+                bt.insert(&k);
+            }
+
+        // The wrappers of the operations borrow the buffers released by the previous ones.
+        BaseBTree* tree = bt.getTree();
+        tree->resetPageBuffersCounters();
+
+        std::list<Byte*> keys;
+        for (int i = 0; i < 100; ++i)
+        {
+            Byte k = (Byte)i;
+            EXPECT_EQ(5, bt.searchAll(&k, keys));
+            clearKeysList(keys);
+
+            bt.insert(&k);
+        }
+
+        EXPECT_EQ(0, tree->getPageBuffersAllocsCount());
+        EXPECT_LT(0, tree->getPageBuffersReusesCount());
+
+        for (int i = 0; i < 100; ++i)
+        {
+            Byte k = (Byte)i;
+            EXPECT_EQ(6, bt.searchAll(&k, keys));
+            clearKeysList(keys);
+        }
+    }
+}
+
+TEST_F(BTreeTest, ConcurrentSearch1)
+{
+    std::string& fn = getFn("ConcurrentSearch1.xibt");
+
+    ByteComparator comparator;
+
+    FileBaseBTree bt(BaseBTree::TreeType::B_TREE, ORDER, 1, &comparator, fn);
+    bt.getTree()->setBufferPoolCapacity(4);
+
+    for (int i = 0; i < 100; i += 2)
+    {
+        Byte k = (Byte)i;
+        bt.insert(&k);
+    }
+
+    // The readers search the even keys while the writer inserts the odd ones.
+    const int READERS_COUNT = 4;
+    std::vector<int> foundCounts(READERS_COUNT, 0);
+    std::vector<UInt> maxDepths(READERS_COUNT, 0);
+    std::vector<std::thread> readers;
+    for (int r = 0; r < READERS_COUNT; ++r)
+        readers.push_back(std::thread([&bt, &foundCounts, &maxDepths, r]
+        {
+            Byte result;
+            for (int pass = 0; pass < 20; ++pass)
+                for (int i = 0; i < 100; i += 2)
+                {
+                    Byte k = (Byte)i;
+                    if (bt.getTree()->search(&k, &result) && result == k)
+                        ++foundCounts[r];
+
+                    maxDepths[r] = std::max(maxDepths[r], bt.getTree()->getMaxSearchDepth());
+                }
+        }));
+
+    for (int i = 1; i < 100; i += 2)
+    {
+        Byte k = (Byte)i;
+        bt.insert(&k);
+    }
+
+    for (std::vector<std::thread>::iterator iter = readers.begin(); iter != readers.end(); ++iter)
+        iter->join();
+
+    for (int r = 0; r < READERS_COUNT; ++r)
+    {
+        EXPECT_EQ(20 * 50, foundCounts[r]);
+        EXPECT_LT(1, maxDepths[r]);
+    }
+
+    // The search depth is kept per thread, so the readers didn't change the main thread's one.
+    EXPECT_EQ(0, bt.getTree()->getMaxSearchDepth());
+
+    for (int i = 0; i < 100; ++i)
+    {
+        Byte k = (Byte)i;
+        Byte* searched = bt.search(&k);
+        EXPECT_TRUE(searched != nullptr);
+        delete[] searched;
+    }
+}
+
+#ifdef BTREE_WITH_POSIX_IO
+
+TEST_F(BTreeTest, PositionalIO1)
+{
+    std::string& fn = getFn("PositionalIO1.xibt");
+
+    ByteComparator comparator;
+
+    {
+        FileBaseBTree bt(BaseBTree::TreeType::B_TREE, ORDER, 1, &comparator, fn, FileBaseBTree::POSITIONAL);
+        EXPECT_EQ(FileBaseBTree::POSITIONAL, bt.getStorageType());
+
+        for (Byte k = 0x01; k <= 0x28; ++k)
+            bt.insert(&k);
+
+        Byte k = 0x05;
+        EXPECT_TRUE(bt.remove(&k));
+
+        for (Byte k = 0x01; k <= 0x28; ++k)
+        {
+            Byte* searched = bt.search(&k);
+            EXPECT_EQ(k != 0x05, searched != nullptr);
+            delete[] searched;
+        }
+
+        EXPECT_THROW(bt.setStorageType(FileBaseBTree::STREAM), std::runtime_error);
+    }
+
+    // The file has the same format as the stream one.
+    FileBaseBTree bt(fn, &comparator);
+    for (Byte k = 0x01; k <= 0x28; ++k)
+    {
+        Byte* searched = bt.search(&k);
+        EXPECT_EQ(k != 0x05, searched != nullptr);
+        delete[] searched;
+    }
+
+    Byte k = 0x29;
+    bt.insert(&k);
+    bt.close();
+
+    bt.setStorageType(FileBaseBTree::POSITIONAL);
+    bt.getTree()->setComparator(&comparator);
+    bt.open(fn);
+    for (Byte k = 0x06; k <= 0x29; ++k)
+    {
+        Byte* searched = bt.search(&k);
+        EXPECT_TRUE(searched != nullptr);
+        delete[] searched;
+    }
+
+    k = 0x30;
+    EXPECT_TRUE(bt.search(&k) == nullptr);
+}
+
+void copyFile(const std::string& from, const std::string& to)
+{
+    std::ifstream src(from, std::ios_base::binary);
+    std::ofstream dst(to, std::ios_base::binary | std::ios_base::trunc);
+    dst << src.rdbuf();
+}
+
+TEST_F(BTreeTest, WriteAheadLog1)
+{
+    std::string fn = getFn("WriteAheadLog1.xibt");
+    std::string crashFn = getFn("WriteAheadLog1Crash.xibt");
+
+    ByteComparator comparator;
+
+    {
+        FileBaseBTree bt(BaseBTree::TreeType::B_TREE, ORDER, 1, &comparator, fn, FileBaseBTree::WRITE_AHEAD_LOG);
+        WalPageStore& store = bt.getWalStore();
+        store.setCheckpointLogSize(std::numeric_limits<ULong>::max());
+
+        // The empty tree is committed by the creation.
+        EXPECT_EQ(1, store.getCommitsCount());
+
+        for (Byte k = 0x01; k <= 0x10; ++k)
+            bt.insert(&k);
+
+        EXPECT_EQ(1, store.getCommitsCount());
+        bt.getTree()->sync();
+        EXPECT_EQ(2, store.getCommitsCount());
+        EXPECT_EQ(0, store.getLogSize());
+
+        // The crash copy has the checkpointed file and the log of the following groups.
+        copyFile(fn, crashFn);
+
+        store.setGroupSize(4);
+        for (Byte k = 0x11; k <= 0x28; ++k)
+            bt.insert(&k);
+
+        EXPECT_EQ(8, store.getCommitsCount());
+        EXPECT_LT(0, store.getLogSize());
+
+        // The operation of the incomplete group is not in the log.
+        Byte k = 0x29;
+        bt.insert(&k);
+        EXPECT_EQ(8, store.getCommitsCount());
+
+        std::string logFn = WalPageStore::getLogFileName(fn);
+        std::string crashLogFn = WalPageStore::getLogFileName(crashFn);
+        copyFile(logFn, crashLogFn);
+
+        // The torn record written by the crash is ignored.
+        std::ifstream log(logFn, std::ios_base::binary);
+        char tail[10];
+        log.read(tail, sizeof(tail));
+        std::ofstream crashLog(crashLogFn, std::ios_base::binary | std::ios_base::app);
+        crashLog.write(tail, sizeof(tail));
+    }
+
+    {
+        // The file alone doesn't have the logged groups.
+        FileBaseBTree bt(BaseBTree::TreeType::B_TREE, crashFn, &comparator, FileBaseBTree::POSITIONAL);
+        Byte k = 0x28;
+        EXPECT_TRUE(bt.search(&k) == nullptr);
+    }
+
+    FileBaseBTree bt(BaseBTree::TreeType::B_TREE, crashFn, &comparator, FileBaseBTree::WRITE_AHEAD_LOG);
+    EXPECT_EQ(6, bt.getWalStore().getReplayedRecordsCount());
+    EXPECT_EQ(0, bt.getWalStore().getLogSize());
+
+    for (Byte k = 0x01; k <= 0x28; ++k)
+    {
+        Byte* searched = bt.search(&k);
+        EXPECT_TRUE(searched != nullptr);
+        delete[] searched;
+    }
+
+    Byte k = 0x29;
+    EXPECT_TRUE(bt.search(&k) == nullptr);
+}
+
+/** \brief The comparator which fails when the given count of the comparisons is done. */
+struct FailingComparator : public ByteComparator {
+    FailingComparator() : comparisonsLeft(-1) { }
+
+    virtual bool compare(const Byte* lhv, const Byte* rhv, UInt sz) override
+    {
+        if (comparisonsLeft >= 0 && comparisonsLeft-- == 0)
+            throw std::runtime_error("Comparison failed");
+
+        return ByteComparator::compare(lhv, rhv, sz);
+    }
+
+    int comparisonsLeft;
+}; // struct FailingComparator
+
+TEST_F(BTreeTest, WriteAheadLog2)
+{
+    std::string fn = getFn("WriteAheadLog2.xibt");
+    std::string crashFn = getFn("WriteAheadLog2Crash.xibt");
+
+    FailingComparator comparator;
+
+    {
+        FileBaseBTree bt(BaseBTree::TreeType::B_TREE, ORDER, 1, &comparator, fn, FileBaseBTree::WRITE_AHEAD_LOG);
+        WalPageStore& store = bt.getWalStore();
+        store.setCheckpointLogSize(std::numeric_limits<ULong>::max());
+
+        for (Byte k = 0x01; k <= 0x02; ++k)
+            bt.insert(&k);
+
+        // The ended operations are durable after the barrier only.
+        EXPECT_EQ(1, store.getCommitsCount());
+        bt.getTree()->commit();
+        EXPECT_EQ(2, store.getCommitsCount());
+
+        Byte k = 0x03;
+        bt.insert(&k);
+
+        // The full root is split by the failed insertion before its first comparison.
+        UInt rootPageNum = bt.getTree()->getRootPageNum();
+        UInt lastPageNum = bt.getTree()->getLastPageNum();
+        comparator.comparisonsLeft = 0;
+        k = 0x04;
+        EXPECT_THROW(bt.insert(&k), std::runtime_error);
+        comparator.comparisonsLeft = -1;
+
+        EXPECT_EQ(rootPageNum, bt.getTree()->getRootPageNum());
+        EXPECT_EQ(lastPageNum, bt.getTree()->getLastPageNum());
+
+        // The ended operation's changes are committed without the failed one's.
+        bt.getTree()->commit();
+        EXPECT_EQ(3, store.getCommitsCount());
+
+        copyFile(fn, crashFn);
+        copyFile(WalPageStore::getLogFileName(fn), WalPageStore::getLogFileName(crashFn));
+
+        k = 0x04;
+        bt.insert(&k);
+    }
+
+    FileBaseBTree bt(BaseBTree::TreeType::B_TREE, crashFn, &comparator, FileBaseBTree::WRITE_AHEAD_LOG);
+    for (Byte k = 0x01; k <= 0x03; ++k)
+    {
+        Byte* searched = bt.search(&k);
+        EXPECT_TRUE(searched != nullptr);
+        delete[] searched;
+    }
+
+    Byte k = 0x04;
+    EXPECT_TRUE(bt.search(&k) == nullptr);
+}
+
+#endif // BTREE_WITH_POSIX_IO
+
+struct MemoryPageIO : public IPageIO {
+    MemoryPageIO() : readsCount(0), writesCount(0) { }
+
+    virtual void read(UInt pnum, Byte* dst) override
+    {
+        ++readsCount;
+        *dst = pages[pnum];
+    }
+
+    virtual void write(UInt pnum, const Byte* src) override
+    {
+        ++writesCount;
+        pages[pnum] = *src;
+    }
+
+    std::map<UInt, Byte> pages;
+    UInt readsCount;
+    UInt writesCount;
+}; // struct MemoryPageIO
+
+TEST_F(BTreeTest, BufferPool3)
+{
+    MemoryPageIO io;
+    io.pages[1] = 0x01;
+    io.pages[2] = 0x02;
+    io.pages[3] = 0x03;
+
+    BufferPool pool(&io, 1, 2);
+
+    Byte* p1 = pool.pin(1);
+    EXPECT_EQ(0x01, *p1);
+    Byte* p2 = pool.pin(2);
+    EXPECT_EQ(0x02, *p2);
+
+    // All the frames are pinned.
+    EXPECT_THROW(pool.pin(3), std::runtime_error);
+
+    *p1 = 0x11;
+    pool.unpin(1, true);
+    EXPECT_THROW(pool.unpin(1), std::invalid_argument);
+
+    // Page 1 is the only unpinned one, so it is evicted and written back.
+    Byte* p3 = pool.pin(3);
+    EXPECT_EQ(0x03, *p3);
+    EXPECT_EQ(0x11, io.pages[1]);
+    EXPECT_EQ(1, pool.getEvictionsCount());
+    EXPECT_EQ(1, pool.getWriteBacksCount());
+
+    pool.unpin(2);
+    pool.unpin(3);
+
+    Byte b;
+    pool.read(3, &b);
+    EXPECT_EQ(0x03, b);
+    EXPECT_EQ(1, pool.getHitsCount());
+    EXPECT_EQ(3, pool.getMissesCount());
+    EXPECT_EQ(3, io.readsCount);
+
+    b = 0x33;
+    pool.write(3, &b);
+    EXPECT_EQ(0x03, io.pages[3]);
+    pool.flush();
+    EXPECT_EQ(0x33, io.pages[3]);
+    EXPECT_EQ(2, io.writesCount);
+}
+
+/** \brief The pages' storage, which fails to read the missing pages. */
+struct FailingPageIO : public MemoryPageIO {
+    virtual void read(UInt pnum, Byte* dst) override
+    {
+        if (pages.find(pnum) == pages.end())
+            throw std::runtime_error("Can't read the page");
+
+        MemoryPageIO::read(pnum, dst);
+    }
+}; // struct FailingPageIO
+
+TEST_F(BTreeTest, BufferPool4)
+{
+    FailingPageIO io;
+    io.pages[1] = 0x01;
+    io.pages[2] = 0x02;
+
+    BufferPool pool(&io, 1, 2);
+
+    Byte* p1 = pool.pin(1);
+    EXPECT_EQ(0x01, *p1);
+
+    // The frames taken for the pages that failed to be read are reused.
+    Byte b;
+    EXPECT_THROW(pool.read(9, &b), std::runtime_error);
+    EXPECT_THROW(pool.pin(9), std::runtime_error);
+    EXPECT_EQ(1, pool.getPagesCount());
+
+    Byte* p2 = pool.pin(2);
+    EXPECT_EQ(0x02, *p2);
+
+    pool.unpin(1);
+    pool.unpin(2);
+}
+
+TEST_F(BTreeTest, PageStore1)
+{
+    std::stringstream stream(std::ios_base::in | std::ios_base::out | std::ios_base::binary);
+    StreamPageStore store(&stream);
+
+    // The header area goes first, the string stream can't be written with a gap.
+    Byte header[16] = { 0 };
+    store.writeHeader(0, header, sizeof(header));
+    store.create(8, 16, 4);
+
+    UInt page = 0x11111111;
+    EXPECT_EQ(1, store.alloc((Byte*)&page));
+    page = 0x22222222;
+    EXPECT_EQ(2, store.alloc((Byte*)&page));
+    page = 0x33333333;
+    EXPECT_EQ(3, store.alloc((Byte*)&page));
+
+    store.free(2);
+    store.free(3);
+    EXPECT_EQ(2, store.getFreePagesCount());
+    EXPECT_EQ(16 + 3 * 4 + 4 + 2 * 4, store.getSize());
+    EXPECT_THROW(store.free(4), std::invalid_argument);
+
+    // The counters are stored along with the pages.
+    StreamPageStore loaded(&stream);
+    loaded.load(8, 16, 4);
+    EXPECT_EQ(3, loaded.getLastPageNum());
+    EXPECT_EQ(2, loaded.getFreePagesCount());
+
+    loaded.read(1, (Byte*)&page);
+    EXPECT_EQ(0x11111111, page);
+
+    // The last freed page is reused first.
+    page = 0x44444444;
+    EXPECT_EQ(3, loaded.alloc((Byte*)&page));
+    EXPECT_EQ(2, loaded.alloc((Byte*)&page));
+    EXPECT_EQ(4, loaded.alloc((Byte*)&page));
+    EXPECT_EQ(0, loaded.getFreePagesCount());
+
+    loaded.read(3, (Byte*)&page);
+    EXPECT_EQ(0x44444444, page);
+}
+
+TEST_F(BTreeTest, StreamTree1)
+{
+    std::string& fn = getFn("StreamTree1.xibt");
+    std::fstream stream(fn, std::ios_base::in | std::ios_base::out | std::ios_base::binary | std::ios_base::trunc);
+    ByteComparator comparator;
+
+    // The trees constructed from a stream wrap it into their own page store.
+    BaseBPlusTree bt(0, 0, &comparator, &stream);
+    ASSERT_TRUE(bt.getStore() != nullptr);
+    bt.createTree(4, 1);
+
+    for (Byte k = 0x01; k <= 0x28; ++k)
+        bt.insert(&k);
+    bt.flushBufferPool();
+
+    BaseBPlusTree loadedTree(&comparator, &stream);
+    BaseBTree& loaded = loadedTree;
+    loaded.loadTree();
+
+    std::list<Byte*> keys;
+    for (Byte k = 0x01; k <= 0x28; ++k)
+    {
+        EXPECT_EQ(1, loaded.searchAll(&k, keys));
+        clearKeysList(keys);
+    }
+
+    // The stream can be replaced, the tree keeps its page store.
+    std::stringstream other;
+    IPageStore* store = loaded.getStore();
+    loaded.setStream(&other);
+    EXPECT_EQ(store, loaded.getStore());
+    EXPECT_EQ(&other, ((StreamPageStore*)store)->getStream());
+}
+
+TEST_F(BTreeTest, MemoryPageStore1)
+{
+    ByteComparator comparator;
+    MemoryPageStore store;
+
+    BaseBTree bt(0, 0, &comparator, &store);
+    bt.createTree(ORDER, 1);
+
+    for (Byte k = 0x01; k <= 0x28; ++k)
+        bt.insert(&k);
+
+    // The searches view the stored pages without copying.
+    for (Byte k = 0x01; k <= 0x28; ++k)
+    {
+        Byte* searched = bt.search(&k);
+        EXPECT_TRUE(searched != nullptr);
+        EXPECT_EQ(k, *searched);
+        delete[] searched;
+    }
+
+    Byte k = 0x30;
+    EXPECT_TRUE(bt.search(&k) == nullptr);
+
+    BaseBTree loaded(&comparator, &store);
+    loaded.loadTree();
+    EXPECT_EQ(bt.getLastPageNum(), loaded.getLastPageNum());
+    EXPECT_EQ(bt.getRootPageNum(), loaded.getRootPageNum());
+
+    std::list<Byte*> keys;
+    for (Byte k = 0x01; k <= 0x28; ++k)
+    {
+        EXPECT_EQ(1, loaded.searchAll(&k, keys));
+        clearKeysList(keys);
+    }
+}
+
+template <typename Tree>
+void checkUnchainedLeaves(BTreeTest& test)
+{
+    // The least order of the B*+-tree, so the leaves are short.
+    const UShort order = 4;
+
+    ByteComparator comparator;
+    MemoryPageStore store;
+
+    Tree tree(0, 0, &comparator, &store);
+    BaseBTree& bt = tree;
+    bt.createTree(order, 1);
+
+    BaseBTree::Header hdr;
+    store.readHeader(BaseBTree::HEADER_OFS, (Byte*)&hdr, BaseBTree::HEADER_SIZE);
+    EXPECT_EQ((UInt)BaseBTree::Header::CHAINED_SIGN, hdr.sign);
+
+    for (int i = 0; i < 5; ++i)
+        for (Byte k = 0x01; k <= 0x0A; ++k)
+            bt.insert(&k);
+
+    // The files written before the leaves' links have the old signature and zeros in place of the links.
+    BaseBTree::PageWrapper page(&bt);
+    for (UInt pnum = 1; pnum <= bt.getLastPageNum(); ++pnum)
+    {
+        page.readPage(pnum);
+        if (page.isLeaf())
+        {
+            page.setNextLeaf(0);
+            page.writePage();
+        }
+    }
+
+    hdr = BaseBTree::Header(order, 1);
+    store.writeHeader(BaseBTree::HEADER_OFS, (const Byte*)&hdr, BaseBTree::HEADER_SIZE);
+
+    Tree loadedTree(&comparator, &store);
+    BaseBTree& loaded = loadedTree;
+    loaded.loadTree();
+
+    std::list<Byte*> keys;
+    for (Byte k = 0x01; k <= 0x0A; ++k)
+    {
+        EXPECT_EQ(5, loaded.searchAll(&k, keys));
+        test.clearKeysList(keys);
+    }
+
+    Byte lo = 0x01;
+    Byte hi = 0x0A;
+    ASSERT_EQ(50, loaded.searchRange(&lo, &hi, keys));
+    int i = 0;
+    for (Byte* key : keys)
+        EXPECT_EQ(i++ / 5 + 1, *key);
+    test.clearKeysList(keys);
+
+    // The leaves split after the loading are linked, but the old ones are not, so the file keeps its signature.
+    for (Byte k = 0x01; k <= 0x0A; ++k)
+        loaded.insert(&k);
+
+    for (Byte k = 0x01; k <= 0x0A; ++k)
+    {
+        EXPECT_EQ(6, loaded.searchAll(&k, keys));
+        test.clearKeysList(keys);
+    }
+
+    store.readHeader(BaseBTree::HEADER_OFS, (Byte*)&hdr, BaseBTree::HEADER_SIZE);
+    EXPECT_EQ((UInt)BaseBTree::Header::VALID_SIGN, hdr.sign);
+}
+
+TEST_F(BTreeTest, UnchainedLeaves1)
+{
+    checkUnchainedLeaves<BaseBPlusTree>(*this);
+    checkUnchainedLeaves<BaseBStarPlusTree>(*this);
+}
+
+TEST_F(BTreeTest, CopyOnWrite1)
+{
+    ByteComparator comparator;
+    MemoryPageStore store;
+
+    BaseBTree bt(0, 0, &comparator, &store);
+    bt.createTree(ORDER, 1);
+    EXPECT_THROW(BaseBTree::Snapshot snapshot(&bt), std::logic_error);
+
+    bt.setCopyOnWrite(true);
+    for (Byte k = 0x01; k <= 0x20; ++k)
+        bt.insert(&k);
+
+    EXPECT_EQ(0x20, bt.getVersion());
+
+    BaseBTree::Snapshot* snapshot = new BaseBTree::Snapshot(&bt);
+    UInt rootPageNum = bt.getRootPageNum();
+    EXPECT_THROW(bt.setCopyOnWrite(false), std::logic_error);
+
+    for (Byte k = 0x21; k <= 0x40; ++k)
+        bt.insert(&k);
+
+    for (Byte k = 0x01; k <= 0x10; ++k)
+        EXPECT_TRUE(bt.remove(&k));
+
+    // Each operation publishes the new root, the snapshot still reads the pages of its version.
+    EXPECT_NE(rootPageNum, bt.getRootPageNum());
+    EXPECT_EQ(rootPageNum, snapshot->getRootPageNum());
+    EXPECT_LT(0, bt.getRetiredPagesCount());
+
+    Byte result;
+    for (Byte k = 0x01; k <= 0x40; ++k)
+    {
+        EXPECT_EQ(k <= 0x20, snapshot->search(&k, &result));
+        EXPECT_EQ(k > 0x10, bt.search(&k, &result));
+    }
+
+    // The replaced pages are reused when the snapshot is gone.
+    delete snapshot;
+    EXPECT_EQ(0, bt.getRetiredPagesCount());
+
+    UInt lastPageNum = bt.getLastPageNum();
+    for (Byte k = 0x41; k <= 0x50; ++k)
+    {
+        bt.insert(&k);
+        EXPECT_TRUE(bt.remove(&k));
+    }
+
+    EXPECT_EQ(lastPageNum, bt.getLastPageNum());
+
+    // The interrupted operation leaves the published version.
+    rootPageNum = bt.getRootPageNum();
+    UInt version = bt.getVersion();
+    bt.setComparator(nullptr);
+    Byte k = 0x60;
+    EXPECT_THROW(bt.insert(&k), std::runtime_error);
+    bt.setComparator(&comparator);
+
+    EXPECT_EQ(rootPageNum, bt.getRootPageNum());
+    EXPECT_EQ(version, bt.getVersion());
+    for (Byte k = 0x11; k <= 0x40; ++k)
+        EXPECT_TRUE(bt.search(&k, &result));
+
+    // The copy of a leaf would need the copies of the leaves linked to it.
+    BaseBPlusTree plusTree(0, 0, &comparator, &store);
+    EXPECT_THROW(plusTree.setCopyOnWrite(true), std::logic_error);
+}
+
+TEST_F(BTreeTest, CopyOnWrite2)
+{
+    ByteComparator comparator;
+
+    // The copy-on-write mode is supported by the B-tree and the B*-tree, whose leaves are not chained.
+    MemoryPageStore plusStore;
+    BaseBPlusTree plusTree(&comparator, &plusStore);
+    EXPECT_THROW(plusTree.setCopyOnWrite(true), std::logic_error);
+
+    MemoryPageStore starPlusStore;
+    BaseBStarPlusTree starPlusTree(&comparator, &starPlusStore);
+    EXPECT_THROW(starPlusTree.setCopyOnWrite(true), std::logic_error);
+    EXPECT_FALSE(starPlusTree.isCopyOnWrite());
+
+    MemoryPageStore store;
+    BaseBStarTree starTree(&comparator, &store);
+    BaseBTree& bt = starTree;
+    bt.createTree(4, 1);
+
+    // The latch coupling and the copy-on-write mode exclude each other.
+    bt.setLatchCoupling(true);
+    EXPECT_THROW(bt.setCopyOnWrite(true), std::logic_error);
+    bt.setLatchCoupling(false);
+
+    bt.setCopyOnWrite(true);
+    EXPECT_THROW(bt.setLatchCoupling(true), std::logic_error);
+
+    for (Byte k = 0x01; k <= 0x20; ++k)
+        bt.insert(&k);
+
+    BaseBTree::Snapshot snapshot(&bt);
+    for (Byte k = 0x01; k <= 0x10; ++k)
+        EXPECT_TRUE(bt.remove(&k));
+
+    Byte result;
+    for (Byte k = 0x01; k <= 0x20; ++k)
+    {
+        EXPECT_TRUE(snapshot.search(&k, &result));
+        EXPECT_EQ(k > 0x10, bt.search(&k, &result));
+    }
+}
+
 #ifdef BTREE_WITH_REUSING_FREE_PAGES
 
 TEST_F(BTreeTest, Reusing1)
@@ -0,0 +1,823 @@
+/// \file
+/// \brief     Typed B-tree test.
+/// \authors   Anton Rigin
+/// \version   0.1.0
+/// \date      16.10.2026
+///
+////////////////////////////////////////////////////////////////////////////////
+
+#include <gtest-fus/gtest.h>
+
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#include <iterator>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+
+#include "typedbtree.h"
+
+using namespace btree;
+
+class TypedBTreeTest : public ::testing::Test {
+
+public:
+
+    /**
+     * The typed trees' order, the nodes are long enough for the binary search inside them.
+     */
+    static const int ORDER = 20;
+
+}; // class TypedBTreeTest
+
+struct Point {
+    UInt x;
+    UShort y;
+}; // struct Point
+
+struct PointLess {
+    bool operator() (const Point& lhv, const Point& rhv) const
+    {
+        return lhv.x < rhv.x || (lhv.x == rhv.x && lhv.y < rhv.y);
+    }
+}; // struct PointLess
+
+template <BaseBTree::TreeType treeType>
+void checkIntTree()
+{
+    MemoryPageStore store;
+    BTree<int, std::less<int>, treeType> bt(&store);
+    bt.create(TypedBTreeTest::ORDER);
+
+    for (int rep = 0; rep < 2; ++rep)
+        for (int i = 0; i < 500; ++i)
+            bt.insert((i * 37) % 500 - 250);
+
+    std::vector<int> keys;
+    for (int k = -250; k < 250; ++k)
+    {
+        int result = 0;
+        EXPECT_TRUE(bt.search(k, result));
+        EXPECT_EQ(k, result);
+
+        keys.clear();
+        EXPECT_EQ(2, bt.searchAll(k, keys));
+        EXPECT_EQ(2, (int)keys.size());
+    }
+
+    int result;
+    EXPECT_FALSE(bt.search(250, result));
+    EXPECT_FALSE(bt.search(-251, result));
+
+#ifdef BTREE_WITH_DELETION
+
+    for (int k = -250; k < 250; k += 2)
+        EXPECT_TRUE(bt.remove(k));
+
+    for (int k = -250; k < 250; ++k)
+    {
+        keys.clear();
+        EXPECT_EQ(k % 2 == 0 ? 1 : 2, bt.searchAll(k, keys));
+    }
+
+    for (int k = -250; k < 250; k += 3)
+        EXPECT_EQ(k % 2 == 0 ? 1 : 2, bt.removeAll(k));
+
+    for (int k = -250; k < 250; ++k)
+    {
+        keys.clear();
+        EXPECT_EQ((k + 250) % 3 == 0 ? 0 : k % 2 == 0 ? 1 : 2, bt.searchAll(k, keys));
+    }
+
+    EXPECT_EQ(0, bt.removeAll(250));
+
+#endif
+
+}
+
+TEST_F(TypedBTreeTest, Int1)
+{
+    checkIntTree<BaseBTree::B_TREE>();
+    checkIntTree<BaseBTree::B_PLUS_TREE>();
+    checkIntTree<BaseBTree::B_STAR_TREE>();
+    checkIntTree<BaseBTree::B_STAR_PLUS_TREE>();
+}
+
+TEST_F(TypedBTreeTest, Struct1)
+{
+    MemoryPageStore store;
+    BTree<Point, PointLess, BaseBTree::B_STAR_PLUS_TREE> bt(&store);
+    bt.create(ORDER);
+
+    for (UInt x = 0; x < 50; ++x)
+        for (UShort y = 0; y < 10; ++y)
+        {
+            Point p = { (x * 7) % 50, (UShort)((y * 3) % 10) };
+            bt.insert(p);
+        }
+
+    for (UInt x = 0; x < 50; ++x)
+        for (UShort y = 0; y < 10; ++y)
+        {
+            Point p = { x, y };
+            Point result;
+            EXPECT_TRUE(bt.search(p, result));
+            EXPECT_EQ(x, result.x);
+            EXPECT_EQ(y, result.y);
+        }
+
+    Point p = { 50, 0 };
+    Point result;
+    EXPECT_FALSE(bt.search(p, result));
+}
+
+struct IntComparator : public BaseBTree::IComparator {
+    virtual bool compare(const Byte* lhv, const Byte* rhv, UInt sz) override
+    {
+        return TypedComparator<int>::load(lhv) < TypedComparator<int>::load(rhv);
+    }
+
+    virtual bool isEqual(const Byte* lhv, const Byte* rhv, UInt sz) override
+    {
+        return TypedComparator<int>::load(lhv) == TypedComparator<int>::load(rhv);
+    }
+}; // struct IntComparator
+
+TEST_F(TypedBTreeTest, Untyped1)
+{
+    MemoryPageStore store;
+
+    {
+        BTree<int, std::less<int>, BaseBTree::B_PLUS_TREE> bt(&store);
+        bt.create(ORDER);
+
+        for (int i = 0; i < 300; ++i)
+            bt.insert((i * 37) % 300);
+    }
+
+    // The typed tree has the same pages format as the untyped one.
+    IntComparator comparator;
+    BaseBPlusTree untyped(&comparator, &store);
+    BaseBTree& bt = untyped;
+    bt.loadTree();
+    EXPECT_EQ(sizeof(int), bt.getRecSize());
+
+    for (int k = 0; k < 300; ++k)
+    {
+        Byte* searched = bt.search((const Byte*)&k);
+        EXPECT_TRUE(searched != nullptr);
+        delete[] searched;
+    }
+
+    int k = 300;
+    bt.insert((const Byte*)&k);
+
+    BTree<int, std::less<int>, BaseBTree::B_PLUS_TREE> typed(&store);
+    typed.load();
+    int result;
+    EXPECT_TRUE(typed.search(300, result));
+
+    BTree<long long> wrongSize(&store);
+    EXPECT_THROW(wrongSize.load(), std::invalid_argument);
+}
+
+template <typename Int>
+void checkKeySearch(UShort (*lowerBound)(const Byte*, UShort, Int), UShort (*upperBound)(const Byte*, UShort, Int),
+        Int minKey, Int maxKey)
+{
+    // The keys in the pages are not aligned, as they follow the node's info.
+    std::vector<Byte> buffer(2 + 300 * sizeof(Int));
+    Byte* keys = &buffer[2];
+
+    for (UShort num = 0; num <= 300; num += (num < 40 ? 1 : 37))
+    {
+        std::vector<Int> sorted;
+        for (UShort i = 0; i < num; ++i)
+            sorted.push_back((Int)((i * 7919) % 101) * 3 - 150);
+        if (num > 2)
+        {
+            sorted[0] = minKey;
+            sorted[1] = maxKey;
+        }
+        std::sort(sorted.begin(), sorted.end());
+        if (num > 0)
+            memcpy(keys, &sorted[0], num * sizeof(Int));
+
+        std::vector<Int> searched = { minKey, maxKey, 0, -150, -149, 150, 151, 1000 };
+        for (Int key : searched)
+        {
+            EXPECT_EQ(std::lower_bound(sorted.begin(), sorted.end(), key) - sorted.begin(),
+                    lowerBound(keys, num, key));
+            EXPECT_EQ(std::upper_bound(sorted.begin(), sorted.end(), key) - sorted.begin(),
+                    upperBound(keys, num, key));
+        }
+    }
+}
+
+TEST_F(TypedBTreeTest, KeySearch1)
+{
+    KeySearchKernel bestKernel = getKeySearchKernel();
+
+    const KeySearchKernel kernels[] = { SCALAR_KERNEL, SSE_KERNEL, AVX2_KERNEL };
+    for (KeySearchKernel kernel : kernels)
+    {
+        // The kernels unsupported by the processor are replaced by the best supported one.
+        EXPECT_EQ(std::min(kernel, bestKernel), setKeySearchKernel(kernel));
+
+        checkKeySearch<std::int32_t>(lowerBoundInt32, upperBoundInt32, INT_MIN, INT_MAX);
+        checkKeySearch<std::int64_t>(lowerBoundInt64, upperBoundInt64, LLONG_MIN, LLONG_MAX);
+
+        MemoryPageStore store;
+        BTree<long long> bt(&store);
+        bt.create(ORDER);
+        for (long long i = 0; i < 500; ++i)
+            bt.insert(((i * 37) % 500) << 33);
+
+        for (long long i = 0; i < 500; ++i)
+        {
+            long long result;
+            EXPECT_TRUE(bt.search(i << 33, result));
+            EXPECT_FALSE(bt.search((i << 33) + 1, result));
+        }
+    }
+
+    setKeySearchKernel(bestKernel);
+}
+
+template <BaseBTree::TreeType treeType>
+void checkBulkLoad(int keysCount, double fillFactor)
+{
+    // Each key is repeated 3 times, so the duplicates get into the neighbour nodes.
+    std::vector<int> sorted;
+    for (int i = 0; i < keysCount; ++i)
+        sorted.push_back(i / 3);
+
+    MemoryPageStore store;
+    BTree<int, std::less<int>, treeType> bt(&store);
+    bt.create(TypedBTreeTest::ORDER);
+
+    BulkLoader loader(&bt, sorted.size(), fillFactor);
+    for (size_t i = 0; i < sorted.size(); ++i)
+        loader.add((const Byte*)&sorted[i]);
+    loader.finish();
+
+    // Each node is written once, the root in place of the empty one.
+    UInt nodes = 0;
+    for (UInt level = 0; level < loader.getLevelsCount(); ++level)
+        nodes += loader.getNodesCount(level);
+    EXPECT_EQ(nodes, bt.getLastPageNum());
+
+    std::vector<int> keys;
+    for (int k = 0; k * 3 < keysCount; ++k)
+    {
+        keys.clear();
+        EXPECT_EQ(std::min(3, keysCount - k * 3), bt.searchAll(k, keys));
+    }
+
+    int result;
+    EXPECT_FALSE(bt.search(-1, result));
+    EXPECT_FALSE(bt.search((keysCount + 2) / 3, result));
+
+    // The range crosses the leaves, which are chained by the loader in the B+- and B*+-trees.
+    int lo = keysCount / 6;
+    int hi = keysCount / 3;
+    keys.clear();
+    EXPECT_EQ(std::min(keysCount, 3 * (hi + 1)) - std::min(keysCount, 3 * lo), bt.searchRange(lo, hi, keys));
+    EXPECT_TRUE(std::is_sorted(keys.begin(), keys.end()));
+
+    // The loaded tree is modified as usual.
+    for (int k = -10; k < keysCount / 3 + 10; ++k)
+        bt.insert(k);
+
+    for (int k = 0; k * 3 < keysCount; ++k)
+    {
+        keys.clear();
+        EXPECT_EQ(std::min(3, keysCount - k * 3) + 1, bt.searchAll(k, keys));
+    }
+
+    EXPECT_TRUE(bt.search(-10, result));
+}
+
+template <BaseBTree::TreeType treeType>
+void checkBulkLoad()
+{
+    const int counts[] = { 0, 1, 20, 41, 1000, 5000 };
+    const double fillFactors[] = { 1.0, 0.75, 0.5, 0.01 };
+
+    for (int keysCount : counts)
+        for (double fillFactor : fillFactors)
+            checkBulkLoad<treeType>(keysCount, fillFactor);
+}
+
+TEST_F(TypedBTreeTest, BulkLoad1)
+{
+    checkBulkLoad<BaseBTree::B_TREE>();
+    checkBulkLoad<BaseBTree::B_PLUS_TREE>();
+    checkBulkLoad<BaseBTree::B_STAR_TREE>();
+    checkBulkLoad<BaseBTree::B_STAR_PLUS_TREE>();
+}
+
+TEST_F(TypedBTreeTest, BulkLoad2)
+{
+    MemoryPageStore store;
+    BTree<int, std::less<int>, BaseBTree::B_PLUS_TREE> bt(&store);
+    bt.create(ORDER);
+
+    // The full nodes of the order 20 B+-tree: 40 keys in the leaves and 39 in the inner nodes.
+    std::vector<int> sorted;
+    for (int i = 0; i < 40 * 40; ++i)
+        sorted.push_back(i);
+
+    BulkLoader loader(&bt, sorted.size());
+    EXPECT_EQ(2, loader.getLevelsCount());
+    EXPECT_EQ(40, loader.getNodesCount(0));
+    EXPECT_EQ(1, loader.getNodesCount(1));
+
+    int k = 1;
+    loader.add((const Byte*)&k);
+    k = 0;
+    EXPECT_THROW(loader.add((const Byte*)&k), std::invalid_argument);
+    EXPECT_THROW(loader.finish(), std::runtime_error);
+
+    EXPECT_THROW(BulkLoader(&bt, 10, 0.0), std::invalid_argument);
+    EXPECT_THROW(BulkLoader(&bt, 10, 1.5), std::invalid_argument);
+
+    bt.insert(0);
+    EXPECT_THROW(bt.bulkLoad(sorted.begin(), sorted.end()), std::invalid_argument);
+
+    // The loader links the leaves to the reused free pages.
+    MemoryPageStore store3;
+    BTree<int, std::less<int>, BaseBTree::B_STAR_PLUS_TREE> bt3(&store3);
+    bt3.create(ORDER);
+    std::vector<Byte> page(bt3.getNodePageSize());
+    for (int i = 0; i < 10; ++i)
+        store3.alloc(&page[0]);
+    for (UInt pnum = 2; pnum <= 11; pnum += 3)
+        store3.free(pnum);
+
+    bt3.bulkLoad(sorted.begin(), sorted.end(), 0.9);
+    EXPECT_EQ(0, store3.getFreePagesCount());
+
+    std::vector<int> keys;
+    ASSERT_EQ(40 * 40, bt3.searchRange(0, 40 * 40, keys));
+    for (int i = 0; i < 40 * 40; ++i)
+        EXPECT_EQ(i, keys[i]);
+
+    // The removing is checked in the B-tree, as the B+- and B*-trees' removing fails even after inserts.
+    MemoryPageStore store2;
+    BTree<int> bt2(&store2);
+    bt2.create(ORDER);
+    bt2.bulkLoad(sorted.begin(), sorted.end(), 0.8);
+
+    for (int i = 0; i < 40 * 40; ++i)
+    {
+        int result;
+        EXPECT_TRUE(bt2.search(i, result));
+        EXPECT_EQ(i, result);
+    }
+
+#ifdef BTREE_WITH_DELETION
+
+    for (int i = 0; i < 40 * 40; i += 2)
+        EXPECT_TRUE(bt2.remove(i));
+
+    for (int i = 0; i < 40 * 40; ++i)
+    {
+        int result;
+        EXPECT_EQ(i % 2 != 0, bt2.search(i, result));
+    }
+
+#endif
+
+}
+
+TEST_F(TypedBTreeTest, BulkLoad3)
+{
+    // The single-pass stream is loaded with the keys count given, the key after them stays unread.
+    std::ostringstream out;
+    for (int i = 0; i < 1000; ++i)
+        out << i * 2 << ' ';
+    out << -1;
+
+    std::istringstream in(out.str());
+
+    MemoryPageStore store;
+    BTree<int, std::less<int>, BaseBTree::B_PLUS_TREE> bt(&store);
+    bt.create(ORDER);
+    bt.bulkLoad(std::istream_iterator<int>(in), 1000, 0.7);
+
+    int rest;
+    ASSERT_TRUE((bool)(in >> rest));
+    EXPECT_EQ(-1, rest);
+
+    for (int i = 0; i < 2000; ++i)
+    {
+        int result;
+        EXPECT_EQ(i % 2 == 0, bt.search(i, result));
+    }
+
+    std::vector<int> keys;
+    ASSERT_EQ(1000, bt.searchRange(0, 2000, keys));
+    for (int i = 0; i < 1000; ++i)
+        EXPECT_EQ(i * 2, keys[i]);
+}
+
+template <BaseBTree::TreeType treeType>
+void checkCursor()
+{
+    MemoryPageStore store;
+    BTree<int, std::less<int>, treeType> bt(&store);
+    bt.create(TypedBTreeTest::ORDER);
+
+    TypedTreeCursor<int> cursor(&bt);
+    EXPECT_FALSE(cursor.seekFirst());
+    EXPECT_FALSE(cursor.seekLast());
+    EXPECT_FALSE(cursor.seek(0));
+    EXPECT_FALSE(cursor.isValid());
+    EXPECT_FALSE(cursor.next());
+
+    // Even keys from 0 to 1998, each of them twice.
+    std::vector<int> sorted;
+    for (int rep = 0; rep < 2; ++rep)
+        for (int i = 0; i < 1000; ++i)
+        {
+            bt.insert(((i * 37) % 1000) * 2);
+            sorted.push_back(i * 2);
+        }
+    std::sort(sorted.begin(), sorted.end());
+
+    // Each page is read once by the forward walk.
+    bt.resetDiskOperationsCount();
+    std::vector<int> keys;
+    for (bool valid = cursor.seekFirst(); valid; valid = cursor.next())
+        keys.push_back(cursor.getKey());
+    EXPECT_TRUE(keys == sorted);
+    EXPECT_FALSE(cursor.isValid());
+    EXPECT_TRUE(bt.getDiskOperationsCount() <= bt.getLastPageNum());
+
+    keys.clear();
+    for (bool valid = cursor.seekLast(); valid; valid = cursor.prev())
+        keys.push_back(cursor.getKey());
+    std::reverse(keys.begin(), keys.end());
+    EXPECT_TRUE(keys == sorted);
+
+    for (int k = -1; k <= 1999; ++k)
+    {
+        bool found = cursor.seek(k);
+        EXPECT_EQ(k <= 1998, found);
+        if (!found)
+            continue;
+
+        int expected = k < 0 ? 0 : (k + 1) / 2 * 2;
+        EXPECT_EQ(expected, cursor.getKey());
+
+        // The first duplicate is found.
+        if (cursor.prev())
+            EXPECT_EQ(expected - 2, cursor.getKey());
+    }
+
+    // The pages of 100 keys, each one starts after the last key of the previous one.
+    int last = 499;
+    for (int page = 0; page < 5; ++page)
+    {
+        ASSERT_TRUE(cursor.seek(last + 1));
+        for (int i = 0; i < 100; ++i)
+        {
+            EXPECT_EQ(500 + page * 100 + (i / 2) * 2, cursor.getKey());
+            last = cursor.getKey();
+            ASSERT_TRUE(cursor.next());
+        }
+        EXPECT_TRUE(cursor.prev());
+        EXPECT_EQ(last, cursor.getKey());
+    }
+
+    // Walking back and forth around the current key.
+    ASSERT_TRUE(cursor.seek(1000));
+    for (int i = 0; i < 300; ++i)
+        ASSERT_TRUE(cursor.next());
+    for (int i = 0; i < 600; ++i)
+        ASSERT_TRUE(cursor.prev());
+    for (int i = 0; i < 300; ++i)
+        ASSERT_TRUE(cursor.next());
+    EXPECT_EQ(1000, cursor.getKey());
+
+    cursor.reset();
+    EXPECT_FALSE(cursor.isValid());
+}
+
+TEST_F(TypedBTreeTest, Cursor1)
+{
+    checkCursor<BaseBTree::B_TREE>();
+    checkCursor<BaseBTree::B_PLUS_TREE>();
+    checkCursor<BaseBTree::B_STAR_TREE>();
+    checkCursor<BaseBTree::B_STAR_PLUS_TREE>();
+}
+
+template <BaseBTree::TreeType treeType>
+void checkDescent(bool checkRemove)
+{
+    MemoryPageStore store;
+    BTree<int, std::less<int>, treeType> bt(&store);
+
+    // The smallest order gives the highest tree.
+    bt.create(treeType == BaseBTree::B_TREE || treeType == BaseBTree::B_PLUS_TREE ? 2 : 4);
+
+    const int keysCount = 20000;
+    for (int i = 0; i < keysCount; ++i)
+        bt.insert((i * 7919) % keysCount);
+
+    int result;
+    for (int k = 0; k < keysCount; ++k)
+        EXPECT_TRUE(bt.search(k, result));
+
+    // The descents reuse a few wrappers per level.
+    UInt height = bt.getMaxSearchDepth();
+    EXPECT_LT(5u, height);
+    EXPECT_GE(8 * height, bt.getPathPagesCount());
+
+#ifdef BTREE_WITH_DELETION
+
+    if (!checkRemove)
+        return;
+
+    for (int k = 0; k < keysCount; k += 2)
+        EXPECT_TRUE(bt.remove(k));
+
+    for (int k = 0; k < keysCount; ++k)
+        EXPECT_EQ(k % 2 != 0, bt.search(k, result));
+
+    EXPECT_GE(8 * height, bt.getPathPagesCount());
+
+#endif
+
+}
+
+TEST_F(TypedBTreeTest, Descent1)
+{
+    // The removing is checked in the B-tree, as the other trees' removing loses keys at this size.
+    checkDescent<BaseBTree::B_TREE>(true);
+    checkDescent<BaseBTree::B_PLUS_TREE>(false);
+    checkDescent<BaseBTree::B_STAR_TREE>(false);
+    checkDescent<BaseBTree::B_STAR_PLUS_TREE>(false);
+}
+
+template <BaseBTree::TreeType treeType>
+void checkLatchCoupling(bool checkRemove)
+{
+    MemoryPageStore store;
+    BTree<int, std::less<int>, treeType> bt(&store);
+    bt.create(treeType == BaseBTree::B_TREE || treeType == BaseBTree::B_PLUS_TREE ? 2 : 4);
+    bt.setLatchCoupling(true);
+    bt.setBufferPoolCapacity(16);
+
+    for (int k = -1000; k < 0; ++k)
+        bt.insert(k);
+
+    // The writers insert into the disjoint key ranges while the readers search the preloaded keys.
+    const int WRITERS_COUNT = 4;
+    const int RANGE_SIZE = 2000;
+    std::vector<int> foundCounts(2, 0);
+    std::vector<std::thread> threads;
+    for (int w = 0; w < WRITERS_COUNT; ++w)
+        threads.push_back(std::thread([&bt, w]
+        {
+            for (int i = 0; i < RANGE_SIZE; ++i)
+                bt.insert(w * RANGE_SIZE + (i * 7919) % RANGE_SIZE);
+        }));
+
+    for (int r = 0; r < 2; ++r)
+        threads.push_back(std::thread([&bt, &foundCounts, r]
+        {
+            int result;
+            for (int k = -1000; k < 0; ++k)
+                if (bt.search(k, result) && result == k)
+                    ++foundCounts[r];
+        }));
+
+    for (std::vector<std::thread>::iterator iter = threads.begin(); iter != threads.end(); ++iter)
+        iter->join();
+
+    EXPECT_EQ(1000, foundCounts[0]);
+    EXPECT_EQ(1000, foundCounts[1]);
+    EXPECT_EQ(0u, bt.getPageLatchesCount());
+
+    int result;
+    for (int k = -1000; k < WRITERS_COUNT * RANGE_SIZE; ++k)
+        EXPECT_TRUE(bt.search(k, result));
+
+#ifdef BTREE_WITH_DELETION
+
+    if (!checkRemove)
+        return;
+
+    threads.clear();
+    for (int w = 0; w < WRITERS_COUNT; ++w)
+        threads.push_back(std::thread([&bt, w]
+        {
+            for (int i = 0; i < RANGE_SIZE; i += 2)
+                bt.remove(w * RANGE_SIZE + i);
+        }));
+
+    for (std::vector<std::thread>::iterator iter = threads.begin(); iter != threads.end(); ++iter)
+        iter->join();
+
+    EXPECT_EQ(0u, bt.getPageLatchesCount());
+
+    for (int k = 0; k < WRITERS_COUNT * RANGE_SIZE; ++k)
+        EXPECT_EQ(k % 2 != 0, bt.search(k, result));
+
+#endif
+
+}
+
+TEST_F(TypedBTreeTest, LatchCoupling1)
+{
+    // The removing is checked in the B-tree, as the other trees' removing loses keys at this size.
+    checkLatchCoupling<BaseBTree::B_TREE>(true);
+    checkLatchCoupling<BaseBTree::B_PLUS_TREE>(false);
+    checkLatchCoupling<BaseBTree::B_STAR_TREE>(false);
+    checkLatchCoupling<BaseBTree::B_STAR_PLUS_TREE>(false);
+}
+
+template <BaseBTree::TreeType treeType>
+void checkOptimisticSearch()
+{
+    MemoryPageStore store;
+    BTree<int, std::less<int>, treeType> bt(&store);
+    bt.create(treeType == BaseBTree::B_TREE || treeType == BaseBTree::B_PLUS_TREE ? 2 : 4);
+    bt.setLatchCoupling(true);
+    bt.setOptimisticSearch(true);
+    bt.setBufferPoolCapacity(16);
+
+    for (int k = -500; k < 0; ++k)
+    {
+        bt.insert(k);
+        bt.insert(k);
+    }
+
+    // The readers check the preloaded keys while the writers modify the pages they pass.
+    const int WRITERS_COUNT = 4;
+    const int RANGE_SIZE = 2000;
+    std::vector<int> foundCounts(6, 0);
+    std::vector<std::thread> threads;
+    for (int w = 0; w < WRITERS_COUNT; ++w)
+        threads.push_back(std::thread([&bt, w]
+        {
+            for (int i = 0; i < RANGE_SIZE; ++i)
+                bt.insert(w * RANGE_SIZE + (i * 7919) % RANGE_SIZE);
+        }));
+
+    for (int r = 0; r < 2; ++r)
+        threads.push_back(std::thread([&bt, &foundCounts, r]
+        {
+            int result;
+            std::vector<int> keys;
+            for (int k = -500; k < 0; ++k)
+            {
+                if (bt.search(k, result) && result == k)
+                    ++foundCounts[r];
+
+                keys.clear();
+                if (bt.searchAll(k, keys) == 2 && keys[0] == k && keys[1] == k)
+                    ++foundCounts[r + 2];
+            }
+
+            keys.clear();
+            bt.searchRange(-500, -1, keys);
+            for (size_t i = 0; i < keys.size(); ++i)
+                if (keys[i] == -500 + (int)i / 2)
+                    ++foundCounts[r + 4];
+        }));
+
+    for (std::vector<std::thread>::iterator iter = threads.begin(); iter != threads.end(); ++iter)
+        iter->join();
+
+    EXPECT_EQ(500, foundCounts[0]);
+    EXPECT_EQ(500, foundCounts[1]);
+    EXPECT_EQ(500, foundCounts[2]);
+    EXPECT_EQ(500, foundCounts[3]);
+    EXPECT_EQ(1000, foundCounts[4]);
+    EXPECT_EQ(1000, foundCounts[5]);
+    EXPECT_EQ(0u, bt.getPageLatchesCount());
+
+    int result;
+    for (int k = 0; k < WRITERS_COUNT * RANGE_SIZE; ++k)
+        EXPECT_TRUE(bt.search(k, result));
+}
+
+TEST_F(TypedBTreeTest, OptimisticSearch1)
+{
+    checkOptimisticSearch<BaseBTree::B_TREE>();
+    checkOptimisticSearch<BaseBTree::B_PLUS_TREE>();
+    checkOptimisticSearch<BaseBTree::B_STAR_TREE>();
+    checkOptimisticSearch<BaseBTree::B_STAR_PLUS_TREE>();
+}
+
+TEST_F(TypedBTreeTest, BLink1)
+{
+    MemoryPageStore starStore;
+    BTree<int, std::less<int>, BaseBTree::B_STAR_PLUS_TREE> starTree(&starStore);
+    EXPECT_THROW(starTree.setBLink(true), std::logic_error);
+
+    MemoryPageStore store;
+    BTree<int, std::less<int>, BaseBTree::B_PLUS_TREE> bt(&store);
+    bt.setBLink(true);
+    bt.create(2);
+    EXPECT_THROW(bt.setBLink(false), std::logic_error);
+    bt.setLatchCoupling(true);
+    bt.setBufferPoolCapacity(16);
+
+    std::vector<int> sorted;
+    for (int k = 0; k < 8000; k += 2)
+        sorted.push_back(k);
+    bt.bulkLoad(sorted.begin(), sorted.end());
+
+    // The writers split the pages which the readers pass without latches.
+    const int WRITERS_COUNT = 4;
+    const int RANGE_SIZE = 2000;
+    std::vector<int> foundCounts(4, 0);
+    std::vector<std::thread> threads;
+    for (int w = 0; w < WRITERS_COUNT; ++w)
+        threads.push_back(std::thread([&bt, w]
+        {
+            for (int i = 1; i < RANGE_SIZE; i += 2)
+                bt.insert(w * RANGE_SIZE + (i * 7919) % RANGE_SIZE);
+        }));
+
+    for (int r = 0; r < 2; ++r)
+        threads.push_back(std::thread([&bt, &foundCounts, r]
+        {
+            int result;
+            for (int k = 0; k < WRITERS_COUNT * RANGE_SIZE; k += 2)
+                if (bt.search(k, result) && result == k)
+                    ++foundCounts[r];
+
+            std::vector<int> keys;
+            bt.searchRange(0, WRITERS_COUNT * RANGE_SIZE, keys);
+            for (std::vector<int>::const_iterator iter = keys.begin(); iter != keys.end(); ++iter)
+                if (*iter % 2 == 0)
+                    ++foundCounts[r + 2];
+        }));
+
+    for (std::vector<std::thread>::iterator iter = threads.begin(); iter != threads.end(); ++iter)
+        iter->join();
+
+    EXPECT_EQ(4000, foundCounts[0]);
+    EXPECT_EQ(4000, foundCounts[1]);
+    EXPECT_EQ(4000, foundCounts[2]);
+    EXPECT_EQ(4000, foundCounts[3]);
+    EXPECT_EQ(0u, bt.getPageLatchesCount());
+
+    int result;
+    for (int k = 0; k < WRITERS_COUNT * RANGE_SIZE; ++k)
+        EXPECT_TRUE(bt.search(k, result));
+
+    // The mode is restored with the tree.
+    bt.flushBufferPool();
+    BTree<int, std::less<int>, BaseBTree::B_PLUS_TREE> loaded(&store);
+    loaded.load();
+    EXPECT_TRUE(loaded.isBLink());
+
+    std::vector<int> keys;
+    EXPECT_EQ(WRITERS_COUNT * RANGE_SIZE, loaded.searchRange(0, WRITERS_COUNT * RANGE_SIZE, keys));
+    for (int k = 0; k < WRITERS_COUNT * RANGE_SIZE; ++k)
+        EXPECT_EQ(k, keys[k]);
+}
+
+TEST_F(TypedBTreeTest, BLink2)
+{
+    // The B-link mode is supported by the B+-tree only.
+    MemoryPageStore treeStore;
+    BTree<int, std::less<int>, BaseBTree::B_TREE> tree(&treeStore);
+    EXPECT_THROW(tree.setBLink(true), std::logic_error);
+    EXPECT_FALSE(tree.isBLink());
+
+    MemoryPageStore starStore;
+    BTree<int, std::less<int>, BaseBTree::B_STAR_TREE> starTree(&starStore);
+    EXPECT_THROW(starTree.setBLink(true), std::logic_error);
+    EXPECT_FALSE(starTree.isBLink());
+
+    MemoryPageStore store;
+    {
+        BTree<int, std::less<int>, BaseBTree::B_PLUS_TREE> bt(&store);
+        bt.setBLink(true);
+        bt.create(2);
+        for (int k = 0; k < 100; ++k)
+            bt.insert(k);
+    }
+
+    // The B-link tree's file is loaded by the B+-tree only.
+    IntComparator comparator;
+    BaseBTree untyped(&comparator, &store);
+    EXPECT_THROW(untyped.loadTree(), std::runtime_error);
+
+    BTree<int, std::less<int>, BaseBTree::B_PLUS_TREE> bt(&store);
+    bt.load();
+    EXPECT_TRUE(bt.isBLink());
+
+    int result = 0;
+    for (int k = 0; k < 100; ++k)
+        EXPECT_TRUE(bt.search(k, result));
+}